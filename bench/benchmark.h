@@ -0,0 +1,329 @@
+#pragma once
+
+#include "perf-counters.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Minimal harness for microbenchmarks: every case is a body doing /items/ operations,
+// which is repeated until one sample takes long enough for the clock, sample times
+// are then reported per item. Results go to a table (stdout) and JSON file, so that
+// runs on different commits can be compared by scripts. With --counters, every case
+// is run once more under hardware counters, which are reported per item too
+namespace bench {
+
+    // Keeps compiler from proving value unused (and removing its computation)
+    template <typename value_type>
+    inline void do_not_optimize(const value_type& value) {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    // Case's name is "name/parameter=value/...", parameters also go to JSON separately
+    using parameter_list = std::vector<std::pair<std::string, long long>>;
+
+    struct options {
+        std::string filter;    // Only cases with this in their full name run
+        std::string json_path; // Where JSON results are written, none when empty
+        std::string label;     // Free-form tag for results, e.g. commit hash
+
+        int samples = 10;
+        double min_sample_ms = 20.0;
+
+        bool is_counting = false;
+
+        // --filter=, --json=, --label=, --samples=, --min-sample-ms=, --counters
+        static options parse(int argc, char* argv[]) {
+            options result;
+
+            for (int i = 1; i < argc; ++ i) {
+                const std::string_view argument = argv[i];
+
+                auto value_of = [&](std::string_view key, std::string_view& value) {
+                    if (!argument.starts_with(key))
+                        return false;
+
+                    value = argument.substr(key.size());
+                    return true;
+                };
+
+                std::string_view value;
+                if      (value_of("--filter=", value)) result.filter    = value;
+                else if (value_of("--json=",   value)) result.json_path = value;
+                else if (value_of("--label=",  value)) result.label     = value;
+                else if (value_of("--samples=",       value)) result.samples = std::max(1, std::atoi(value.data()));
+                else if (value_of("--min-sample-ms=", value)) result.min_sample_ms = std::atof(value.data());
+                else if (argument == "--counters") result.is_counting = true;
+                else
+                    throw std::runtime_error("Unknown argument: " + std::string(argument));
+            }
+
+            return result;
+        }
+    };
+
+    struct case_result {
+        std::string name;
+        parameter_list parameters;
+
+        size_t items = 0;        // Operations per body call
+        size_t calls_per_sample = 0;
+
+        std::vector<double> samples_ns; // Per item, sorted
+
+        std::string skip_reason; // Empty for cases that ran
+
+        // Events of one sample divided by its items, when counting
+        std::optional<gl::perf_sample> counters;
+        std::array<bool, gl::PERF_EVENT_COUNT> is_counted {};
+        double counted_items = 0.0;
+
+        double get_per_item(gl::perf_event event) const {
+            return (double) (*counters)[event] / counted_items;
+        }
+
+        double get_min()    const { return samples_ns.front(); }
+        double get_max()    const { return samples_ns.back();  }
+        double get_median() const { return samples_ns[samples_ns.size() / 2]; }
+
+        double get_mean() const {
+            return std::accumulate(samples_ns.begin(), samples_ns.end(), 0.0) / (double) samples_ns.size();
+        }
+
+        double get_stddev() const {
+            const double mean = get_mean();
+
+            double sum = 0.0;
+            for (double sample: samples_ns)
+                sum += (sample - mean) * (sample - mean);
+
+            return std::sqrt(sum / (double) samples_ns.size());
+        }
+    };
+
+    class suite {
+    public:
+        explicit suite(options settings): m_options(std::move(settings)) {
+            std::printf("%-56s %12s %12s %10s %12s\n", "case", "median ns", "min ns", "stddev %", "call ms");
+        }
+
+        bool is_selected(const std::string& name) const {
+            return name.find(m_options.filter) != std::string::npos;
+        }
+
+        // Calls body() once to warm up and to find how many calls make a sample long enough,
+        // counters (if any) count /thread_ids/, or just calling thread when there are none
+        template <typename body_type>
+        void run(const std::string& name, parameter_list parameters, size_t items, body_type&& body,
+                 std::vector<int> thread_ids = {}) {
+            case_result result;
+            result.name = get_full_name(name, parameters);
+            result.parameters = std::move(parameters);
+            result.items = items;
+
+            if (!is_selected(result.name))
+                return;
+
+            using clock = std::chrono::steady_clock;
+
+            auto measure_ns = [&](size_t calls) {
+                const auto start = clock::now();
+                for (size_t call = 0; call < calls; ++ call)
+                    body();
+
+                return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+            };
+
+            const double warm_up_ns = std::max(1.0, measure_ns(1));
+            result.calls_per_sample = std::max<size_t>(1, (size_t) std::ceil(m_options.min_sample_ms * 1e6 / warm_up_ns));
+
+            for (int sample = 0; sample < m_options.samples; ++ sample)
+                result.samples_ns.push_back(measure_ns(result.calls_per_sample) /
+                                            (double) (result.calls_per_sample * std::max<size_t>(1, items)));
+
+            std::sort(result.samples_ns.begin(), result.samples_ns.end());
+
+            std::printf("%-56s %12.3f %12.3f %10.2f %12.3f\n", result.name.c_str(),
+                        result.get_median(), result.get_min(),
+                        100.0 * result.get_stddev() / std::max(result.get_mean(), 1e-9),
+                        result.get_median() * (double) items * 1e-6);
+
+            // Separate from timed samples, so that reading counters doesn't skew them
+            if (m_options.is_counting) {
+                if (thread_ids.empty())
+                    thread_ids.push_back(gl::get_current_thread_id());
+
+                const gl::perf_counters counters(thread_ids);
+                if (!counters.get_error().empty() && m_counters_error.empty()) {
+                    m_counters_error = counters.get_error();
+                    std::printf("    not counted: %s\n", m_counters_error.c_str());
+                }
+
+                if (counters.is_available()) {
+                    const gl::perf_sample start = counters.read();
+                    measure_ns(result.calls_per_sample);
+
+                    result.counters = counters.read() - start;
+                    result.counted_items = (double) (result.calls_per_sample * std::max<size_t>(1, items));
+
+                    for (size_t i = 0; i < gl::PERF_EVENT_COUNT; ++ i)
+                        result.is_counted[i] = counters.is_counted((gl::perf_event) i);
+
+                    print_counters(result);
+                }
+            }
+
+            std::fflush(stdout);
+
+            m_results.push_back(std::move(result));
+        }
+
+        // Keeps case in results, so that missing numbers aren't mistaken for removed case
+        void skip(const std::string& name, parameter_list parameters, std::string reason) {
+            case_result result;
+            result.name = get_full_name(name, parameters);
+            result.parameters = std::move(parameters);
+
+            if (!is_selected(result.name))
+                return;
+
+            std::printf("%-56s skipped: %s\n", result.name.c_str(), reason.c_str());
+
+            result.skip_reason = std::move(reason);
+            m_results.push_back(std::move(result));
+        }
+
+        const std::vector<case_result>& get_results() const { return m_results; }
+
+        // Writes results to options' JSON path, if there is one
+        void write_json() const {
+            if (m_options.json_path.empty())
+                return;
+
+            std::FILE* output = std::fopen(m_options.json_path.c_str(), "w");
+            if (output == nullptr)
+                throw std::runtime_error("Failed to open " + m_options.json_path + "!");
+
+            char date[32];
+            const std::time_t now = std::time(nullptr);
+            std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+            std::fprintf(output, "{\n  \"context\": {\n");
+            std::fprintf(output, "    \"label\": \"%s\",\n", escape(m_options.label).c_str());
+            std::fprintf(output, "    \"date\": \"%s\",\n", date);
+            std::fprintf(output, "    \"compiler\": \"%s\",\n", escape(__VERSION__).c_str());
+#ifdef NDEBUG
+            std::fprintf(output, "    \"build_type\": \"release\",\n");
+#else
+            std::fprintf(output, "    \"build_type\": \"debug\",\n");
+#endif
+            std::fprintf(output, "    \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+            std::fprintf(output, "    \"samples\": %d,\n", m_options.samples);
+            std::fprintf(output, "    \"min_sample_ms\": %g,\n", m_options.min_sample_ms);
+            std::fprintf(output, "    \"counters\": %s,\n", m_options.is_counting? "true" : "false");
+            std::fprintf(output, "    \"counters_error\": \"%s\"\n  },\n", escape(m_counters_error).c_str());
+
+            std::fprintf(output, "  \"cases\": [");
+            for (size_t i = 0; i < m_results.size(); ++ i) {
+                const case_result& result = m_results[i];
+
+                std::fprintf(output, "%s\n    {\n      \"name\": \"%s\",\n", i == 0? "" : ",", result.name.c_str());
+
+                std::fprintf(output, "      \"parameters\": {");
+                for (size_t j = 0; j < result.parameters.size(); ++ j)
+                    std::fprintf(output, "%s\"%s\": %lld", j == 0? " " : ", ",
+                                 result.parameters[j].first.c_str(), result.parameters[j].second);
+                std::fprintf(output, "%s},\n", result.parameters.empty()? "" : " ");
+
+                if (!result.skip_reason.empty()) {
+                    std::fprintf(output, "      \"skipped\": \"%s\"\n    }", escape(result.skip_reason).c_str());
+                    continue;
+                }
+
+                std::fprintf(output, "      \"items\": %zu,\n", result.items);
+                std::fprintf(output, "      \"calls_per_sample\": %zu,\n", result.calls_per_sample);
+                std::fprintf(output, "      \"median_ns\": %.4f,\n", result.get_median());
+                std::fprintf(output, "      \"mean_ns\": %.4f,\n",   result.get_mean());
+                std::fprintf(output, "      \"min_ns\": %.4f,\n",    result.get_min());
+                std::fprintf(output, "      \"max_ns\": %.4f,\n",    result.get_max());
+                std::fprintf(output, "      \"stddev_ns\": %.4f", result.get_stddev());
+
+                // Per item, like times
+                if (result.counters) {
+                    std::fprintf(output, ",\n      \"counters\": {");
+
+                    bool is_first = true;
+                    for (size_t j = 0; j < gl::PERF_EVENT_COUNT; ++ j) {
+                        if (!result.is_counted[j])
+                            continue;
+
+                        std::fprintf(output, "%s\"%s\": %.4f", is_first? " " : ", ",
+                                     gl::get_name((gl::perf_event) j), result.get_per_item((gl::perf_event) j));
+                        is_first = false;
+                    }
+
+                    std::fprintf(output, " }");
+                }
+
+                std::fprintf(output, "\n    }");
+            }
+            std::fprintf(output, "\n  ]\n}\n");
+
+            std::fclose(output);
+        }
+
+    private:
+        options m_options;
+        std::vector<case_result> m_results;
+
+        std::string m_counters_error; // First one, it's usually the same for every case
+
+        static void print_counters(const case_result& result) {
+            std::printf("    per item:");
+
+            for (size_t i = 0; i < gl::PERF_EVENT_COUNT; ++ i)
+                if (result.is_counted[i])
+                    std::printf(" %s %.3f", gl::get_name((gl::perf_event) i), result.get_per_item((gl::perf_event) i));
+
+            if (result.is_counted[(size_t) gl::perf_event::CYCLES] && result.is_counted[(size_t) gl::perf_event::INSTRUCTIONS])
+                std::printf(", IPC %.2f", (double) (*result.counters)[gl::perf_event::INSTRUCTIONS] /
+                                          std::max(1.0, (double) (*result.counters)[gl::perf_event::CYCLES]));
+
+            std::printf("\n");
+        }
+
+        static std::string get_full_name(const std::string& name, const parameter_list& parameters) {
+            std::string full_name = name;
+            for (const auto& [parameter, value]: parameters)
+                full_name += "/" + parameter + "=" + std::to_string(value);
+
+            return full_name;
+        }
+
+        static std::string escape(std::string_view text) {
+            std::string escaped;
+            for (char symbol: text) {
+                if (symbol == '"' || symbol == '\\')
+                    escaped += '\\';
+
+                escaped += symbol;
+            }
+
+            return escaped;
+        }
+    };
+
+}
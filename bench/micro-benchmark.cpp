@@ -0,0 +1,415 @@
+// Microbenchmarks of raycaster's and drawer's hot paths: vec operations, surface
+// shading, primary rays over frame-sized grids, tessellation and vertex upload,
+// results are printed as a table and (with --json) written as JSON for comparing
+// runs across commits.
+//
+// Usage: micro-benchmark [--filter=substring] [--json=path] [--label=tag]
+//                        [--samples=count] [--min-sample-ms=ms] [--counters]
+//
+// Vertex upload needs OpenGL context (of a hidden window), it's reported as
+// skipped where there is no display
+
+#include "benchmark.h"
+
+#include "camera.h"
+#include "drawing-manager.h"
+#include "parallel-geometry.h"
+#include "perf-counters.h"
+#include "scene.h"
+#include "shading-lut.h"
+#include "thread-pool.h"
+#include "vec.h"
+#include "vec-layout.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+    // Shading constants of sphere-raycaster's original config
+    static constexpr float SHININESS = 15.0f;
+
+    const math::vec3 LIGHT_POSITION = {  7.0f, 7.0f,  7.0f };
+    const math::vec3 LIGHT_COLOR    = {  0.5f, 0.5f,  0.5f };
+    const math::vec3 AMBIENT_COLOR  = {  0.1f, 0.1f,  0.7f };
+    const math::vec3 SURFACE_COLOR  = {  1.0f, 1.0f,  1.0f };
+    const math::vec3 VIEW_POSITION  = {  0.0f, 0.0f, -3.5f };
+
+    // Where primary rays are cast from, looking at the origin
+    const math::vec3 CAMERA_POSITION = { 0.0f, 0.0f, 3.5f };
+
+    template <typename vec_type>
+    std::vector<vec_type> make_vectors(size_t count, unsigned seed) {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+
+        std::vector<vec_type> vectors;
+        vectors.reserve(count);
+
+        for (size_t i = 0; i < count; ++ i)
+            vectors.push_back(vec_type { coordinate(generator), coordinate(generator), coordinate(generator) });
+
+        return vectors;
+    }
+
+    // ==> vec.h:
+
+    void run_vec_cases(bench::suite& suite) {
+        static constexpr size_t COUNT = 4096;   // Stays in cache, measures arithmetic
+        static constexpr int    QUERIES = 4;    // Lengths asked per vector, where cache pays off
+
+        std::vector<math::vec3> a = make_vectors<math::vec3>(COUNT, 1);
+        std::vector<math::vec3> b = make_vectors<math::vec3>(COUNT, 2);
+        std::vector<math::vec3> c(COUNT, math::vec3 { 0.0f, 0.0f, 0.0f });
+
+        suite.run("vec3/add", {}, COUNT, [&]() {
+            for (size_t i = 0; i < COUNT; ++ i)
+                c[i] = a[i] + b[i];
+
+            bench::do_not_optimize(c);
+        });
+
+        suite.run("vec3/dot", {}, COUNT, [&]() {
+            float sum = 0.0f;
+            for (size_t i = 0; i < COUNT; ++ i)
+                sum += a[i].dot(b[i]);
+
+            bench::do_not_optimize(sum);
+        });
+
+        suite.run("vec3/normalized", {}, COUNT, [&]() {
+            for (size_t i = 0; i < COUNT; ++ i)
+                c[i] = a[i].normalized();
+
+            bench::do_not_optimize(c);
+        });
+
+        // Lengths are asked several times, then vector changes (invalidating cached length)
+        auto run_len_case = [&]<typename vec_type>(const char* name, std::vector<vec_type>& vectors) {
+            suite.run(name, { { "queries", QUERIES } }, COUNT * QUERIES, [&]() {
+                float sum = 0.0f;
+                for (vec_type& current: vectors) {
+                    for (int query = 0; query < QUERIES; ++ query)
+                        sum += current.len();
+
+                    current *= 1.0f;
+                }
+
+                bench::do_not_optimize(sum);
+            });
+        };
+
+        std::vector<math::uncached::vec<float, 3>> uncached = make_vectors<math::uncached::vec<float, 3>>(COUNT, 3);
+        std::vector<math::cached::vec<float, 3>>   cached   = make_vectors<math::cached::vec<float, 3>>  (COUNT, 3);
+
+        run_len_case("vec3/len/uncached", uncached);
+        run_len_case("vec3/len/cached",   cached);
+
+        // Coordinate writes go through proxy notifying vector about modification,
+        // plain array shows what they would cost without it
+        auto run_index_case = [&]<typename vec_type>(const char* name, std::vector<vec_type>& vectors) {
+            suite.run(name, {}, COUNT * 3, [&]() {
+                for (vec_type& current: vectors)
+                    for (size_t k = 0; k < 3; ++ k)
+                        current[k] *= 1.0001f;
+
+                bench::do_not_optimize(vectors);
+            });
+        };
+
+        run_index_case("vec3/index_write/uncached", uncached);
+        run_index_case("vec3/index_write/cached",   cached);
+
+        std::vector<float> raw(COUNT * 3, 0.5f);
+        suite.run("vec3/index_write/array", {}, COUNT * 3, [&]() {
+            for (size_t i = 0; i < COUNT; ++ i)
+                for (size_t k = 0; k < 3; ++ k)
+                    raw[i * 3 + k] *= 1.0001f;
+
+            bench::do_not_optimize(raw);
+        });
+    }
+
+    // ==> Surface shading:
+
+    float clamp(float value, float min, float max) {
+        if (value < min)
+            return min;
+
+        if (value > max)
+            return max;
+
+        return value;
+    }
+
+    // Sphere's shading exactly the way raycaster first did it, for every pixel of the disk
+    math::vec3 get_sphere_surface_color(math::vec3 position) {
+        math::vec3 normal = position.normalized();
+
+        math::vec3 relative_light = (LIGHT_POSITION - position).normalized();
+        math::vec3 relative_view  = (VIEW_POSITION  - position).normalized();
+
+        float sin_alpha = normal.dot(relative_light);
+
+        math::vec3 mirrored_light = relative_light - 2 * sin_alpha * normal;
+        float sin_phi = mirrored_light.dot(relative_view);
+
+        float diffuse  = clamp(sin_alpha,             0, 10000);
+        float specular = clamp(std::pow(sin_phi, 15), 0, 10000);
+
+        return specular * LIGHT_COLOR +
+            (diffuse * math::vec3(1.0f, 1.0f, 1.0f) + AMBIENT_COLOR)
+                * LIGHT_COLOR * SURFACE_COLOR;
+    }
+
+    // Same color from shading terms, which is what other cases compute them for
+    math::vec3 get_surface_color(const raycaster::shading_terms& terms) {
+        return terms.specular * LIGHT_COLOR +
+            (terms.diffuse * math::vec3(1.0f, 1.0f, 1.0f) + AMBIENT_COLOR) * LIGHT_COLOR * SURFACE_COLOR;
+    }
+
+    void run_surface_cases(bench::suite& suite) {
+        static constexpr int SIZE = 256;
+        static constexpr float RADIUS = 0.7f;
+
+        // Points of the sphere visible through every pixel of the disk
+        std::vector<math::vec3> points;
+        for (int i = 0; i < SIZE; ++ i)
+            for (int j = 0; j < SIZE; ++ j) {
+                const float x = 2.0f * (float) i / SIZE - 1.0f, y = 2.0f * (float) j / SIZE - 1.0f;
+                if (x * x + y * y < RADIUS * RADIUS)
+                    points.push_back({ x, y, std::sqrt(RADIUS * RADIUS - x * x - y * y) });
+            }
+
+        std::vector<math::vec3> colors(points.size(), math::vec3 { 0.0f, 0.0f, 0.0f });
+
+        suite.run("sphere_surface_color/original", {}, points.size(), [&]() {
+            for (size_t i = 0; i < points.size(); ++ i)
+                colors[i] = get_sphere_surface_color(points[i]);
+
+            bench::do_not_optimize(colors);
+        });
+
+        suite.run("sphere_surface_color/shading_terms", {}, points.size(), [&]() {
+            for (size_t i = 0; i < points.size(); ++ i) {
+                const math::vec3& position = points[i];
+
+                const raycaster::shading_terms terms = raycaster::shading_terms::evaluate(
+                    position.normalized(), (LIGHT_POSITION - position).normalized(),
+                                           (VIEW_POSITION  - position).normalized(), SHININESS);
+
+                colors[i] = get_surface_color(terms);
+            }
+
+            bench::do_not_optimize(colors);
+        });
+
+        raycaster::shading_lut table;
+        table.build(LIGHT_POSITION.normalized(), VIEW_POSITION.normalized(), SHININESS);
+
+        suite.run("sphere_surface_color/lut", {}, points.size(), [&]() {
+            for (size_t i = 0; i < points.size(); ++ i) {
+                const raycaster::shading_terms terms = table.lookup(points[i].normalized());
+                colors[i] = get_surface_color(terms);
+            }
+
+            bench::do_not_optimize(colors);
+        });
+    }
+
+    // ==> Primary rays:
+
+    // Primary ray, nearest hit and one light's Phong shading of every pixel, row by row.
+    // Measures scene's and camera's part of a frame as it scales with resolution and
+    // threads, not raycaster's own frames: those go through tiles, coverage, light
+    // clusters and shadows, see sphere-raycaster's --counters for their phases
+    void shade_primary_rays(const raycaster::scene& scene, const raycaster::camera& view,
+                     std::vector<float>& frame, gl::thread_pool& pool) {
+        const int width = view.get_width(), height = view.get_height();
+
+        gl::parallel_for(0, (size_t) height, 1, [&](size_t row_begin, size_t row_end) {
+            for (int i = (int) row_begin; i < (int) row_end; ++ i)
+                for (int j = 0; j < width; ++ j) {
+                    float* pixel = frame.data() + ((size_t) i * width + j) * 3;
+
+                    raycaster::hit surface;
+                    if (!scene.intersect(view.get_ray(i, j), surface)) {
+                        pixel[0] = pixel[1] = pixel[2] = 0.0f;
+                        continue;
+                    }
+
+                    const raycaster::shading_terms terms = raycaster::shading_terms::evaluate(
+                        surface.normal, (LIGHT_POSITION       - surface.position).normalized(),
+                                        (view.get_position()  - surface.position).normalized(), SHININESS);
+
+                    const math::vec3 color = get_surface_color(terms);
+                    for (size_t channel = 0; channel < 3; ++ channel)
+                        pixel[channel] = color[channel];
+                }
+        }, pool);
+    }
+
+    void run_primary_ray_cases(bench::suite& suite) {
+        static constexpr size_t SPHERE_COUNT = 2000;
+
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f), radius(0.02f, 0.08f);
+
+        raycaster::scene scene;
+        for (size_t i = 0; i < SPHERE_COUNT; ++ i)
+            scene.get_spheres().add_sphere({ coordinate(generator), coordinate(generator), coordinate(generator) },
+                                           radius(generator));
+
+        scene.build();
+
+        static constexpr int RESOLUTIONS[][2] = { { 320, 180 }, { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+
+        // Powers of two up to every hardware thread, and all of them
+        const size_t hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        std::vector<size_t> thread_counts;
+        for (size_t count = 1; count < hardware_threads; count *= 2)
+            thread_counts.push_back(count);
+        thread_counts.push_back(hardware_threads);
+
+        for (size_t thread_count: thread_counts) {
+            gl::thread_pool pool(thread_count);
+
+            for (const auto& [width, height]: RESOLUTIONS) {
+                const bench::parameter_list parameters = {
+                    { "width", width }, { "height", height }, { "threads", (long long) thread_count }
+                };
+
+                raycaster::camera view(CAMERA_POSITION, { 0.0f, 0.0f, 0.0f });
+                view.set_resolution(width, height);
+                view.update(pool);
+
+                std::vector<float> frame((size_t) width * height * 3);
+                suite.run("primary_rays", parameters, (size_t) width * height, [&]() {
+                    shade_primary_rays(scene, view, frame, pool);
+                    bench::do_not_optimize(frame);
+                }, gl::get_job_thread_ids(pool));
+            }
+        }
+    }
+
+    // ==> Vertices:
+
+    // Hidden window, only there for its context
+    class offscreen_context {
+    public:
+        offscreen_context() {
+            if (!glfwInit())
+                return;
+
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            m_window = glfwCreateWindow(64, 64, "micro-benchmark", nullptr, nullptr);
+
+            if (m_window == nullptr)
+                return;
+
+            glfwMakeContextCurrent(m_window);
+            if (glewInit() != GLEW_OK) {
+                glfwDestroyWindow(m_window);
+                m_window = nullptr;
+            }
+        }
+
+        offscreen_context(const offscreen_context&) = delete;
+        offscreen_context& operator=(const offscreen_context&) = delete;
+
+        ~offscreen_context() {
+            if (m_window != nullptr)
+                glfwDestroyWindow(m_window);
+
+            glfwTerminate();
+        }
+
+        bool is_available() const { return m_window != nullptr; }
+
+    private:
+        GLFWwindow* m_window = nullptr;
+    };
+
+    // Random lines and their vectors' arrow heads, like plots draw them
+    void run_vertex_cases(bench::suite& suite) {
+        static constexpr size_t COUNTS[] = { 1 << 10, 1 << 14, 1 << 18 };
+
+        offscreen_context context;
+
+        for (size_t count: COUNTS) {
+            const bench::parameter_list parameters = { { "shapes", (long long) count } };
+
+            std::mt19937 generator(7);
+            std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+
+            std::vector<math::vec2> from, to;
+            for (size_t i = 0; i < count; ++ i) {
+                from.push_back({ coordinate(generator), coordinate(generator) });
+                to  .push_back({ coordinate(generator), coordinate(generator) });
+            }
+
+            gl::frame_arena arena;
+            gl::colored_vertex_array vertices { gl::arena_allocator<colored_vertex>(arena) };
+            vertices.set_layout(math::vector_layout<float, 2>() + math::vector_layout<float, 3>());
+
+            // Same frame cycle simple_drawing_renderer goes through
+            auto draw_frame = [&](auto&& draw) {
+                const size_t last_count = vertices.size();
+
+                gl::release_storage(vertices);
+                arena.begin_frame();
+                vertices.reserve(last_count);
+
+                gl::drawing_manager manager { vertices };
+                draw(manager);
+            };
+
+            suite.run("tessellation/lines/single", parameters, count, [&]() {
+                draw_frame([&](gl::drawing_manager& manager) {
+                    for (size_t i = 0; i < count; ++ i)
+                        manager.draw_line(from[i], to[i]);
+                });
+            });
+
+            suite.run("tessellation/lines/batched", parameters, count, [&]() {
+                draw_frame([&](gl::drawing_manager& manager) { manager.draw_lines(from, to); });
+            });
+
+            suite.run("tessellation/vectors/batched", parameters, count, [&]() {
+                draw_frame([&](gl::drawing_manager& manager) { manager.draw_vectors(from, to); });
+            });
+
+            // Only upload needs a context, vertices don't touch GL until then
+            if (!context.is_available()) {
+                suite.skip("vertex_upload", parameters, "no OpenGL context");
+                continue;
+            }
+
+            // Vertices of the last tessellation case stay, waits for the driver to actually copy them
+            suite.run("vertex_upload", parameters, vertices.size(), [&]() {
+                vertices.update();
+                glFinish();
+            });
+        }
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    bench::suite suite(bench::options::parse(argc, argv));
+
+    run_vec_cases(suite);
+    run_surface_cases(suite);
+    run_primary_ray_cases(suite);
+    run_vertex_cases(suite);
+
+    suite.write_json();
+}
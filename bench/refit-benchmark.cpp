@@ -0,0 +1,121 @@
+// Compares refitting sphere hierarchy with rebuilding it every frame for
+// animated scene: spheres fly in random directions and bounce off walls.
+//
+// Usage: refit-benchmark [sphere count] [frame count]
+
+#include "sphere-bvh.h"
+#include "sphere-scene.h"
+#include "thread-pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace raycaster;
+
+namespace {
+
+    static constexpr float WORLD_SIZE = 100.0f;
+    static constexpr float DELTA_TIME = 0.1f;
+
+    struct animation {
+        std::vector<float> velocity_x, velocity_y, velocity_z;
+
+        void step(sphere_scene& scene, float delta_time, gl::thread_pool& pool) {
+            auto advance = [&](float& position, float& velocity) {
+                position += velocity * delta_time;
+
+                if (position < 0.0f || position > WORLD_SIZE)
+                    velocity = - velocity;
+            };
+
+            gl::parallel_for(0, scene.size(), 1 << 14, [&](size_t from, size_t to) {
+                for (size_t i = from; i < to; ++ i) {
+                    const math::vec3 center = scene.get_center(i);
+
+                    float x = center.x(), y = center.y(), z = center.z();
+                    advance(x, velocity_x[i]);
+                    advance(y, velocity_y[i]);
+                    advance(z, velocity_z[i]);
+
+                    scene.set_sphere(i, { x, y, z }, scene.radius()[i]);
+                }
+            }, pool);
+        }
+    };
+
+    template <typename function_type>
+    double measure_ms(function_type&& function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    const size_t sphere_count = argc > 1? std::strtoul(argv[1], nullptr, 10) : 1'000'000;
+    const int    frame_count  = argc > 2? std::atoi(argv[2]) : 30;
+
+    gl::thread_pool& pool = gl::thread_pool::global();
+
+    // ==> Generate scene:
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> position(0.0f, WORLD_SIZE), speed(-1.0f, 1.0f);
+
+    sphere_scene scene;
+    animation motion;
+
+    scene.reserve(sphere_count);
+    for (size_t i = 0; i < sphere_count; ++ i) {
+        scene.add_sphere({ position(generator), position(generator), position(generator) }, 0.1f);
+
+        motion.velocity_x.push_back(speed(generator));
+        motion.velocity_y.push_back(speed(generator));
+        motion.velocity_z.push_back(speed(generator));
+    }
+
+    std::printf("%zu spheres, %zu threads\n\n", sphere_count, pool.get_thread_count());
+
+    // ==> Animate, refitting one hierarchy, rebuilding another and letting
+    //     the third one decide on its own:
+
+    sphere_bvh refitted, rebuilt, adaptive;
+
+    refitted.build(scene, pool);
+    adaptive.build(scene, pool);
+
+    static constexpr float NEVER_REBUILD = std::numeric_limits<float>::infinity();
+
+    double total_refit = 0.0, total_rebuild = 0.0, total_adaptive = 0.0;
+    int adaptive_rebuilds = 0;
+
+    std::printf("frame  refit ms  rebuild ms  adaptive ms  refit SAH  rebuild SAH\n");
+    for (int frame = 0; frame < frame_count; ++ frame) {
+        motion.step(scene, DELTA_TIME, pool);
+
+        double refit_time   = measure_ms([&]() { refitted.update(scene, NEVER_REBUILD, pool); });
+        double rebuild_time = measure_ms([&]() { rebuilt.build(scene, pool); });
+
+        bool is_rebuilt = false;
+        double adaptive_time = measure_ms([&]() {
+            is_rebuilt = adaptive.update(scene, sphere_bvh::DEFAULT_REBUILD_THRESHOLD, pool);
+        });
+
+        total_refit += refit_time, total_rebuild += rebuild_time, total_adaptive += adaptive_time;
+        adaptive_rebuilds += is_rebuilt;
+
+        std::printf("%5d  %8.2f  %10.2f  %11.2f%s %9.2f  %11.2f\n", frame,
+                    refit_time, rebuild_time, adaptive_time, is_rebuilt? "*" : " ",
+                    refitted.get_hierarchy().get_sah_cost(), rebuilt.get_hierarchy().get_sah_cost());
+    }
+
+    std::printf("\naverage: refit %.2f ms, rebuild %.2f ms, adaptive %.2f ms (%d rebuilds, marked *)\n",
+                total_refit / frame_count, total_rebuild / frame_count,
+                total_adaptive / frame_count, adaptive_rebuilds);
+}
@@ -0,0 +1,119 @@
+#include "numa-topology.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace gl {
+
+    std::vector<int> parse_cpu_list(const std::string& list) {
+        std::vector<int> cpus;
+
+        std::stringstream stream(list);
+        std::string range;
+        while (std::getline(stream, range, ',')) {
+            if (range.empty() || range == "\n")
+                continue;
+
+            const size_t dash = range.find('-');
+            try {
+                const int first = std::stoi(range.substr(0, dash));
+                const int last  = dash == std::string::npos? first : std::stoi(range.substr(dash + 1));
+
+                for (int cpu = first; cpu <= last; ++ cpu)
+                    cpus.push_back(cpu);
+            } catch (const std::exception&) {
+                // Malformed range, skip it
+            }
+        }
+
+        return cpus;
+    }
+
+    numa_topology numa_topology::detect() {
+        numa_topology topology;
+
+        namespace fs = std::filesystem;
+        const fs::path root = "/sys/devices/system/node";
+
+        std::error_code error;
+        for (const fs::directory_entry& entry: fs::directory_iterator(root, error)) {
+            const std::string name = entry.path().filename().string();
+            if (!name.starts_with("node") || name.size() == 4 ||
+                !std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; }))
+                continue;
+
+            std::ifstream cpu_list(entry.path() / "cpulist");
+
+            std::string list;
+            if (!std::getline(cpu_list, list))
+                continue;
+
+            numa_node node = { .id = std::stoi(name.substr(4)), .cpus = parse_cpu_list(list) };
+            if (!node.cpus.empty()) // Memory-only nodes have no CPUs
+                topology.m_nodes.push_back(std::move(node));
+        }
+
+        std::sort(topology.m_nodes.begin(), topology.m_nodes.end(),
+                  [](const numa_node& lhs, const numa_node& rhs) { return lhs.id < rhs.id; });
+
+        if (topology.m_nodes.empty()) {
+            numa_node all = { .id = 0, .cpus = {} };
+
+            const int cpu_count = (int) std::max(1u, std::thread::hardware_concurrency());
+            for (int cpu = 0; cpu < cpu_count; ++ cpu)
+                all.cpus.push_back(cpu);
+
+            topology.m_nodes.push_back(std::move(all));
+        }
+
+        return topology;
+    }
+
+    const numa_topology& numa_topology::system() {
+        static const numa_topology topology = detect();
+        return topology;
+    }
+
+    std::vector<int> numa_topology::get_cpus() const {
+        std::vector<int> cpus;
+        for (const numa_node& node: m_nodes)
+            cpus.insert(cpus.end(), node.cpus.begin(), node.cpus.end());
+
+        return cpus;
+    }
+
+    void first_touch(void* memory, size_t size, size_t page_size, thread_pool& pool) {
+        if (pool.get_node_count() <= 1 || size == 0)
+            return;
+
+#ifdef __linux__
+        const size_t base_page_size = (size_t) sysconf(_SC_PAGESIZE);
+#else
+        const size_t base_page_size = 4096;
+#endif
+
+        page_size = std::max(page_size, base_page_size);
+
+        char* bytes = static_cast<char*>(memory);
+        const size_t page_count = (size + page_size - 1) / page_size;
+
+        // Without stealing, so that no page goes to a node that's already done with its own
+        pool.run_on_nodes(page_count, [&](size_t page) {
+            const size_t end = std::min(size, (page + 1) * page_size);
+
+            // Every base page, in case kernel backed memory with those after all
+            // (transparent huge pages are only advised). Volatile, so that compiler
+            // doesn't drop the writes
+            for (size_t offset = page * page_size; offset < end; offset += base_page_size)
+                *static_cast<volatile char*>(bytes + offset) = 0;
+        });
+    }
+
+}
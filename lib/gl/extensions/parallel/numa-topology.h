@@ -0,0 +1,52 @@
+#pragma once
+
+#include "thread-pool.h"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gl {
+
+    struct numa_node {
+        int id;
+        std::vector<int> cpus;
+    };
+
+    // NUMA nodes of the machine with CPUs that belong to them, as listed in
+    // /sys/devices/system/node, machines (or platforms) that don't list
+    // any look like one node with every CPU
+    class numa_topology {
+    public:
+        numa_topology() = default;
+        explicit numa_topology(std::vector<numa_node> nodes): m_nodes(std::move(nodes)) {}
+
+        static numa_topology detect();
+
+        // Detected once, on first call
+        static const numa_topology& system();
+
+        const std::vector<numa_node>& get_nodes() const { return m_nodes; }
+        size_t get_node_count() const { return m_nodes.size(); }
+
+        // CPUs node by node, in the order pool pins its workers in
+        std::vector<int> get_cpus() const;
+
+    private:
+        std::vector<numa_node> m_nodes;
+    };
+
+    // Parses kernel's CPU list format, e.g. "0-3,8,10-11"
+    std::vector<int> parse_cpu_list(const std::string& list);
+
+    // Writes one byte in every page of memory from pool's workers, split the same way
+    // run_partitioned splits indices, with kernel's first-touch policy every node's
+    // share of the buffer then ends up in its own memory, as long as buffer is laid
+    // out in the order tasks are. Memory is handed to nodes in /page_size/ units, which
+    // should be size of pages backing it (e.g. huge pages, one touch commits a whole
+    // one), and no node touches another's. Does nothing for pools that span one node
+    void first_touch(void* memory, size_t size, size_t page_size,
+                     thread_pool& pool = thread_pool::global());
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+namespace gl {
+
+    // Bounded lock-free queue for exactly one producer and one consumer thread.
+    // Ring of CAPACITY slots, indices only grow (wrapping around is fine, since
+    // capacity is a power of two), each side caches the other's index and only
+    // reloads it when the queue looks full (or empty), so they rarely touch
+    // each other's cache lines
+    template <typename value_type, size_t CAPACITY>
+    class spsc_queue {
+        static_assert(CAPACITY > 0 && (CAPACITY & (CAPACITY - 1)) == 0, "Capacity should be a power of two");
+
+    public:
+        spsc_queue() = default;
+
+        // This class shouldn't be copied or moved (threads hold references into it)
+        spsc_queue(const spsc_queue&) = delete;
+        spsc_queue& operator=(const spsc_queue&) = delete;
+
+        // Producer side, returns false (and drops value) if queue is full
+        bool try_push(const value_type& value) {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+
+            if (head - m_cached_tail == CAPACITY) {
+                m_cached_tail = m_tail.load(std::memory_order_acquire);
+                if (head - m_cached_tail == CAPACITY)
+                    return false;
+            }
+
+            m_slots[head & (CAPACITY - 1)] = value;
+            m_head.store(head + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        // Consumer side, empty if there's nothing to take
+        std::optional<value_type> try_pop() {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+
+            if (tail == m_cached_head) {
+                m_cached_head = m_head.load(std::memory_order_acquire);
+                if (tail == m_cached_head)
+                    return std::nullopt;
+            }
+
+            std::optional<value_type> value = m_slots[tail & (CAPACITY - 1)];
+            m_tail.store(tail + 1, std::memory_order_release);
+
+            return value;
+        }
+
+    private:
+        value_type m_slots[CAPACITY] {};
+
+        // ==> Producer's:
+        alignas(64) std::atomic<size_t> m_head { 0 }; // Next slot to write
+        size_t m_cached_tail = 0;
+
+        // ==> Consumer's:
+        alignas(64) std::atomic<size_t> m_tail { 0 }; // Next slot to read
+        size_t m_cached_head = 0;
+    };
+
+}
@@ -0,0 +1,269 @@
+#include "thread-pool.h"
+#include "numa-topology.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gl {
+
+    // Worker index of current thread (0 for threads that aren't pool workers)
+    static thread_local size_t current_worker_index = 0;
+
+    // Set while thread executes pool's task, used to serialize nested calls
+    static thread_local bool is_inside_task = false;
+
+    thread_pool::thread_pool(size_t thread_count) {
+        if (thread_count == 0)
+            thread_count = 1; // hardware_concurrency() is allowed to return 0
+
+        m_worker_nodes.assign(thread_count, 0);
+        m_partitions = std::make_unique<partition[]>(1);
+
+        start_workers(thread_count);
+    }
+
+    thread_pool::thread_pool(size_t thread_count, const numa_topology& topology) {
+        if (thread_count == 0)
+            thread_count = 1;
+
+        const std::vector<int> cpus = topology.get_cpus();
+        if (cpus.empty())
+            throw std::runtime_error("Topology has no CPUs to pin workers to!");
+
+        // CPU of every worker, and node it belongs to
+        std::vector<int> worker_cpus(thread_count);
+        m_worker_nodes.resize(thread_count);
+
+        for (size_t worker = 0; worker < thread_count; ++ worker) {
+            const int cpu = cpus[worker % cpus.size()];
+            worker_cpus[worker] = cpu;
+
+            for (size_t node = 0; node < topology.get_node_count(); ++ node) {
+                const std::vector<int>& node_cpus = topology.get_nodes()[node].cpus;
+                if (std::find(node_cpus.begin(), node_cpus.end(), cpu) != node_cpus.end())
+                    m_worker_nodes[worker] = node;
+            }
+        }
+
+        m_node_count = topology.get_node_count();
+        m_partitions = std::make_unique<partition[]>(m_node_count);
+
+        start_workers(thread_count);
+
+#ifdef __linux__
+        if (m_node_count <= 1)
+            return; // One node machines keep letting scheduler place threads
+
+        for (size_t worker = 1; worker < thread_count; ++ worker) {
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(worker_cpus[worker], &cpu_set);
+
+            // Failure (e.g. CPU isn't in our cgroup) just leaves the worker unpinned
+            pthread_setaffinity_np(m_workers[worker - 1].native_handle(), sizeof(cpu_set), &cpu_set);
+        }
+#endif
+    }
+
+    void thread_pool::start_workers(size_t thread_count) {
+        m_worker_thread_ids = std::make_unique<std::atomic<int>[]>(thread_count - 1);
+
+        m_workers.reserve(thread_count - 1);
+        for (size_t i = 1; i < thread_count; ++ i)
+            m_workers.emplace_back([this, i]() { worker_loop(i); });
+    }
+
+    size_t thread_pool::get_thread_count() const noexcept {
+        return m_workers.size() + 1;
+    }
+
+    size_t thread_pool::get_node_count() const noexcept {
+        return m_node_count;
+    }
+
+    std::vector<thread_pool::node_stats> thread_pool::get_node_stats() const {
+        std::vector<node_stats> stats(m_node_count);
+        for (size_t node = 0; node < m_node_count; ++ node)
+            stats[node] = { m_partitions[node].local_tasks .load(std::memory_order_relaxed),
+                            m_partitions[node].stolen_tasks.load(std::memory_order_relaxed) };
+
+        return stats;
+    }
+
+    void thread_pool::reset_node_stats() {
+        for (size_t node = 0; node < m_node_count; ++ node) {
+            m_partitions[node].local_tasks .store(0, std::memory_order_relaxed);
+            m_partitions[node].stolen_tasks.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<int> thread_pool::get_worker_thread_ids() const {
+#ifdef __linux__
+        std::vector<int> ids(m_workers.size());
+        for (size_t i = 0; i < ids.size(); ++ i) {
+            m_worker_thread_ids[i].wait(0); // Worker that has just started may not be there yet
+            ids[i] = m_worker_thread_ids[i].load();
+        }
+
+        return ids;
+#else
+        return {};
+#endif
+    }
+
+    size_t thread_pool::current_worker() noexcept {
+        return current_worker_index;
+    }
+
+    thread_pool& thread_pool::global() {
+        static thread_pool pool(std::thread::hardware_concurrency(), numa_topology::system());
+        return pool;
+    }
+
+    void thread_pool::execute_tasks() {
+        bool was_inside_task = is_inside_task;
+        is_inside_task = true;
+
+        const size_t own = m_worker_nodes[current_worker_index] % m_partition_count;
+
+        // Own part first, then others', starting with the next node
+        const size_t part_count = m_is_stealing? m_partition_count : 1;
+        for (size_t offset = 0; offset < part_count; ++ offset) {
+            partition& current = m_partitions[(own + offset) % m_partition_count];
+
+            size_t tasks = 0, index;
+            while ((index = current.next.fetch_add(1, std::memory_order_relaxed)) < current.end) {
+                (*m_task)(index);
+                ++ tasks;
+            }
+
+            if (m_partition_count > 1 && tasks > 0)
+                (offset == 0? m_partitions[own].local_tasks :
+                              m_partitions[own].stolen_tasks).fetch_add(tasks, std::memory_order_relaxed);
+        }
+
+        is_inside_task = was_inside_task;
+    }
+
+    void thread_pool::run(size_t count, const std::function<void(size_t)>& task) {
+        run_job(count, 1, true, task);
+    }
+
+    void thread_pool::run_partitioned(size_t count, const std::function<void(size_t)>& task) {
+        run_job(count, m_node_count, true, task);
+    }
+
+    void thread_pool::run_on_nodes(size_t count, const std::function<void(size_t)>& task) {
+        run_job(count, m_node_count, false, task);
+    }
+
+    void thread_pool::run_job(size_t count, size_t partition_count, bool is_stealing,
+                              const std::function<void(size_t)>& task) {
+        if (count == 0)
+            return;
+
+        std::unique_lock lock(m_mutex);
+
+        // Pool is either occupied by another thread or we are inside of a task,
+        // either way waiting for workers could deadlock, so just run in place:
+        if (m_is_busy || is_inside_task || m_workers.empty() || count == 1) {
+            lock.unlock();
+
+            for (size_t i = 0; i < count; ++ i)
+                task(i);
+
+            return;
+        }
+
+        m_is_busy = true;
+
+        m_task = &task;
+
+        // Parts are sized by nodes' worker counts, so that nodes finish at about the same time.
+        // Calling thread isn't pinned, so it's only one of them when there are no nodes
+        m_partition_count = partition_count;
+        m_is_stealing = is_stealing;
+
+        const bool is_caller_working = partition_count == 1;
+        const auto first_worker = m_worker_nodes.begin() + (is_caller_working? 0 : 1);
+        const size_t worker_count = (size_t) (m_worker_nodes.end() - first_worker);
+
+        size_t begin = 0, workers_before = 0;
+        for (size_t node = 0; node < partition_count; ++ node) {
+            if (partition_count > 1)
+                workers_before += (size_t) std::count(first_worker, m_worker_nodes.end(), node);
+            else
+                workers_before = worker_count;
+
+            const size_t end = node + 1 == partition_count? count : count * workers_before / worker_count;
+
+            m_partitions[node].next.store(begin, std::memory_order_relaxed);
+            m_partitions[node].end = end;
+
+            begin = end;
+        }
+
+        m_active_workers = m_workers.size();
+        ++ m_generation;
+
+        lock.unlock();
+        m_job_available.notify_all();
+
+        if (is_caller_working)
+            execute_tasks(); // Calling thread works too
+
+        lock.lock();
+        m_job_finished.wait(lock, [this]() { return m_active_workers == 0; });
+
+        m_task = nullptr;
+        m_is_busy = false;
+    }
+
+    void thread_pool::worker_loop(size_t worker_index) {
+        current_worker_index = worker_index;
+
+#ifdef __linux__
+        m_worker_thread_ids[worker_index - 1].store((int) syscall(SYS_gettid));
+        m_worker_thread_ids[worker_index - 1].notify_all();
+#endif
+
+        size_t seen_generation = 0;
+        while (true) {
+            std::unique_lock lock(m_mutex);
+            m_job_available.wait(lock, [&]() {
+                return m_is_stopping || m_generation != seen_generation;
+            });
+
+            if (m_is_stopping)
+                return;
+
+            seen_generation = m_generation;
+            lock.unlock();
+
+            execute_tasks();
+
+            lock.lock();
+            if (-- m_active_workers == 0)
+                m_job_finished.notify_one();
+        }
+    }
+
+    thread_pool::~thread_pool() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_is_stopping = true;
+        }
+
+        m_job_available.notify_all();
+        for (std::thread& worker: m_workers)
+            worker.join();
+    }
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gl {
+
+    class numa_topology;
+
+    // Persistent pool of worker threads for data-parallel loops. Calling thread
+    // participates in the work too (except for partitioned runs of pinned pools),
+    // so pool with N threads runs N - 1 workers.
+    class thread_pool {
+    public:
+        explicit thread_pool(size_t thread_count = std::thread::hardware_concurrency());
+
+        // Pins workers to topology's CPUs (node by node, so that consecutive workers share
+        // a node), if it has several nodes. Calling thread is left alone, it counts as
+        // one of first node's workers for run, but sits out partitioned runs, since it
+        // can be on any node
+        thread_pool(size_t thread_count, const numa_topology& topology);
+
+        // This class shouldn't be copied or moved (workers hold pointer to it)
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        size_t get_thread_count() const noexcept;
+
+        // Calls task(index) for every index in [0, count) and blocks until all of
+        // them finish. Nested calls (from inside of a task) are executed serially.
+        void run(size_t count, const std::function<void(size_t)>& task);
+
+        // Like run, but [0, count) is split into contiguous parts, one per NUMA node (sized by
+        // its worker count), and workers take indices from their own node's part first, only
+        // helping others once it's done. Data laid out in index order (like tiles of a frame)
+        // is then mostly touched by the same node every time, see first_touch
+        void run_partitioned(size_t count, const std::function<void(size_t)>& task);
+
+        // Like run_partitioned, but workers never help other nodes, for tasks that are
+        // there to run on a particular node (like first_touch) rather than to finish early
+        void run_on_nodes(size_t count, const std::function<void(size_t)>& task);
+
+        // Nodes workers are pinned to, 1 for pools that aren't pinned
+        size_t get_node_count() const noexcept;
+
+        // Tasks workers of every node took since last reset, from its own part and from others'
+        // (stolen), for partitioned runs, mostly local ones mean that placement works
+        struct node_stats {
+            size_t local_tasks;
+            size_t stolen_tasks;
+        };
+
+        std::vector<node_stats> get_node_stats() const;
+        void reset_node_stats();
+
+        // Kernel's ids of workers' threads (calling thread isn't one of them), for tools
+        // that attach to threads, like perf_counters. Linux only, empty elsewhere
+        std::vector<int> get_worker_thread_ids() const;
+
+        // Index of the worker executing current task in [0, get_thread_count()),
+        // calling thread is always worker 0. Useful for per-thread buffers.
+        static size_t current_worker() noexcept;
+
+        // Shared pool sized to the number of hardware threads,
+        // pinned to NUMA nodes of the system, if it has several
+        static thread_pool& global();
+
+        ~thread_pool();
+
+    private:
+        std::vector<std::thread> m_workers;
+        std::unique_ptr<std::atomic<int>[]> m_worker_thread_ids; // Zero until worker starts
+
+        std::mutex m_mutex;
+        std::condition_variable m_job_available, m_job_finished;
+
+        // ==> NUMA placement, node of every worker (calling thread is worker 0):
+        std::vector<size_t> m_worker_nodes;
+        size_t m_node_count = 1;
+
+        // Indices of current job, [next, end) are still to be taken
+        struct alignas(64) partition {
+            std::atomic<size_t> next { 0 };
+            size_t end = 0;
+
+            std::atomic<size_t> local_tasks { 0 }, stolen_tasks { 0 }; // Node's counters
+        };
+
+        std::unique_ptr<partition[]> m_partitions; // One per node
+        size_t m_partition_count = 1;              // Used by current job
+        bool m_is_stealing = true;                 // Same
+
+        // ==> Current job:
+        const std::function<void(size_t)>* m_task = nullptr;
+
+        size_t m_active_workers = 0;
+
+        size_t m_generation = 0;
+        bool m_is_stopping = false;
+        bool m_is_busy = false;
+
+        void worker_loop(size_t worker_index);
+        void execute_tasks();
+
+        void start_workers(size_t thread_count);
+        void run_job(size_t count, size_t partition_count, bool is_stealing,
+                     const std::function<void(size_t)>& task);
+    };
+
+    // Splits [begin, end) into chunks of at least /grain/ elements and calls
+    // body(chunk_begin, chunk_end) for each of them in parallel
+    template <typename body_type>
+    void parallel_for(size_t begin, size_t end, size_t grain, body_type&& body,
+                      thread_pool& pool = thread_pool::global()) {
+        if (begin >= end)
+            return;
+
+        if (grain == 0)
+            grain = 1;
+
+        size_t chunk_count = (end - begin + grain - 1) / grain;
+        pool.run(chunk_count, [&](size_t chunk) {
+            size_t chunk_begin = begin + chunk * grain;
+            size_t chunk_end   = chunk_begin + grain < end? chunk_begin + grain : end;
+
+            body(chunk_begin, chunk_end);
+        });
+    }
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace gl {
+
+    // Lock-free handoff of values (e.g. frames) from one producer thread to one consumer
+    // thread. Producer writes into the back buffer and publishes it, consumer takes the
+    // latest published one as its front buffer, neither ever waits for the other: values
+    // published faster than they're consumed are simply replaced by newer ones.
+    //
+    // Third (middle) buffer is the one in flight, it's swapped with the back one on
+    // publish and with the front one on update, exchanges are its only synchronization
+    template <typename value_type>
+    class triple_buffer {
+    public:
+        explicit triple_buffer(const value_type& initial)
+            : m_buffers { initial, initial, initial } {}
+
+        // This class shouldn't be copied or moved (threads hold references into it)
+        triple_buffer(const triple_buffer&) = delete;
+        triple_buffer& operator=(const triple_buffer&) = delete;
+
+        // ==> Producer side:
+
+        value_type& get_back() noexcept { return m_buffers[m_back]; }
+
+        // Makes back buffer the latest value, producer gets an older buffer to write next,
+        // it holds whatever was there before, so it has to be overwritten completely
+        void publish() noexcept {
+            m_back = m_middle.exchange(m_back | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+        }
+
+        // ==> Consumer side:
+
+        // Takes the latest published value as front buffer, returns false
+        // (and keeps the current one) if nothing was published since last time
+        bool update() noexcept {
+            if (!(m_middle.load(std::memory_order_relaxed) & FRESH_BIT))
+                return false;
+
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+            return true;
+        }
+
+        const value_type& get_front() const noexcept { return m_buffers[m_front]; }
+
+    private:
+        static constexpr uint8_t INDEX_MASK = 0b011;
+        static constexpr uint8_t FRESH_BIT  = 0b100; // Middle buffer wasn't consumed yet
+
+        value_type m_buffers[3];
+
+        // Index of the middle buffer and its FRESH_BIT
+        alignas(64) std::atomic<uint8_t> m_middle { 1 };
+
+        // Owned by producer and consumer respectively, kept apart, so that they don't share cache lines
+        alignas(64) uint8_t m_back  = 0;
+        alignas(64) uint8_t m_front = 2;
+    };
+
+}
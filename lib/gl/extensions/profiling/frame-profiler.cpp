@@ -0,0 +1,79 @@
+#include "frame-profiler.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace gl {
+
+    void frame_profiler::begin_frame() {
+        const bool is_enabled = this->is_enabled();
+        if (is_enabled == m_counters.has_value())
+            return;
+
+        std::lock_guard lock(m_mutex);
+
+        if (is_enabled) {
+            m_counters.emplace(get_job_thread_ids(m_pool));
+
+            for (size_t i = 0; i < PERF_EVENT_COUNT; ++ i)
+                m_is_counted[i] = m_counters->is_counted((perf_event) i);
+
+            m_error = m_counters->get_error();
+        } else {
+            m_counters.reset();
+            m_is_counted = {};
+        }
+    }
+
+    frame_profiler::scoped_phase frame_profiler::measure(const char* name) {
+        return scoped_phase(m_counters && is_enabled()? this : nullptr, name);
+    }
+
+    frame_profiler::scoped_phase::scoped_phase(frame_profiler* profiler, const char* name)
+        : m_profiler(profiler), m_name(name) {
+
+        if (m_profiler == nullptr)
+            return;
+
+        m_start_counters = m_profiler->m_counters->read();
+        m_start = std::chrono::steady_clock::now(); // Reading counters isn't part of the phase
+    }
+
+    frame_profiler::scoped_phase::~scoped_phase() {
+        if (m_profiler == nullptr)
+            return;
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+        m_profiler->add(m_name, elapsed.count(), m_profiler->m_counters->read() - m_start_counters);
+    }
+
+    void frame_profiler::add(const char* name, double seconds, const perf_sample& counters) {
+        std::lock_guard lock(m_mutex);
+
+        auto phase = std::find_if(m_stats.begin(), m_stats.end(),
+                                  [&](const phase_stats& current) { return current.name == name; });
+
+        if (phase == m_stats.end())
+            phase = m_stats.insert(m_stats.end(), { name, 0, 0.0, {} });
+
+        ++ phase->calls;
+        phase->seconds  += seconds;
+        phase->counters += counters;
+    }
+
+    std::vector<frame_profiler::phase_stats> frame_profiler::take_stats() {
+        std::lock_guard lock(m_mutex);
+        return std::exchange(m_stats, {});
+    }
+
+    bool frame_profiler::is_counted(perf_event event) const {
+        std::lock_guard lock(m_mutex);
+        return m_is_counted[(size_t) event];
+    }
+
+    std::string frame_profiler::get_error() const {
+        std::lock_guard lock(m_mutex);
+        return m_error;
+    }
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "perf-counters.h"
+#include "thread-pool.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace gl {
+
+    // Wall time and hardware counters of frames' phases (like begin_frame, tiles and
+    // end_frame of pixel_drawing_window), summed until someone takes them. It's off
+    // by default, then measuring a phase costs one atomic load.
+    //
+    // Can be switched from any thread, counters are opened (or closed) by the next
+    // begin_frame, for its thread and pool's workers, which is where frame's work runs.
+    // Phases are measured on that same thread, stats can be taken from any
+    class frame_profiler {
+    public:
+        explicit frame_profiler(thread_pool& pool = thread_pool::global()): m_pool(pool) {}
+
+        frame_profiler(const frame_profiler&) = delete;
+        frame_profiler& operator=(const frame_profiler&) = delete;
+
+        void set_enabled(bool is_enabled) { m_is_enabled.store(is_enabled, std::memory_order_relaxed); }
+        bool is_enabled() const { return m_is_enabled.load(std::memory_order_relaxed); }
+
+        // Call before anything of the frame is measured
+        void begin_frame();
+
+        // Measures from construction till destruction, phases can nest
+        // (then outer one includes everything inner one measured)
+        class scoped_phase {
+        public:
+            scoped_phase(const scoped_phase&) = delete;
+            scoped_phase& operator=(const scoped_phase&) = delete;
+
+            ~scoped_phase();
+
+        private:
+            friend class frame_profiler;
+
+            scoped_phase(frame_profiler* profiler, const char* name);
+
+            frame_profiler* m_profiler; // Null when nothing is measured
+            const char* m_name;
+
+            std::chrono::steady_clock::time_point m_start;
+            perf_sample m_start_counters;
+        };
+
+        [[nodiscard]] scoped_phase measure(const char* name);
+
+        struct phase_stats {
+            std::string name;
+            size_t calls;
+
+            double seconds;       // All calls together
+            perf_sample counters; // Same
+        };
+
+        // Phases measured since last call (in order they were first measured in), then starts over
+        std::vector<phase_stats> take_stats();
+
+        // Whether counters are open and count /event/ (they count nothing while profiler is off)
+        bool is_counted(perf_event event) const;
+
+        // Why some (or every) event isn't counted, see perf_counters::get_error
+        std::string get_error() const;
+
+    private:
+        thread_pool& m_pool;
+
+        std::atomic<bool> m_is_enabled { false };
+        std::optional<perf_counters> m_counters; // Only frame's thread touches it
+
+        mutable std::mutex m_mutex; // Guards everything below
+        std::vector<phase_stats> m_stats;
+
+        std::array<bool, PERF_EVENT_COUNT> m_is_counted {};
+        std::string m_error;
+
+        void add(const char* name, double seconds, const perf_sample& counters);
+    };
+
+}
@@ -0,0 +1,230 @@
+#include "perf-counters.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gl {
+
+    const char* get_name(perf_event event) {
+        switch (event) {
+        case perf_event::CYCLES:        return "cycles";
+        case perf_event::INSTRUCTIONS:  return "instructions";
+        case perf_event::L1D_MISSES:    return "l1d_misses";
+        case perf_event::LLC_MISSES:    return "llc_misses";
+        case perf_event::DTLB_MISSES:   return "dtlb_misses";
+        case perf_event::BRANCH_MISSES: return "branch_misses";
+        }
+
+        return "unknown";
+    }
+
+#ifdef __linux__
+
+    // Type and config of perf_event_attr that count /event/
+    static std::pair<uint32_t, uint64_t> get_perf_config(perf_event event) {
+        static constexpr uint64_t READ_MISS = PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                              PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        switch (event) {
+        case perf_event::CYCLES:        return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES       };
+        case perf_event::INSTRUCTIONS:  return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS     };
+        case perf_event::L1D_MISSES:    return { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D  | READ_MISS };
+        case perf_event::LLC_MISSES:    return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES     };
+        case perf_event::DTLB_MISSES:   return { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | READ_MISS };
+        case perf_event::BRANCH_MISSES: return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES    };
+        }
+
+        return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES };
+    }
+
+    static std::string describe_error(int error) {
+        switch (error) {
+        case EACCES: case EPERM:
+            return "not permitted (see /proc/sys/kernel/perf_event_paranoid)";
+
+        case ENOENT: case EOPNOTSUPP:
+            return "not supported by this CPU";
+
+        case ENOSYS:
+            return "perf events aren't supported by the kernel";
+
+        default:
+            return std::strerror(error);
+        }
+    }
+
+    // Opens /event/ for /thread_id/, in /leader/'s group (or as a leader, when it's -1)
+    static int open_event(perf_event event, int thread_id, int leader) {
+        const auto [type, config] = get_perf_config(event);
+
+        perf_event_attr attributes;
+        std::memset(&attributes, 0, sizeof(attributes));
+
+        attributes.size   = sizeof(attributes);
+        attributes.type   = type;
+        attributes.config = config;
+
+        // User space only, which is also what unprivileged users are allowed to count
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv     = 1;
+
+        // Lets read() scale counts up when kernel multiplexes counters,
+        // group's members are read through its leader, all at once
+        attributes.read_format = PERF_FORMAT_GROUP |
+                                 PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        return (int) syscall(SYS_perf_event_open, &attributes, thread_id, -1, leader, PERF_FLAG_FD_CLOEXEC);
+    }
+
+    perf_counters::perf_counters(std::span<const int> thread_ids) {
+        // Counted on the same counters at the same time, so that IPC is exact
+        static constexpr perf_event GROUPED[] = { perf_event::CYCLES, perf_event::INSTRUCTIONS };
+
+        std::array<int, PERF_EVENT_COUNT> errors {};
+
+        auto open_group = [&](std::span<const perf_event> events, int thread_id) {
+            group current = { -1, {}, {} };
+
+            for (perf_event event: events) {
+                const int descriptor = open_event(event, thread_id, current.leader);
+                if (descriptor < 0) {
+                    errors[(size_t) event] = errno;
+                    continue;
+                }
+
+                if (current.leader < 0)
+                    current.leader = descriptor;
+
+                current.descriptors.push_back(descriptor);
+                current.events.push_back(event);
+            }
+
+            if (current.leader >= 0)
+                m_groups.push_back(std::move(current));
+        };
+
+        for (int thread_id: thread_ids) {
+            open_group(GROUPED, thread_id);
+
+            for (size_t i = 0; i < PERF_EVENT_COUNT; ++ i) {
+                const perf_event event = (perf_event) i;
+                if (std::find(std::begin(GROUPED), std::end(GROUPED), event) == std::end(GROUPED))
+                    open_group(std::span(&event, 1), thread_id);
+            }
+        }
+
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++ i) {
+            const perf_event event = (perf_event) i;
+            const int error = errors[i];
+
+            // Thread has already exited, others may still be there
+            if (error == 0 || error == ESRCH) {
+                m_is_counted[i] = std::any_of(m_groups.begin(), m_groups.end(), [&](const group& current) {
+                    return std::find(current.events.begin(), current.events.end(), event) != current.events.end();
+                });
+
+                continue;
+            }
+
+            // Event is either counted on every thread, or on none (those
+            // that did open stay open, members can't leave their group)
+            if (!m_error.empty())
+                m_error += ", ";
+
+            m_error += std::string(get_name(event)) + ": " + describe_error(error);
+        }
+    }
+
+    perf_sample perf_counters::read() const {
+        perf_sample sample;
+
+        for (const group& current: m_groups) {
+            // Layout of PERF_FORMAT_GROUP: count, both times, then one value per event
+            std::array<uint64_t, 3 + PERF_EVENT_COUNT> values {};
+
+            const ssize_t size = (ssize_t) ((3 + current.events.size()) * sizeof(uint64_t));
+            if (::read(current.leader, values.data(), (size_t) size) != size)
+                continue;
+
+            const uint64_t time_enabled = values[1], time_running = values[2];
+            for (size_t i = 0; i < current.events.size() && i < values[0]; ++ i) {
+                if (!m_is_counted[(size_t) current.events[i]])
+                    continue; // Failed on some other thread
+
+                perf_sample::count& count = sample.counts[(size_t) current.events[i]];
+                count.value        += values[3 + i];
+                count.time_enabled += time_enabled;
+                count.time_running += time_running;
+            }
+        }
+
+        return sample;
+    }
+
+    void perf_counters::close() {
+        for (const group& current: m_groups)
+            for (int descriptor: current.descriptors)
+                ::close(descriptor);
+
+        m_groups.clear();
+    }
+
+    int get_current_thread_id() {
+        return (int) syscall(SYS_gettid);
+    }
+
+#else
+
+    perf_counters::perf_counters(std::span<const int> /* thread_ids */)
+        : m_error("perf events are only supported on Linux") {}
+
+    perf_sample perf_counters::read() const { return {}; }
+
+    void perf_counters::close() {}
+
+    int get_current_thread_id() { return 0; }
+
+#endif
+
+    perf_counters::perf_counters(perf_counters&& other) noexcept
+        : m_groups(std::exchange(other.m_groups, {})),
+          m_is_counted(std::exchange(other.m_is_counted, {})),
+          m_error(std::move(other.m_error)) {}
+
+    perf_counters& perf_counters::operator=(perf_counters&& other) noexcept {
+        if (this != &other) {
+            close();
+
+            m_groups     = std::exchange(other.m_groups, {});
+            m_is_counted = std::exchange(other.m_is_counted, {});
+            m_error      = std::move(other.m_error);
+        }
+
+        return *this;
+    }
+
+    perf_counters::~perf_counters() {
+        close();
+    }
+
+    bool perf_counters::is_available() const {
+        return std::any_of(m_is_counted.begin(), m_is_counted.end(), [](bool is_counted) { return is_counted; });
+    }
+
+    std::vector<int> get_job_thread_ids(const thread_pool& pool) {
+        std::vector<int> ids = pool.get_worker_thread_ids();
+
+        if (const int current = get_current_thread_id(); current != 0)
+            ids.insert(ids.begin(), current);
+
+        return ids;
+    }
+
+}
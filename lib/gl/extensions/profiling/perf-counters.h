@@ -0,0 +1,131 @@
+#pragma once
+
+#include "thread-pool.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace gl {
+
+    // Hardware events perf_counters count, in the order of perf_sample's counts
+    enum class perf_event {
+        CYCLES, INSTRUCTIONS,
+        L1D_MISSES,   // Level 1 data cache read misses
+        LLC_MISSES,   // Last level cache misses, that is, trips to memory
+        DTLB_MISSES,  // Data TLB read misses
+        BRANCH_MISSES // Mispredicted branches
+    };
+
+    inline constexpr size_t PERF_EVENT_COUNT = 6;
+
+    // Short lowercase name, e.g. "l1d_misses"
+    const char* get_name(perf_event event);
+
+    struct perf_sample {
+        // Raw count and how long it was counted for, out of time it was enabled
+        // (less when kernel multiplexed counters), summed over threads
+        struct count {
+            uint64_t value = 0;
+            uint64_t time_enabled = 0;
+            uint64_t time_running = 0;
+        };
+
+        std::array<count, PERF_EVENT_COUNT> counts {};
+
+        // Count scaled up to the whole time it was enabled
+        uint64_t operator[](perf_event event) const {
+            const count& current = counts[(size_t) event];
+            if (current.time_running == 0 || current.time_running >= current.time_enabled)
+                return current.value;
+
+            return (uint64_t) ((double) current.value * (double) current.time_enabled /
+                                                        (double) current.time_running);
+        }
+
+        perf_sample& operator+=(const perf_sample& other) {
+            for (size_t i = 0; i < PERF_EVENT_COUNT; ++ i) {
+                counts[i].value        += other.counts[i].value;
+                counts[i].time_enabled += other.counts[i].time_enabled;
+                counts[i].time_running += other.counts[i].time_running;
+            }
+
+            return *this;
+        }
+
+        // Raw counts and times only grow, so later sample minus earlier one is what happened
+        // in between. Only that difference is scaled, scaled totals can go backwards
+        perf_sample operator-(const perf_sample& earlier) const {
+            perf_sample difference;
+            for (size_t i = 0; i < PERF_EVENT_COUNT; ++ i) {
+                difference.counts[i].value        = counts[i].value        - earlier.counts[i].value;
+                difference.counts[i].time_enabled = counts[i].time_enabled - earlier.counts[i].time_enabled;
+                difference.counts[i].time_running = counts[i].time_running - earlier.counts[i].time_running;
+            }
+
+            return difference;
+        }
+    };
+
+    // Hardware counters (through Linux's perf_event_open) of a set of threads, counted
+    // together, in user space only. Cycles and instructions are opened as one group,
+    // so they're always counted over the same time and IPC is exact. Other events are
+    // opened on their own, so events CPU doesn't have (or has too few counters for)
+    // don't take the rest down with them. When kernel multiplexes them, each is scaled
+    // up from its own share of time, so their ratios to each other (like misses per
+    // instruction) are estimates, and only mean much over long enough phases.
+    //
+    // Counting can be forbidden (see /proc/sys/kernel/perf_event_paranoid), or
+    // missing altogether (e.g. in VMs, or not on Linux), then nothing is counted,
+    // samples stay zero and get_error says why
+    class perf_counters {
+    public:
+        // Counts nothing
+        perf_counters() = default;
+
+        // Counters start counting right away, threads that exit stop being counted
+        explicit perf_counters(std::span<const int> thread_ids);
+
+        perf_counters(const perf_counters&) = delete;
+        perf_counters& operator=(const perf_counters&) = delete;
+
+        perf_counters(perf_counters&& other) noexcept;
+        perf_counters& operator=(perf_counters&& other) noexcept;
+
+        ~perf_counters();
+
+        bool is_available() const;
+        bool is_counted(perf_event event) const { return m_is_counted[(size_t) event]; }
+
+        // Why some (or every) event isn't counted, empty if all of them are
+        const std::string& get_error() const { return m_error; }
+
+        // Events so far, summed over threads
+        perf_sample read() const;
+
+    private:
+        // Leader's descriptor reads counts of the whole group at once
+        struct group {
+            int leader;
+            std::vector<int> descriptors;  // Leader's, then members'
+            std::vector<perf_event> events; // Same order
+        };
+
+        std::vector<group> m_groups;
+
+        std::array<bool, PERF_EVENT_COUNT> m_is_counted {};
+        std::string m_error;
+
+        void close();
+    };
+
+    // Kernel's id of calling thread, 0 where there is no such thing
+    int get_current_thread_id();
+
+    // Threads that do the work of /pool/'s jobs run from calling thread: it and pool's workers
+    std::vector<int> get_job_thread_ids(const thread_pool& pool = thread_pool::global());
+
+}
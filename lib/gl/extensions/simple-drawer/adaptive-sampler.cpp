@@ -0,0 +1,194 @@
+#include "adaptive-sampler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace gl {
+
+    namespace {
+
+        // Pixel is split into 4x4 strata, consecutive samples visit them in this
+        // order, so that any few of them in a row are spread over the pixel
+        constexpr int STRATA_SIDE = 4;
+        constexpr int STRATA_ORDER[STRATA_SIDE * STRATA_SIDE] = {
+            0, 10, 5, 15, 2, 8, 7, 13, 1, 11, 4, 14, 3, 9, 6, 12
+        };
+
+        // Integer hash (by Chris Wellons), jitter inside of strata is derived from it
+        // instead of a random generator, so that images are reproducible
+        uint32_t hash(uint32_t value) {
+            value ^= value >> 16;
+            value *= 0x7feb352du;
+            value ^= value >> 15;
+            value *= 0x846ca68bu;
+            value ^= value >> 16;
+
+            return value;
+        }
+
+        float to_unit(uint32_t value) {
+            return (float) (value >> 8) * (1.0f / (float) (1u << 24));
+        }
+
+    }
+
+    adaptive_sampler::adaptive_sampler(int width, int height, adaptive_sampling_settings settings)
+        : m_width(width), m_height(height),
+          m_tile_rows((height + TILE_SIZE - 1) / TILE_SIZE), m_tile_columns((width + TILE_SIZE - 1) / TILE_SIZE),
+          m_settings(settings) {
+
+        const size_t pixel_count = (size_t) width * height;
+
+        m_red  .assign(pixel_count, 0.0f);
+        m_green.assign(pixel_count, 0.0f);
+        m_blue .assign(pixel_count, 0.0f);
+
+        m_luminance_squares.assign(pixel_count, 0.0f);
+        m_counts.assign(pixel_count, 0);
+
+        m_is_active.assign((size_t) m_tile_rows * m_tile_columns, 1);
+    }
+
+    const adaptive_sampling_stats& adaptive_sampler::refine(const sample_function& sample, gl::thread_pool& pool) {
+        if (m_stats.is_finished)
+            return m_stats;
+
+        if (m_stats.rounds == 0)
+            m_start = std::chrono::steady_clock::now();
+
+        // First round just covers every pixel once
+        const int samples = m_stats.rounds == 0? 1 : m_settings.samples_per_round;
+
+        std::vector<size_t> active_tiles;
+        for (size_t tile = 0; tile < m_is_active.size(); ++ tile)
+            if (m_is_active[tile])
+                active_tiles.push_back(tile);
+
+        std::atomic<size_t> taken_samples { 0 };
+        pool.run(active_tiles.size(), [&](size_t index) {
+            const int tile_row    = (int) (active_tiles[index] / m_tile_columns);
+            const int tile_column = (int) (active_tiles[index] % m_tile_columns);
+
+            taken_samples.fetch_add(sample_tile(tile_row, tile_column, samples, sample),
+                                    std::memory_order_relaxed);
+        });
+
+        m_stats.samples = taken_samples.load();
+        m_stats.total_samples += m_stats.samples;
+        m_stats.refined_tiles = active_tiles.size();
+        ++ m_stats.rounds;
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_start;
+        m_stats.is_finished = find_active_tiles(pool) == 0 || elapsed.count() >= m_settings.time_budget;
+
+        return m_stats;
+    }
+
+    size_t adaptive_sampler::sample_tile(int tile_row, int tile_column, int samples, const sample_function& sample) {
+        const int row_end    = std::min(m_height, (tile_row    + 1) * TILE_SIZE);
+        const int column_end = std::min(m_width,  (tile_column + 1) * TILE_SIZE);
+
+        size_t taken = 0;
+
+        for (int i = tile_row * TILE_SIZE; i < row_end; ++ i)
+            for (int j = tile_column * TILE_SIZE; j < column_end; ++ j) {
+                const size_t pixel = (size_t) i * m_width + j;
+
+                const uint32_t first = m_counts[pixel];
+                const uint32_t last  = std::min<uint32_t>(first + samples, m_settings.max_samples);
+
+                for (uint32_t index = first; index < last; ++ index) {
+                    // Stratum first, then jittered point in it
+                    const int stratum = STRATA_ORDER[index % (STRATA_SIDE * STRATA_SIDE)];
+
+                    const uint32_t seed = hash((uint32_t) pixel * 0x9e3779b9u + index);
+                    const float u = to_unit(seed), v = to_unit(hash(seed));
+
+                    const float offset_i = ((float) (stratum / STRATA_SIDE) + u) / STRATA_SIDE - 0.5f;
+                    const float offset_j = ((float) (stratum % STRATA_SIDE) + v) / STRATA_SIDE - 0.5f;
+
+                    const math::vec3 color = sample((float) i + offset_i, (float) j + offset_j);
+
+                    m_red  [pixel] += color[0];
+                    m_green[pixel] += color[1];
+                    m_blue [pixel] += color[2];
+
+                    const float luminance = 0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2];
+                    m_luminance_squares[pixel] += luminance * luminance;
+                }
+
+                taken += last - first;
+                m_counts[pixel] = last;
+            }
+
+        return taken;
+    }
+
+    float adaptive_sampler::get_luminance(size_t pixel) const {
+        const float count = (float) std::max<uint32_t>(m_counts[pixel], 1);
+        return (0.2126f * m_red[pixel] + 0.7152f * m_green[pixel] + 0.0722f * m_blue[pixel]) / count;
+    }
+
+    float adaptive_sampler::get_error(int i, int j) const {
+        const size_t pixel = (size_t) i * m_width + j;
+        const uint32_t count = m_counts[pixel];
+
+        if (count >= (uint32_t) m_settings.max_samples)
+            return 0.0f; // Can't do any better
+
+        if (count == 0)
+            return std::numeric_limits<float>::infinity();
+
+        const float mean = get_luminance(pixel);
+
+        if (count == 1) {
+            // Variance can't be estimated from one sample yet, contrast with
+            // neighbors tells if there's anything going on around
+            float contrast = 0.0f;
+
+            static constexpr int NEIGHBORS[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+            for (const auto& offset: NEIGHBORS) {
+                const int ni = i + offset[0], nj = j + offset[1];
+                if (ni < 0 || ni >= m_height || nj < 0 || nj >= m_width)
+                    continue;
+
+                contrast = std::max(contrast, std::abs(mean - get_luminance((size_t) ni * m_width + nj)));
+            }
+
+            return contrast;
+        }
+
+        const float variance = (m_luminance_squares[pixel] - mean * mean * (float) count) / (float) (count - 1);
+        return std::sqrt(std::max(variance, 0.0f) / (float) count);
+    }
+
+    size_t adaptive_sampler::find_active_tiles(gl::thread_pool& pool) {
+        std::atomic<size_t> active_count { 0 };
+
+        pool.run(m_is_active.size(), [&](size_t tile) {
+            const int tile_row    = (int) (tile / m_tile_columns);
+            const int tile_column = (int) (tile % m_tile_columns);
+
+            float error = 0.0f;
+            for (int i = tile_row * TILE_SIZE; i < std::min(m_height, (tile_row + 1) * TILE_SIZE); ++ i)
+                for (int j = tile_column * TILE_SIZE; j < std::min(m_width, (tile_column + 1) * TILE_SIZE); ++ j)
+                    error = std::max(error, get_error(i, j));
+
+            m_is_active[tile] = error > m_settings.error_threshold;
+            if (m_is_active[tile])
+                active_count.fetch_add(1, std::memory_order_relaxed);
+        });
+
+        return active_count.load();
+    }
+
+    math::vec3 adaptive_sampler::get_color(int i, int j) const {
+        const size_t pixel = (size_t) i * m_width + j;
+        const float inverse_count = 1.0f / (float) std::max<uint32_t>(m_counts[pixel], 1);
+
+        return { m_red[pixel] * inverse_count, m_green[pixel] * inverse_count, m_blue[pixel] * inverse_count };
+    }
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "thread-pool.h"
+#include "vec.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace gl {
+
+    struct adaptive_sampling_settings {
+        // Tiles are refined while estimated error of any of their pixels'
+        // luminance (standard error of the mean) is above this
+        float error_threshold = 1.0f / 255.0f;
+
+        // Samples every pixel of a refined tile gets per round
+        int samples_per_round = 4;
+
+        int max_samples = 256; // Per pixel
+
+        // Whole image, refinement stops when it runs out
+        double time_budget = 30.0; // In seconds
+    };
+
+    struct adaptive_sampling_stats {
+        size_t samples = 0;       // Taken during last round
+        size_t total_samples = 0; // Taken since sampling started
+
+        size_t refined_tiles = 0; // During last round
+
+        int rounds = 0;
+        bool is_finished = false; // Quality or budget is reached
+    };
+
+    // Progressive adaptive sampler: first round takes one sample in every pixel, every
+    // next one only refines tiles where estimated error is too high, with stratified
+    // samples, until error is low enough everywhere or budget is spent.
+    //
+    // Error of a pixel is the standard error of its mean luminance, pixels that have
+    // only one sample yet use contrast with their neighbors instead
+    class adaptive_sampler {
+    public:
+        static constexpr int TILE_SIZE = 8;
+
+        // Color of the sample at (i, j) in pixel coordinates (pixel's center is at integer
+        // ones, its area extends by half a pixel around it), called concurrently
+        using sample_function = std::function<math::vec3(float i, float j)>;
+
+        adaptive_sampler(int width, int height, adaptive_sampling_settings settings = {});
+
+        // Does one round of sampling, returns its stats, does nothing once finished
+        const adaptive_sampling_stats& refine(const sample_function& sample,
+                                              gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Average of pixel's samples
+        math::vec3 get_color(int i, int j) const;
+
+        const adaptive_sampling_stats& get_stats() const { return m_stats; }
+        bool is_finished() const { return m_stats.is_finished; }
+
+    private:
+        int m_width, m_height;
+        int m_tile_rows, m_tile_columns;
+
+        adaptive_sampling_settings m_settings;
+        adaptive_sampling_stats m_stats;
+
+        std::chrono::steady_clock::time_point m_start;
+
+        // ==> Per pixel (at i * width + j):
+        std::vector<float> m_red, m_green, m_blue; // Sums of samples
+        std::vector<float> m_luminance_squares;    // Sum of squared luminances
+        std::vector<uint32_t> m_counts;
+
+        // Per tile, whether it still needs samples
+        std::vector<uint8_t> m_is_active;
+
+        // Returns number of samples taken (pixels stop at max_samples)
+        size_t sample_tile(int tile_row, int tile_column, int samples, const sample_function& sample);
+
+        float get_luminance(size_t pixel) const;
+        float get_error(int i, int j) const;
+
+        // Marks tiles that need more samples, returns their count
+        size_t find_active_tiles(gl::thread_pool& pool);
+    };
+
+}
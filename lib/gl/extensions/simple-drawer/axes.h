@@ -34,6 +34,13 @@ namespace math {
             //            ^~ Convert to target basis
         }
 
+        // View coordinates are world ones scaled and shifted, independently for each
+        // coordinate, so get_view_coordinates(p) is p * get_view_scale() + get_view_offset()
+        math::vec2 get_view_offset() const { return get_view_coordinates({ 0.0f, 0.0f }); }
+        math::vec2 get_view_scale()  const {
+            return get_view_coordinates({ 1.0f, 1.0f }) - get_view_offset();
+        }
+
         math::vec2 get_world_coordinates(math::vec2 source) const {
             return axes(m_view, m_world).get_view_coordinates(source);
         }
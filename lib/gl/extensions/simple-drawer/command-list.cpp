@@ -0,0 +1,163 @@
+#include "command-list.h"
+#include "drawing-manager.h"
+
+#include <cassert>
+
+namespace gl {
+
+    // ==> Recording:
+
+    void command_list::set_color(math::vec3 color) {
+        add(command_type::COLOR, {}, { color.r(), color.g(), color.b() });
+    }
+
+    void command_list::set_width(float width) {
+        add(command_type::WIDTH, {}, { width });
+    }
+
+    void command_list::set_axes(math::axes axes) {
+        add(command_type::AXES, { axes.m_world.x0, axes.m_world.x1, axes.m_view.x0, axes.m_view.x1 }, {});
+    }
+
+    void command_list::draw_interpolated_triangle(colored_vertex p0, colored_vertex p1, colored_vertex p2) {
+        add(command_type::INTERPOLATED_TRIANGLE, { p0.point, p1.point, p2.point }, {
+            p0.color.r(), p0.color.g(), p0.color.b(),
+            p1.color.r(), p1.color.g(), p1.color.b(),
+            p2.color.r(), p2.color.g(), p2.color.b()
+        });
+    }
+
+    void command_list::draw_triangle(math::vec2 p0, math::vec2 p1, math::vec2 p2) {
+        add(command_type::TRIANGLE, { p0, p1, p2 }, {});
+    }
+
+    void command_list::draw_rectangle(math::vec2 x0, math::vec2 x1) {
+        add(command_type::RECTANGLES, { x0, x1 }, {});
+    }
+
+    void command_list::draw_line(math::vec2 from, math::vec2 to) {
+        add(command_type::LINES, { from, to }, {});
+    }
+
+    void command_list::draw_antialiased_line(math::vec2 from, math::vec2 to, float antialiasing_level) {
+        add(command_type::ANTIALIASED_LINE, { from, to }, { antialiasing_level });
+    }
+
+    void command_list::draw_vector(math::vec2 from, math::vec2 to) {
+        add(command_type::VECTORS, { from, to }, {});
+    }
+
+    void command_list::draw_lines(std::span<const math::vec2> from, std::span<const math::vec2> to) {
+        add_pairs(command_type::LINES, from, to);
+    }
+
+    void command_list::draw_vectors(std::span<const math::vec2> from, std::span<const math::vec2> to) {
+        add_pairs(command_type::VECTORS, from, to);
+    }
+
+    void command_list::draw_rectangles(std::span<const math::vec2> x0, std::span<const math::vec2> x1) {
+        add_pairs(command_type::RECTANGLES, x0, x1);
+    }
+
+    void command_list::add(command_type type, std::initializer_list<math::vec2> points,
+                           std::initializer_list<float> values) {
+
+        m_commands.push_back({ type, (uint32_t) m_points.size(), (uint32_t) points.size(),
+                                     (uint32_t) m_values.size(), (uint32_t) values.size() });
+
+        m_points.insert(m_points.end(), points);
+        m_values.insert(m_values.end(), values);
+    }
+
+    void command_list::add_pairs(command_type type, std::span<const math::vec2> first,
+                                 std::span<const math::vec2> second) {
+        assert(first.size() == second.size());
+
+        m_commands.push_back({ type, (uint32_t) m_points.size(), (uint32_t) (first.size() + second.size()),
+                                     (uint32_t) m_values.size(), 0 });
+
+        m_points.insert(m_points.end(), first.begin(), first.end());
+        m_points.insert(m_points.end(), second.begin(), second.end());
+    }
+
+    void command_list::clear() {
+        // Keeps capacity, so recording the same list again doesn't allocate
+        m_commands.clear();
+        m_points.clear();
+        m_values.clear();
+    }
+
+    // ==> Replaying:
+
+    void command_list::replay(drawing_manager& manager) const {
+        for (const command& current: m_commands) {
+            const math::vec2* points = m_points.data() + current.first_point;
+            const float*      values = m_values.data() + current.first_value;
+
+            // Pairs of spans, see add_pairs
+            std::span<const math::vec2> first (points, current.point_count / 2);
+            std::span<const math::vec2> second(points + current.point_count / 2, current.point_count / 2);
+
+            switch (current.type) {
+            case command_type::COLOR: manager.set_color({ values[0], values[1], values[2] }); break;
+            case command_type::WIDTH: manager.set_width(values[0]);                           break;
+
+            case command_type::AXES:
+                manager.set_axes(math::axes(math::rectangle { points[0], points[1] },
+                                            math::rectangle { points[2], points[3] }));
+                break;
+
+            case command_type::INTERPOLATED_TRIANGLE:
+                manager.draw_interpolated_triangle({ points[0], { values[0], values[1], values[2] } },
+                                                   { points[1], { values[3], values[4], values[5] } },
+                                                   { points[2], { values[6], values[7], values[8] } });
+                break;
+
+            case command_type::TRIANGLE:
+                manager.draw_triangle(points[0], points[1], points[2]);
+                break;
+
+            case command_type::ANTIALIASED_LINE:
+                manager.draw_antialiased_line(points[0], points[1], values[0]);
+                break;
+
+            // Single shapes don't need batching
+            case command_type::RECTANGLES:
+                if (current.point_count == 2) manager.draw_rectangle(points[0], points[1]);
+                else manager.draw_rectangles(first, second);
+                break;
+
+            case command_type::LINES:
+                if (current.point_count == 2) manager.draw_line(points[0], points[1]);
+                else manager.draw_lines(first, second);
+                break;
+
+            case command_type::VECTORS:
+                if (current.point_count == 2) manager.draw_vector(points[0], points[1]);
+                else manager.draw_vectors(first, second);
+                break;
+            }
+        }
+    }
+
+    // ==> Hashing:
+
+    uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++ i)
+            hash = (hash ^ bytes[i]) * 0x100000001B3;
+
+        return hash;
+    }
+
+    uint64_t command_list::hash() const {
+        uint64_t hash = HASH_SEED;
+
+        hash = hash_bytes(hash, m_commands.data(), m_commands.size() * sizeof(command));
+        hash = hash_bytes(hash, m_points  .data(), m_points  .size() * sizeof(math::vec2));
+        hash = hash_bytes(hash, m_values  .data(), m_values  .size() * sizeof(float));
+
+        return hash;
+    }
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "axes.h"
+#include "colored-vertex.h"
+#include "vec.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace gl {
+
+    class drawing_manager;
+
+    // Drawing calls recorded for later, with the same interface as drawing_manager,
+    // so that drawing code can be written once, for either of them (with auto&).
+    // Recorded lists are cheap to compare (see hash), and replayed only when
+    // something actually changed, see retained_lists
+    class command_list {
+    public:
+        // ==> Control current settings:
+
+        void set_color(math::vec3 color);
+
+        void set_width(float width);
+        void set_axes(math::axes axes);
+
+        // ==> Draw shapes:
+
+        void draw_interpolated_triangle(colored_vertex p0, colored_vertex p1, colored_vertex p2);
+
+        void draw_triangle(math::vec2 p0, math::vec2 p1, math::vec2 p2);
+
+        void draw_rectangle(math::vec2 x0, math::vec2 x1);
+
+        void draw_line(math::vec2 from, math::vec2 to);
+        void draw_antialiased_line(math::vec2 from, math::vec2 to,
+                                   float antialiasing_level = 0.8f);
+
+        void draw_vector(math::vec2 from, math::vec2 to);
+
+        // ==> Draw many shapes at once:
+
+        void draw_lines     (std::span<const math::vec2> from, std::span<const math::vec2> to);
+        void draw_vectors   (std::span<const math::vec2> from, std::span<const math::vec2> to);
+        void draw_rectangles(std::span<const math::vec2> x0,   std::span<const math::vec2> x1);
+
+        // ==> Recorded commands:
+
+        void clear();
+        bool is_empty() const { return m_commands.empty(); }
+
+        // Issues every recorded call to /manager/, in order
+        void replay(drawing_manager& manager) const;
+
+        // Of everything recorded, lists that record the same calls hash the same
+        uint64_t hash() const;
+
+    private:
+        enum class command_type: uint32_t {
+            COLOR, WIDTH, AXES,
+            INTERPOLATED_TRIANGLE, TRIANGLE, ANTIALIASED_LINE,
+            RECTANGLES, LINES, VECTORS
+        };
+
+        // Arguments are ranges of shared point and value streams, so that
+        // recording doesn't allocate per command once streams have grown
+        struct command {
+            command_type type;
+            uint32_t first_point, point_count;
+            uint32_t first_value, value_count;
+        };
+
+        void add(command_type type, std::initializer_list<math::vec2> points,
+                 std::initializer_list<float> values);
+
+        // Pairs of spans become command's first and second halves of points
+        void add_pairs(command_type type, std::span<const math::vec2> first,
+                       std::span<const math::vec2> second);
+
+        std::vector<command> m_commands;
+
+        std::vector<math::vec2> m_points;
+        std::vector<float> m_values;
+    };
+
+    // FNV-1a of /size/ bytes, continued from /hash/ (start with HASH_SEED)
+    inline constexpr uint64_t HASH_SEED = 0xCBF29CE484222325;
+    uint64_t hash_bytes(uint64_t hash, const void* data, size_t size);
+
+}
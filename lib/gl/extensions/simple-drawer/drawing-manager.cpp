@@ -1,15 +1,79 @@
 #include "colored-vertex.h"
 #include "math.h"
 #include "drawing-manager.h"
+#include "retained-lists.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <iostream>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 namespace gl {
 
     void drawing_manager::set_color(math::vec3 color) {
         m_current_color = { color.r(), color.g(), color.b() };
     }
 
-    void drawing_manager::set_axes(math::axes axes) { m_axes = axes; }
+    void drawing_manager::set_axes(math::axes axes) {
+        m_axes = axes;
+
+        if (m_instances != nullptr)
+            m_instances->set_axes(axes);
+    }
+
+    void drawing_manager::add_instance(primitive_shape shape, math::vec2 from, math::vec2 to) {
+        m_instances->add(shape, { from, to, m_width, primitive_instance::pack_color(m_current_color) });
+    }
+
+    drawing_manager drawing_manager::make_worker(colored_vertex_array& chunk) const {
+        drawing_manager worker { chunk };
+
+        worker.m_axes = m_axes;
+        worker.m_current_color = m_current_color;
+        worker.m_width = m_width;
+
+        return worker;
+    }
+
+    command_list* drawing_manager::begin_retained(std::string_view name, std::optional<uint64_t> version) {
+        if (m_retained != nullptr)
+            return m_retained->begin(name, version, *this);
+
+        m_immediate_list.clear();
+        return &m_immediate_list;
+    }
+
+    void drawing_manager::end_retained() {
+        if (m_retained != nullptr) {
+            m_retained->end();
+            return;
+        }
+
+        // List's settings stay inside it, same as when it's retained
+        const math::axes axes = m_axes;
+        const math::vec3 color = m_current_color;
+        const float width = m_width;
+
+        m_immediate_list.replay(*this);
+
+        set_axes(axes);
+        m_current_color = color;
+        m_width = width;
+    }
+
+    uint64_t drawing_manager::hash_settings() const {
+        uint64_t hash = HASH_SEED;
+
+        hash = hash_bytes(hash, &m_axes, sizeof(m_axes));
+        hash = hash_bytes(hash, &m_current_color, sizeof(m_current_color));
+        hash = hash_bytes(hash, &m_width, sizeof(m_width));
+
+        return hash;
+    }
 
     void drawing_manager::set_width(float width) {
         m_width = width;
@@ -17,11 +81,10 @@ namespace gl {
 
 
     void drawing_manager::draw_interpolated_triangle(colored_vertex p0, colored_vertex p1, colored_vertex p2) {
-        m_vertices.insert(m_vertices.end(), {
-            { m_axes.get_view_coordinates(p0.point), p0.color },
-            { m_axes.get_view_coordinates(p1.point), p1.color },
-            { m_axes.get_view_coordinates(p2.point), p2.color }
-        });
+        // Constructed in place, storage is reserved up front, so this never reallocates in steady state
+        m_vertices.emplace_back(m_axes.get_view_coordinates(p0.point), p0.color);
+        m_vertices.emplace_back(m_axes.get_view_coordinates(p1.point), p1.color);
+        m_vertices.emplace_back(m_axes.get_view_coordinates(p2.point), p2.color);
     }
 
     void drawing_manager::draw_triangle(math::vec2 p0, math::vec2 p1, math::vec2 p2) {
@@ -32,12 +95,22 @@ namespace gl {
 
 
     void drawing_manager::draw_rectangle(math::vec2 x0, math::vec2 x1) {
+        if (m_instances != nullptr) {
+            add_instance(primitive_shape::RECTANGLE, x0, x1);
+            return;
+        }
+
         // Maybe, in the future, use index buffer instead:
         draw_triangle(x0, { x0.x(), x1.y() }, x1);
         draw_triangle(x0, { x1.x(), x0.y() }, x1);
     }
 
     void drawing_manager::draw_line(math::vec2 from, math::vec2 to) {
+        if (m_instances != nullptr) {
+            add_instance(primitive_shape::LINE, from, to);
+            return;
+        }
+
         math::vec direction = from - to;
         math::vec shift = direction
             .perpendicular().normalized();
@@ -131,11 +204,240 @@ namespace gl {
     }
 
     void drawing_manager::draw_vector(math::vec2 from, math::vec2 to) {
-        math::vec l = rot(from - to, -0.4f).normalized() * 0.1f;
-        math::vec r = rot(from - to, +0.4f).normalized() * 0.1f;
+        if (m_instances != nullptr) {
+            add_instance(primitive_shape::VECTOR, from, to);
+            return;
+        }
 
-        draw_antialiased_line(from, to - (to - from).normalized() * 0.04f);
+        math::vec l = rot(from - to, -VECTOR_HEAD_ANGLE).normalized() * VECTOR_HEAD_LENGTH;
+        math::vec r = rot(from - to, +VECTOR_HEAD_ANGLE).normalized() * VECTOR_HEAD_LENGTH;
+
+        draw_antialiased_line(from, to - (to - from).normalized() * VECTOR_HEAD_GAP);
         draw_triangle(to, to + l, to + r);
     }
 
+    // ==> Batched tessellation:
+
+#ifdef __AVX2__
+
+    static_assert(sizeof(math::vec2) == 2 * sizeof(float), "Points are loaded as packed float pairs!");
+
+    static constexpr size_t BLOCK_SIZE = 8; // Shapes per AVX2 register
+
+    // Up to 7 points of 8 shapes each, in view coordinates, split in x and y
+    struct point_block {
+        alignas(32) float x[7][BLOCK_SIZE];
+        alignas(32) float y[7][BLOCK_SIZE];
+    };
+
+    // Splits 8 points, stored as vec2s, into x and y. Tail blocks are
+    // padded with zeros, lanes computed from them are never written out
+    static void load_points(std::span<const math::vec2> points, size_t first, __m256& x, __m256& y) {
+        alignas(32) float padded[2 * BLOCK_SIZE] = {};
+
+        const float* coordinates = reinterpret_cast<const float*>(points.data() + first);
+        if (points.size() - first < BLOCK_SIZE) {
+            std::copy(coordinates, coordinates + 2 * (points.size() - first), padded);
+            coordinates = padded;
+        }
+
+        __m256 low  = _mm256_loadu_ps(coordinates);
+        __m256 high = _mm256_loadu_ps(coordinates + BLOCK_SIZE);
+
+        // Shuffle gives x0 x1 x4 x5 | x2 x3 x6 x7, permute puts pairs back in order
+        auto restore_order = [](__m256 value) {
+            return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(value), _MM_SHUFFLE(3, 1, 2, 0)));
+        };
+
+        x = restore_order(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)));
+        y = restore_order(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+
+    // Axes as affine transform, applied to whole registers
+    struct view_transform {
+        __m256 scale_x, scale_y, offset_x, offset_y;
+
+        view_transform(const math::axes& axes) {
+            const math::vec2 scale = axes.get_view_scale(), offset = axes.get_view_offset();
+
+            scale_x  = _mm256_set1_ps(scale.x()),  scale_y  = _mm256_set1_ps(scale.y());
+            offset_x = _mm256_set1_ps(offset.x()), offset_y = _mm256_set1_ps(offset.y());
+        }
+
+        void store(__m256 x, __m256 y, point_block& block, size_t point) const {
+            _mm256_store_ps(block.x[point], _mm256_fmadd_ps(x, scale_x, offset_x));
+            _mm256_store_ps(block.y[point], _mm256_fmadd_ps(y, scale_y, offset_y));
+        }
+    };
+
+    // Normalized direction from /to/ to /from/, as in draw_line and draw_vector
+    static void find_back_direction(__m256 from_x, __m256 from_y, __m256 to_x, __m256 to_y,
+                                    __m256& direction_x, __m256& direction_y) {
+        direction_x = _mm256_sub_ps(from_x, to_x);
+        direction_y = _mm256_sub_ps(from_y, to_y);
+
+        __m256 length = _mm256_sqrt_ps(_mm256_fmadd_ps(direction_x, direction_x,
+                                                       _mm256_mul_ps(direction_y, direction_y)));
+
+        __m256 inverse_length = _mm256_div_ps(_mm256_set1_ps(1.0f), length);
+        direction_x = _mm256_mul_ps(direction_x, inverse_length);
+        direction_y = _mm256_mul_ps(direction_y, inverse_length);
+    }
+
+    // Rectangle's corners of 8 lines, same ones draw_line finds, stored as points 0-3
+    static void find_line_corners(__m256 from_x, __m256 from_y, __m256 to_x, __m256 to_y, float width,
+                                  const view_transform& transform, point_block& block) {
+        __m256 direction_x, direction_y;
+        find_back_direction(from_x, from_y, to_x, to_y, direction_x, direction_y);
+
+        const __m256 half_width = _mm256_set1_ps(width / 2.0f);
+
+        // Caps extend line by half width, shift is perpendicular to it
+        __m256 cap_x = _mm256_mul_ps(direction_x, half_width), cap_y = _mm256_mul_ps(direction_y, half_width);
+        __m256 shift_x = cap_y, shift_y = _mm256_sub_ps(_mm256_setzero_ps(), cap_x);
+
+        from_x = _mm256_add_ps(from_x, cap_x), from_y = _mm256_add_ps(from_y, cap_y);
+        to_x   = _mm256_sub_ps(to_x,   cap_x), to_y   = _mm256_sub_ps(to_y,   cap_y);
+
+        transform.store(_mm256_add_ps(from_x, shift_x), _mm256_add_ps(from_y, shift_y), block, 0);
+        transform.store(_mm256_sub_ps(from_x, shift_x), _mm256_sub_ps(from_y, shift_y), block, 1);
+        transform.store(_mm256_add_ps(to_x,   shift_x), _mm256_add_ps(to_y,   shift_y), block, 2);
+        transform.store(_mm256_sub_ps(to_x,   shift_x), _mm256_sub_ps(to_y,   shift_y), block, 3);
+    }
+
+#endif
+
+    void drawing_manager::draw_lines(std::span<const math::vec2> from, std::span<const math::vec2> to) {
+        assert(from.size() == to.size());
+
+        if (m_instances != nullptr) {
+            m_instances->reserve(m_instances->get_instances().size() + from.size());
+            for (size_t i = 0; i < from.size(); ++ i)
+                add_instance(primitive_shape::LINE, from[i], to[i]);
+
+            return;
+        }
+
+#ifdef __AVX2__
+        m_vertices.reserve(m_vertices.size() + 6 * from.size());
+
+        const view_transform transform(m_axes);
+        point_block block;
+
+        for (size_t first = 0; first < from.size(); first += BLOCK_SIZE) {
+            __m256 from_x, from_y, to_x, to_y;
+            load_points(from, first, from_x, from_y);
+            load_points(to,   first, to_x,   to_y);
+
+            find_line_corners(from_x, from_y, to_x, to_y, m_width, transform, block);
+
+            const size_t count = std::min(BLOCK_SIZE, from.size() - first);
+            for (size_t i = 0; i < count; ++ i)
+                for (size_t corner: { 0, 1, 2, 3, 1, 2 })
+                    emit_vertex(block.x[corner][i], block.y[corner][i]);
+        }
+#else
+        for (size_t i = 0; i < from.size(); ++ i)
+            draw_line(from[i], to[i]);
+#endif
+    }
+
+    void drawing_manager::draw_vectors(std::span<const math::vec2> from, std::span<const math::vec2> to) {
+        assert(from.size() == to.size());
+
+        if (m_instances != nullptr) {
+            m_instances->reserve(m_instances->get_instances().size() + from.size());
+            for (size_t i = 0; i < from.size(); ++ i)
+                add_instance(primitive_shape::VECTOR, from[i], to[i]);
+
+            return;
+        }
+
+        // Batched shaft is a plain line, like the one draw_antialiased_line falls back to
+#if defined(__AVX2__) && !defined(GL_NO_BUILTIN_ANTIALIASING)
+        m_vertices.reserve(m_vertices.size() + 9 * from.size());
+
+        const view_transform transform(m_axes);
+        point_block block;
+
+        const __m256 gap = _mm256_set1_ps(VECTOR_HEAD_GAP);
+
+        // Head's sides are back direction rotated both ways by head's angle
+        const __m256 cos_angle = _mm256_set1_ps(VECTOR_HEAD_LENGTH * std::cos(VECTOR_HEAD_ANGLE));
+        const __m256 sin_angle = _mm256_set1_ps(VECTOR_HEAD_LENGTH * std::sin(VECTOR_HEAD_ANGLE));
+
+        for (size_t first = 0; first < from.size(); first += BLOCK_SIZE) {
+            __m256 from_x, from_y, to_x, to_y;
+            load_points(from, first, from_x, from_y);
+            load_points(to,   first, to_x,   to_y);
+
+            __m256 back_x, back_y;
+            find_back_direction(from_x, from_y, to_x, to_y, back_x, back_y);
+
+            // Shaft stops short of the tip
+            find_line_corners(from_x, from_y, _mm256_fmadd_ps(back_x, gap, to_x),
+                              _mm256_fmadd_ps(back_y, gap, to_y), m_width, transform, block);
+
+            __m256 cos_x = _mm256_mul_ps(back_x, cos_angle), cos_y = _mm256_mul_ps(back_y, cos_angle);
+            __m256 sin_x = _mm256_mul_ps(back_x, sin_angle), sin_y = _mm256_mul_ps(back_y, sin_angle);
+
+            transform.store(to_x, to_y, block, 4);
+            transform.store(_mm256_add_ps(to_x, _mm256_add_ps(cos_x, sin_y)),
+                            _mm256_add_ps(to_y, _mm256_sub_ps(cos_y, sin_x)), block, 5);
+            transform.store(_mm256_add_ps(to_x, _mm256_sub_ps(cos_x, sin_y)),
+                            _mm256_add_ps(to_y, _mm256_add_ps(cos_y, sin_x)), block, 6);
+
+            const size_t count = std::min(BLOCK_SIZE, from.size() - first);
+            for (size_t i = 0; i < count; ++ i)
+                for (size_t point: { 0, 1, 2, 3, 1, 2, 4, 5, 6 })
+                    emit_vertex(block.x[point][i], block.y[point][i]);
+        }
+#else
+        for (size_t i = 0; i < from.size(); ++ i)
+            draw_vector(from[i], to[i]);
+#endif
+    }
+
+    void drawing_manager::draw_rectangles(std::span<const math::vec2> x0, std::span<const math::vec2> x1) {
+        assert(x0.size() == x1.size());
+
+        if (m_instances != nullptr) {
+            m_instances->reserve(m_instances->get_instances().size() + x0.size());
+            for (size_t i = 0; i < x0.size(); ++ i)
+                add_instance(primitive_shape::RECTANGLE, x0[i], x1[i]);
+
+            return;
+        }
+
+#ifdef __AVX2__
+        m_vertices.reserve(m_vertices.size() + 6 * x0.size());
+
+        const view_transform transform(m_axes);
+        point_block block;
+
+        for (size_t first = 0; first < x0.size(); first += BLOCK_SIZE) {
+            __m256 x0_x, x0_y, x1_x, x1_y;
+            load_points(x0, first, x0_x, x0_y);
+            load_points(x1, first, x1_x, x1_y);
+
+            // Transform is separate for each coordinate, so other two
+            // corners just mix coordinates of transformed ones
+            transform.store(x0_x, x0_y, block, 0);
+            transform.store(x1_x, x1_y, block, 1);
+
+            const size_t count = std::min(BLOCK_SIZE, x0.size() - first);
+            for (size_t i = 0; i < count; ++ i) {
+                const float left = block.x[0][i], right = block.x[1][i];
+                const float top  = block.y[0][i], bottom = block.y[1][i];
+
+                emit_vertex(left,  top), emit_vertex(left,  bottom), emit_vertex(right, bottom);
+                emit_vertex(left,  top), emit_vertex(right, top),    emit_vertex(right, bottom);
+            }
+        }
+#else
+        for (size_t i = 0; i < x0.size(); ++ i)
+            draw_rectangle(x0[i], x1[i]);
+#endif
+    }
+
 }
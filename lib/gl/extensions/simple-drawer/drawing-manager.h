@@ -2,17 +2,44 @@
 
 #include "axes.h"
 #include "colored-vertex.h"
+#include "command-list.h"
+#include "frame-arena.h"
+#include "instanced-primitives.h"
 #include "opengl-setup.h"
+#include "parallel-geometry.h"
+#include "thread-pool.h"
 #include "vertex-vector-array.h"
 #include "vec.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
 namespace gl {
 
+    class retained_lists;
+
     class drawing_manager {
     public:
-        // Uses black color by default
-        drawing_manager(gl::vertex_vector_array<colored_vertex>& vertices)
-            : m_vertices(vertices), m_current_color(0.0f, 0.0f, 0.0f) {}
+        // Vector's head, in world units, and how short of its tip line stops
+        static constexpr float VECTOR_HEAD_LENGTH = 0.1f;
+        static constexpr float VECTOR_HEAD_ANGLE  = 0.4f; // Radians from line to either side
+        static constexpr float VECTOR_HEAD_GAP    = 0.04f;
+
+        // Uses black color by default. With /instances/, lines, rectangles and
+        // vectors are recorded there to be expanded on GPU, instead of tessellated.
+        // Without /retained/, retained lists are just drawn right away, and
+        // without /parallel/, parallel drawing runs on the calling thread
+        drawing_manager(colored_vertex_array& vertices, primitive_batches* instances = nullptr,
+                        retained_lists* retained = nullptr, parallel_geometry* parallel = nullptr)
+            : m_vertices(vertices), m_instances(instances), m_retained(retained), m_parallel(parallel),
+              m_current_color(0.0f, 0.0f, 0.0f) {
+
+            if (m_instances != nullptr)
+                m_instances->set_axes(m_axes);
+        }
 
         // ==> Control current settings:
 
@@ -35,14 +62,98 @@ namespace gl {
 
         void draw_vector(math::vec2 from, math::vec2 to);
 
+        // ==> Draw many shapes at once:
+
+        // Same shapes as drawing them one by one (i-th one goes from from[i]
+        // to to[i]), but tessellated 8 at a time with AVX2, where it's available
+        void draw_lines     (std::span<const math::vec2> from, std::span<const math::vec2> to);
+        void draw_vectors   (std::span<const math::vec2> from, std::span<const math::vec2> to);
+        void draw_rectangles(std::span<const math::vec2> x0,   std::span<const math::vec2> x1);
+
+        // ==> Draw retained lists (see retained_lists):
+
+        // Draws list /name/, recorded by /record/ (called with command_list&)
+        // only if /version/ differs from the one it was last recorded with,
+        // list layers with other triangles in call order, like immediate calls
+        template <typename recording_function>
+        void draw_retained(std::string_view name, uint64_t version, recording_function&& record) {
+            if (command_list* commands = begin_retained(name, version))
+                record(*commands);
+
+            end_retained();
+        }
+
+        // Same, but list is recorded every time, and only
+        // tessellated again if recorded calls have changed
+        template <typename recording_function>
+        void draw_retained(std::string_view name, recording_function&& record) {
+            record(*begin_retained(name, std::nullopt));
+            end_retained();
+        }
+
+        // ==> Draw in parallel:
+
+        // Calls /draw/(manager, i) for every i in [0, count), on global pool's threads.
+        // Each task gets its own manager, that starts with current settings and writes
+        // to its own chunk of vertices, chunks are drawn in order of i, right after
+        // what was drawn before this call. Lines, rectangles and vectors are
+        // tessellated in tasks even with instancing, and retained lists are drawn
+        // right away, since neither of them can be shared between threads
+        template <typename drawing_function>
+        void draw_parallel(size_t count, drawing_function&& draw) {
+            thread_pool& pool = thread_pool::global();
+
+            const size_t chunk_count = std::min(count, pool.get_thread_count() * TASKS_PER_THREAD);
+            if (m_parallel == nullptr || chunk_count <= 1) {
+                for (size_t i = 0; i < count; ++ i)
+                    draw(*this, i);
+
+                return;
+            }
+
+            m_parallel->begin(chunk_count, m_vertices);
+
+            pool.run(chunk_count, [&](size_t chunk) {
+                drawing_manager worker = make_worker(m_parallel->get_chunk(chunk));
+
+                for (size_t i = count * chunk / chunk_count; i < count * (chunk + 1) / chunk_count; ++ i)
+                    draw(worker, i);
+            });
+        }
+
     private:
-        gl::vertex_vector_array<colored_vertex>& m_vertices;
+        // Several tasks per thread even out uneven items
+        static constexpr size_t TASKS_PER_THREAD = 4;
+
+        drawing_manager make_worker(colored_vertex_array& chunk) const;
+
+        command_list* begin_retained(std::string_view name, std::optional<uint64_t> version);
+        void end_retained();
+
+        // Same calls draw differently with different settings, so
+        // retained lists are up to date only for the same settings
+        friend class retained_lists;
+        uint64_t hash_settings() const;
+
+        void add_instance(primitive_shape shape, math::vec2 from, math::vec2 to);
+
+        // Point is already in view coordinates
+        void emit_vertex(float x, float y) {
+            m_vertices.emplace_back(math::vec2 { x, y }, m_current_color);
+        }
+
+        colored_vertex_array& m_vertices;
+        primitive_batches* m_instances;
+
+        retained_lists* m_retained;
+        parallel_geometry* m_parallel;
+        command_list m_immediate_list; // Stands in for retained ones without retained_lists
 
         // ==> Current settings:
         math::axes m_axes;
 
         math::vec3 m_current_color;
-        float m_width;
+        float m_width = 0.01f;
     };
 
 }
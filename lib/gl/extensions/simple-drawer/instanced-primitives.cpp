@@ -0,0 +1,90 @@
+#include "instanced-primitives.h"
+#include "drawing-manager.h"
+#include "vec-layout.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gl {
+
+    uint32_t primitive_instance::pack_color(math::vec3 color) {
+        auto to_byte = [](float channel) {
+            return (uint32_t) std::lround(std::clamp(channel, 0.0f, 1.0f) * 255.0f);
+        };
+
+        // Little endian, so bytes go R, G, B, A in memory
+        return to_byte(color.r()) | to_byte(color.g()) << 8 | to_byte(color.b()) << 16 | 0xFFu << 24;
+    }
+
+    // ==> Batches:
+
+    void primitive_batches::release() {
+        release_storage(m_instances);
+        m_batches.clear();
+
+        m_is_new_batch_needed = true;
+    }
+
+    void primitive_batches::set_axes(const math::axes& axes) {
+        math::vec2 offset = axes.get_view_offset();
+        math::vec2 scale  = axes.get_view_scale();
+
+        m_is_new_batch_needed |= scale.x() != m_axes_scale.x() || scale.y() != m_axes_scale.y() ||
+            offset.x() != m_axes_offset.x() || offset.y() != m_axes_offset.y();
+
+        m_axes_scale = scale, m_axes_offset = offset;
+    }
+
+    void primitive_batches::start_batch(primitive_shape shape) {
+        m_batches.push_back({ shape, m_axes_scale, m_axes_offset, m_instances.size(), 0 });
+        m_is_new_batch_needed = false;
+    }
+
+    // ==> Renderer:
+
+    instanced_primitive_renderer::instanced_primitive_renderer()
+        : m_primitives(math::vector_layout<float, 3>(),
+                       math::vector_layout<float, 2>(2) + gl::layout<float>() + gl::layout<unsigned char>(4)) {}
+
+    void instanced_primitive_renderer::setup() {
+        m_shader.from_file("res/instanced-primitives.glsl");
+
+        // Mesh vertices are (along, across, part): quad goes along [0, 1] and
+        // across [-1/2, 1/2] in units of length and width, head is in world units
+        const float head_x = -drawing_manager::VECTOR_HEAD_LENGTH * std::cos(drawing_manager::VECTOR_HEAD_ANGLE);
+        const float head_y =  drawing_manager::VECTOR_HEAD_LENGTH * std::sin(drawing_manager::VECTOR_HEAD_ANGLE);
+
+        const std::vector<math::vec3> mesh = {
+            { 0.0f, -0.5f, 0.0f }, { 1.0f, -0.5f, 0.0f }, { 0.0f, +0.5f, 0.0f },
+            { 1.0f, -0.5f, 0.0f }, { 1.0f, +0.5f, 0.0f }, { 0.0f, +0.5f, 0.0f },
+
+            {   0.0f,    0.0f, 1.0f },
+            { head_x, +head_y, 1.0f },
+            { head_x, -head_y, 1.0f }
+        };
+
+        m_primitives.assign_mesh(mesh);
+
+        m_shader.uniform("vector_gap", drawing_manager::VECTOR_HEAD_GAP);
+    }
+
+    void instanced_primitive_renderer::draw(const primitive_batches& batches) {
+        if (batches.get_instances().empty())
+            return;
+
+        m_primitives.assign_instances(batches.get_instances());
+
+        for (const primitive_batches::batch& current: batches.get_batches()) {
+            m_shader.uniform("shape", (int) current.shape);
+            m_shader.uniform("axes_scale",  current.axes_scale);
+            m_shader.uniform("axes_offset", current.axes_offset);
+
+            const size_t vertex_count = current.shape == primitive_shape::VECTOR?
+                ARROW_VERTEX_COUNT : QUAD_VERTEX_COUNT;
+
+            gl::draw_instanced(gl::drawing_type::TRIANGLES, m_primitives, m_shader,
+                               0, vertex_count, current.first, current.count);
+        }
+    }
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "axes.h"
+#include "frame-arena.h"
+#include "opengl-setup.h"
+#include "vec.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace gl {
+
+    enum class primitive_shape { LINE, RECTANGLE, VECTOR };
+
+    // Everything GPU needs to expand a line, rectangle or vector, the
+    // shape itself comes from a shared mesh (see instanced_primitive_renderer)
+    struct primitive_instance final {
+        math::vec2 from, to; // Rectangles use them as opposite corners
+        float width;
+        uint32_t color;      // RGBA, byte per channel
+
+        static uint32_t pack_color(math::vec3 color);
+    };
+
+    static_assert(sizeof(primitive_instance) == 24, "Instances should stay tightly packed!");
+
+    // Instances recorded during a frame, grouped in runs of the same shape
+    // and axes, so that each run is a single instanced draw call
+    class primitive_batches {
+    public:
+        struct batch {
+            primitive_shape shape;
+            math::vec2 axes_scale, axes_offset; // Axes as affine view transform
+
+            size_t first, count;
+        };
+
+        primitive_batches(frame_arena& arena)
+            : m_instances(arena_allocator<primitive_instance>(arena)),
+              m_axes_scale(1.0f, 1.0f), m_axes_offset(0.0f, 0.0f) {}
+
+        // Storage goes back to arena, should be called before arena begins next frame
+        void release();
+        void reserve(size_t count) { m_instances.reserve(count); }
+
+        // Following instances use these axes
+        void set_axes(const math::axes& axes);
+
+        void add(primitive_shape shape, const primitive_instance& instance) {
+            if (m_batches.empty() || m_batches.back().shape != shape || m_is_new_batch_needed)
+                start_batch(shape);
+
+            m_instances.push_back(instance);
+            ++ m_batches.back().count;
+        }
+
+        const std::vector<primitive_instance, arena_allocator<primitive_instance>>&
+            get_instances() const { return m_instances; }
+
+        const std::vector<batch>& get_batches() const { return m_batches; }
+
+    private:
+        void start_batch(primitive_shape shape);
+
+        std::vector<primitive_instance, arena_allocator<primitive_instance>> m_instances;
+
+        // Cleared, but not released, batches are few and keep their capacity
+        std::vector<batch> m_batches;
+
+        math::vec2 m_axes_scale, m_axes_offset;
+        bool m_is_new_batch_needed = true;
+    };
+
+    // Draws primitive_batches with one mesh per shape, expanded in vertex shader
+    class instanced_primitive_renderer {
+    public:
+        instanced_primitive_renderer();
+
+        void setup();
+        void draw(const primitive_batches& batches);
+
+    private:
+        // Both shapes that use them are quads (6 vertices), vectors
+        // continue the quad with arrow's head (3 more vertices)
+        static constexpr size_t QUAD_VERTEX_COUNT  = 6;
+        static constexpr size_t ARROW_VERTEX_COUNT = 9;
+
+        gl::shaders::shader_program m_shader;
+        gl::instanced_vertex_array m_primitives;
+    };
+
+}
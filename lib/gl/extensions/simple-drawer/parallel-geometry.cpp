@@ -0,0 +1,61 @@
+#include "parallel-geometry.h"
+
+namespace gl {
+
+    void parallel_geometry::begin_frame() {
+        for (size_t i = 0; i < m_used_chunks; ++ i)
+            m_chunks[i]->last_vertex_count = m_chunks[i]->vertices.size();
+
+        m_first_chunk = m_used_chunks = 0;
+        m_main_boundaries.clear();
+    }
+
+    void parallel_geometry::begin(size_t chunk_count, const colored_vertex_array& main) {
+        m_first_chunk = m_used_chunks;
+        m_used_chunks += chunk_count;
+
+        while (m_chunks.size() < m_used_chunks)
+            m_chunks.push_back(std::make_unique<chunk>());
+
+        // Like renderer's own arena, chunk is reserved for as much as it took last frame
+        for (size_t i = m_first_chunk; i < m_used_chunks; ++ i) {
+            chunk& current = *m_chunks[i];
+
+            release_storage(current.vertices);
+            current.arena.begin_frame();
+            current.vertices.reserve(current.last_vertex_count);
+        }
+
+        m_main_boundaries.insert(m_main_boundaries.end(), chunk_count, main.size());
+    }
+
+    std::span<const raw_data> parallel_geometry::get_ranges(const colored_vertex_array& main) {
+        m_ranges.clear();
+
+        auto add_range = [&](const colored_vertex* first, size_t count) {
+            if (count > 0)
+                m_ranges.push_back({ (void*) first, count * sizeof(colored_vertex) });
+        };
+
+        size_t main_drawn = 0;
+        for (size_t i = 0; i < m_used_chunks; ++ i) {
+            add_range(main.data() + main_drawn, m_main_boundaries[i] - main_drawn);
+            main_drawn = m_main_boundaries[i];
+
+            add_range(m_chunks[i]->vertices.data(), m_chunks[i]->vertices.size());
+        }
+
+        add_range(main.data() + main_drawn, main.size() - main_drawn);
+
+        return m_ranges;
+    }
+
+    size_t parallel_geometry::get_drawn_count(size_t main_count, size_t chunk_count) const {
+        size_t drawn = main_count;
+        for (size_t i = 0; i < chunk_count; ++ i)
+            drawn += m_chunks[i]->vertices.size();
+
+        return drawn;
+    }
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "colored-vertex.h"
+#include "frame-arena.h"
+#include "vertex-buffer.h"
+#include "vertex-vector-array.h"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace gl {
+
+    // Vertices of one frame, taken from a frame arena
+    using colored_vertex_array = gl::vertex_vector_array<colored_vertex, arena_allocator<colored_vertex>>;
+
+    // Vertex chunks that parallel drawing (see drawing_manager::draw_parallel) fills,
+    // one per task, each from its own arena. Chunks are never copied together:
+    // they're uploaded as consecutive ranges of one buffer, interleaved with
+    // main vertices drawn between parallel calls, so draw order is kept
+    class parallel_geometry {
+    public:
+        // Chunks' storage from last frame becomes invalid
+        void begin_frame();
+
+        // Takes a chunk for each of /chunk_count/ tasks, main
+        // vertices drawn so far are drawn before them
+        void begin(size_t chunk_count, const colored_vertex_array& main);
+
+        // Chunk of task /index/ of the last begin()
+        colored_vertex_array& get_chunk(size_t index) {
+            return m_chunks[m_first_chunk + index]->vertices;
+        }
+
+        bool is_used() const { return m_used_chunks > 0; }
+
+        // Main vertices and chunks, in draw order, valid until next begin_frame()
+        std::span<const raw_data> get_ranges(const colored_vertex_array& main);
+
+        // Chunks begun so far this frame
+        size_t get_chunk_count() const { return m_used_chunks; }
+
+        // Where drawing got to when there were /main_count/ main vertices and /chunk_count/
+        // chunks, as an offset into vertices uploaded from get_ranges()
+        size_t get_drawn_count(size_t main_count, size_t chunk_count) const;
+
+    private:
+        struct chunk {
+            frame_arena arena;
+            colored_vertex_array vertices { arena_allocator<colored_vertex>(arena) };
+
+            size_t last_vertex_count = 0;
+        };
+
+        // Chunks are boxed, since vertices point into their arenas
+        std::vector<std::unique_ptr<chunk>> m_chunks;
+        size_t m_first_chunk = 0, m_used_chunks = 0;
+
+        // Chunks are preceded by main vertices up to these boundaries
+        std::vector<size_t> m_main_boundaries;
+
+        std::vector<raw_data> m_ranges;
+    };
+
+}
@@ -1,25 +1,59 @@
 #pragma once
 
+#include "adaptive-sampler.h"
+#include "aligned-allocator.h"
 #include "colored-vertex.h"
 #include "drawing-manager.h"
+#include "frame-profiler.h"
 #include "opengl-setup.h"
+#include "resolution-governor.h"
+#include "spsc-queue.h"
+#include "thread-pool.h"
+#include "tiled-layout.h"
+#include "triple-buffer.h"
 #include "vec-layout.h"
 #include "vec.h"
 #include "vertex-vector-array.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <vector>
+
 namespace gl {
 
+    // Square block of pixels, rows are [row_begin, row_end), columns
+    // are [column_begin, column_end), smaller near the edges of window
+    struct pixel_tile {
+        int row_begin, row_end;
+        int column_begin, column_end;
+    };
+
     template <typename impl_type>
     class pixel_drawing_window: public gl::window {
     public:
-        using gl::window::window;
+        // Every pixel is a point of its own, multisampling can't improve them (impl
+        // can antialias on its own), it would only slow presentation down, so it's off
+        pixel_drawing_window(int width, int height, const char* title, int sample_count = 0)
+            : gl::window(width, height, title, sample_count) {}
+
+        // Tiles are small enough to be coherent (and to fit 8-wide
+        // ray packets row by row), but big enough to amortize overhead
+        static constexpr int TILE_SIZE = 8;
 
         void setup() override {
             gradient_shader.from_file("res/gradient.glsl");
             vertices.set_layout(math::vector_layout<float, 2>() +
                                 math::vector_layout<float, 3>());
 
-            // Initialize matrix
+            // Initialize matrix, pixels are stored tile by tile (points carry
+            // their own positions, so order doesn't matter for presentation)
+            vertices.resize(m_layout.get_size());
+
             for (int i = 0; i < height; ++ i)
                 for (int j = 0; j < width; ++ j) {
                     math::vec current_pos {
@@ -27,35 +61,518 @@ namespace gl {
                         2 * j / static_cast<float>(width)  - 1
                     };
 
-                    vertices.push_back({ current_pos, DEFAULT_COLOR });
+                    vertices[m_layout.get_index(i, j)] = { current_pos, DEFAULT_COLOR };
                 }
+
+            if (m_frames)
+                m_shading_thread = std::thread([this] { shading_loop(); });
         }
 
+        // Tiles are drawn in parallel, so draw_tile (and draw_pixel,
+        // when default draw_tile is used) should be safe to call concurrently
         void draw() override {
-            for (int i = 0; i < height; ++ i)
-                for (int j = 0; j < width; ++ j) {
-                    colored_vertex &current = vertices[i * height + j];
-
-                    // Update color:
-                    current.color = static_cast<impl_type*>(this)
-                        ->draw_pixel(current.point);
+            if (m_frames) {
+                // Shading thread makes frames, only the latest complete one is shown
+                if (m_frames->update()) {
+                    const huge_page_vector<math::vec3>& colors = m_frames->get_front();
+                    for (size_t pixel = 0; pixel < colors.size(); ++ pixel)
+                        vertices[pixel].color = colors[pixel];
                 }
+            } else {
+                shade_frame();
+
+                // With render on demand, image that still gets better keeps frames coming
+                set_animating(is_converging());
+            }
 
             vertices.update(); // Update point list
 
             gl::draw(gl::drawing_type::POINTS, vertices, gradient_shader);
         }
 
+        // Runs window's loop, stops shading thread (if there is one) once it's over,
+        // while impl is still alive (it's gone by the time base class is destroyed)
+        void draw_loop() {
+            struct shading_thread_guard {
+                pixel_drawing_window& window;
+                ~shading_thread_guard() { window.stop_shading_thread(); }
+            } guard { *this };
+
+            gl::window::draw_loop();
+        }
+
+        // ==> Pipelined shading: frames are shaded on a thread of their own (with thread pool's
+        //     workers) into one of three buffers, and handed over to window's thread through
+        //     a lock-free triple buffer, so shading the next frame overlaps uploading and
+        //     presenting the previous one. Input events reach impl through a lock-free queue,
+        //     so begin_frame, draw_tile, draw_pixel and input handlers (on_key_pressed,
+        //     on_mouse_moved) all run on the shading thread, impl needs no locks.
+        //
+        //     With render on demand, shading thread sleeps whenever window would
+        //     (nothing was invalidated, no input came and image is converged)
+
+        // Takes effect in draw_loop, so should be called before it
+        void set_pipelined(bool is_enabled) {
+            if (is_enabled)
+                m_frames.emplace(huge_page_vector<math::vec3>((size_t) width * height, DEFAULT_COLOR));
+            else
+                m_frames.reset();
+        }
+
+        bool is_pipelined() const { return m_frames.has_value(); }
+
+        void on_input(const input_event& event) override {
+            if (!m_shading_thread.joinable()) {
+                dispatch_input(event);
+                return;
+            }
+
+            // Events that don't fit are dropped, that takes hundreds
+            // of them during one frame, more than anyone can type
+            if (m_input_events.try_push(event))
+                wake_shading_thread();
+        }
+
+        // Default implementation, called before tiles of every frame
+        // are drawn, so that per-frame state can be prepared in one place
+        void begin_frame() {}
+
+        // Default implementation, called once all tiles of frame drawn with tiles are
+        // (before it's upscaled, if it's downscaled), so that pixels can be post-processed
+        // with their neighbors from other tiles
+        void end_frame() {}
+
+        // Default implementation, draws tile pixel by pixel
+        void draw_tile(const pixel_tile& tile) {
+            for (int i = tile.row_begin; i < tile.row_end; ++ i)
+                for (int j = tile.column_begin; j < tile.column_end; ++ j) {
+                    // Update color:
+                    get_target_color(i, j) = static_cast<impl_type*>(this)
+                        ->draw_pixel(get_pixel_position(i, j));
+                }
+        }
+
         // Default implementation
         math::vec4 draw_pixel(math::vec2 /* position */) {
             // Just white:
             return { 1.0f, 1.0f, 1.0f, 1.0f };
         }
 
+        // ==> Progressive adaptive sampling (for stills): instead of drawing tiles, every
+        //     frame refines the image with more samples from draw_pixel (at any point
+        //     of pixels' area, not only at their centers), until sampler's budget is spent
+
+        void start_adaptive_sampling(adaptive_sampling_settings settings = {}) {
+            m_sampler.emplace(width, height, settings);
+            request_frame();
+        }
+
+        void stop_adaptive_sampling() {
+            m_sampler.reset();
+            request_frame();
+        }
+
+        bool is_adaptive_sampling() const { return m_sampler.has_value(); }
+
+        // Default implementation, called after every sampling round
+        void on_sampling_round(const adaptive_sampling_stats& /* stats */) {}
+
+        // ==> Progressive accumulation (for interactive viewing): once enabled, frame that
+        //     follows another one with nothing changed in between (impl reports changes
+        //     with invalidate()) doesn't redraw tiles, but adds one jittered sample to
+        //     every pixel through draw_pixel instead, so still image converges to
+        //     an antialiased one, until MAX_ACCUMULATED_FRAMES are in
+
+        static constexpr int MAX_ACCUMULATED_FRAMES = 256;
+
+        void set_accumulation(bool is_enabled) {
+            m_is_accumulation_enabled = is_enabled;
+            invalidate();
+        }
+
+        // Next frame starts accumulation over (and is drawn, even with render on demand)
+        void invalidate() {
+            m_accumulated_frames = 0;
+            request_frame();
+        }
+
+        // Whether current frame draws pixels through draw_pixel (for still or accumulation)
+        // instead of drawing tiles, valid in begin_frame (after impl invalidates changes)
+        bool is_refining_frame() const {
+            return m_sampler || (m_is_accumulation_enabled && m_accumulated_frames > 0);
+        }
+
+        // Whether next frame would still improve the image (still isn't finished, or
+        // accumulation hasn't got all of its frames yet), frames after that are the same
+        bool is_converging() const {
+            if (m_sampler)
+                return !m_sampler->is_finished();
+
+            return m_is_accumulation_enabled && m_accumulated_frames < MAX_ACCUMULATED_FRAMES;
+        }
+
+        // ==> Dynamic resolution: governor measures how long frames drawn with tiles take
+        //     (begin_frame included) and scales resolution they're drawn at to keep that
+        //     within budget, image is then upscaled (bilinearly) to window's size.
+        //
+        //     Tiles, get_pixel_position and set_pixel_color then address pixels of render
+        //     resolution, impl should size anything it keeps per pixel by it. Refining frames
+        //     are always drawn at full resolution, so image that stays still gets sharp again
+
+        void start_dynamic_resolution(resolution_governor_settings settings = {}) {
+            m_governor.emplace(settings);
+            request_frame();
+        }
+
+        void stop_dynamic_resolution() {
+            m_governor.reset();
+            m_render_scale = 1.0f;
+
+            request_frame();
+        }
+
+        bool is_dynamic_resolution() const { return m_governor.has_value(); }
+
+        // Resolution pixels of current frame are addressed in, valid in begin_frame (like is_refining_frame)
+        int get_render_width()  const { return is_refining_frame()? width  : m_render_width;  }
+        int get_render_height() const { return is_refining_frame()? height : m_render_height; }
+
+        // Layout of per-pixel data in render resolution, same as window's own buffers use,
+        // so that impl's buffers share their locality (valid in begin_frame, like the above)
+        tiled_layout get_render_layout() const { return { get_render_width(), get_render_height() }; }
+
+        // ==> Stats of frames drawn with tiles, safe to read from any thread (e.g. in on_fps_updated):
+
+        float get_render_scale() const { return m_render_scale.load(std::memory_order_relaxed); }
+
+        // Average time it took to draw one, in seconds, zero if no governor measures it
+        double get_frame_time() const { return m_frame_time.load(std::memory_order_relaxed); }
+
+        // ==> Profiling: when enabled, profiler measures wall time and hardware counters of frames'
+        //     phases: "begin_frame", "tiles", "end_frame", "upscale" (of downscaled frames), or
+        //     "refine" and "accumulate" for refining frames. Impl can measure its own phases
+        //     (nested in these) with get_profiler().measure(name), on the thread frames are shaded on
+
+        frame_profiler& get_profiler() { return m_profiler; }
+
+    protected:
+        // Calls body(tile) for tiles covering /rows/ x /columns/ pixels, in parallel and split
+        // between nodes the same way frame's tiles are, so that impl's own per-pixel passes
+        // (in render layout) touch memory of the node that shades those pixels
+        template <typename body_type>
+        void for_each_tile(int rows, int columns, body_type&& body) {
+            const int tile_rows    = (rows    + TILE_SIZE - 1) / TILE_SIZE;
+            const int tile_columns = (columns + TILE_SIZE - 1) / TILE_SIZE;
+
+            // Tiles are in memory order (see tiled_layout), so on NUMA machines each
+            // node gets the same share of frame (which its memory holds) every time
+            gl::thread_pool::global().run_partitioned((size_t) tile_rows * tile_columns, [&](size_t index) {
+                const int row    = (int) index / tile_columns;
+                const int column = (int) index % tile_columns;
+
+                pixel_tile tile = {
+                    .row_begin    = row * TILE_SIZE,
+                    .row_end      = std::min(rows, (row + 1) * TILE_SIZE),
+
+                    .column_begin = column * TILE_SIZE,
+                    .column_end   = std::min(columns, (column + 1) * TILE_SIZE)
+                };
+
+                body(tile);
+            });
+        }
+
+        // Position of pixel in normalized device coordinates
+        math::vec2 get_pixel_position(int i, int j) const {
+            // Computed rather than read from vertices, window's thread writes into them
+            return { 2 * i / static_cast<float>(get_render_height()) - 1,
+                     2 * j / static_cast<float>(get_render_width())  - 1 };
+        }
+
+        void set_pixel_color(int i, int j, math::vec3 color) {
+            get_target_color(i, j) = color;
+        }
+
+        math::vec3 get_pixel_color(int i, int j) {
+            return get_target_color(i, j);
+        }
+
     private:
-        gl::vertex_vector_array<colored_vertex> vertices;
+        // Pixels are stored in tiles, vertices, accumulation and frame buffers all share this
+        tiled_layout m_layout { width, height };
+
+        // Full frame is swept several times a frame, so it's kept in huge pages
+        gl::vertex_vector_array<colored_vertex, huge_page_allocator<colored_vertex>> vertices;
         gl::shaders::shader_program gradient_shader;
 
+        std::optional<adaptive_sampler> m_sampler;
+
+        bool m_is_accumulation_enabled = false;
+        int m_accumulated_frames = 0;
+
+        huge_page_vector<float> m_accumulated; // Sum of frames, 3 channels per pixel
+
+        // ==> Pipelined shading:
+        std::optional<triple_buffer<huge_page_vector<math::vec3>>> m_frames;
+        std::thread m_shading_thread;
+
+        spsc_queue<input_event, 256> m_input_events;
+
+        // Bumped by anything that needs a new frame, sleeping shading thread waits for it to change
+        std::atomic<uint32_t> m_frame_requests { 0 };
+        std::atomic<bool> m_is_stopping { false };
+
+        // ==> Dynamic resolution:
+        std::optional<resolution_governor> m_governor;
+
+        int m_render_width = width, m_render_height = height;
+
+        // Frame drawn at lower resolution goes here first, and is upscaled from here
+        huge_page_vector<math::vec3> m_downscaled;
+        tiled_layout m_downscaled_layout { width, height };
+        bool m_is_drawing_downscaled = false;
+
+        std::atomic<float>  m_render_scale { 1.0f };
+        std::atomic<double> m_frame_time { 0.0 };
+
+        frame_profiler m_profiler;
+
+        // Pixel colors that frame being shaded goes to (shading thread's back buffer when pipelined)
+        math::vec3& get_target_color(int i, int j) {
+            if (m_is_drawing_downscaled)
+                return m_downscaled[m_downscaled_layout.get_index(i, j)];
+
+            const size_t pixel = m_layout.get_index(i, j);
+            return m_frames? m_frames->get_back()[pixel] : vertices[pixel].color;
+        }
+
+        // Draws one frame into target colors, returns false if
+        // it would be the same as previous one, and left them as is
+        bool shade_frame() {
+            const auto start = std::chrono::steady_clock::now();
+
+            const float scale = m_governor? m_governor->get_scale() : 1.0f;
+            m_render_width  = std::max(1, (int) std::lround((float) width  * scale));
+            m_render_height = std::max(1, (int) std::lround((float) height * scale));
+
+            m_profiler.begin_frame();
+
+            {
+                auto phase = m_profiler.measure("begin_frame");
+                static_cast<impl_type*>(this)->begin_frame();
+            }
+
+            if (m_sampler) {
+                auto phase = m_profiler.measure("refine");
+                return refine_adaptive_sampling();
+            }
+
+            if (m_is_accumulation_enabled && m_accumulated_frames > 0) {
+                auto phase = m_profiler.measure("accumulate");
+                return accumulate_frame();
+            }
+
+            m_is_drawing_downscaled = m_render_width != width || m_render_height != height;
+            if (m_is_drawing_downscaled) {
+                m_downscaled_layout = get_render_layout();
+                m_downscaled.assign(m_downscaled_layout.get_size(), DEFAULT_COLOR);
+            }
+
+            {
+                auto phase = m_profiler.measure("tiles");
+                for_each_tile(m_render_height, m_render_width, [this](const pixel_tile& tile) {
+                    static_cast<impl_type*>(this)->draw_tile(tile);
+                });
+            }
+
+            {
+                auto phase = m_profiler.measure("end_frame");
+                static_cast<impl_type*>(this)->end_frame();
+            }
+
+            if (m_is_drawing_downscaled) {
+                m_is_drawing_downscaled = false;
+
+                auto phase = m_profiler.measure("upscale");
+                upscale();
+            }
+
+            if (m_governor) {
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+                m_render_scale = m_governor->update(elapsed.count());
+                m_frame_time   = m_governor->get_average_frame_time();
+            }
+
+            if (m_is_accumulation_enabled)
+                start_accumulation();
+
+            return true;
+        }
+
+        // Bilinearly interpolates downscaled frame into target colors
+        void upscale() {
+            const float row_scale    = (float) m_render_height / (float) height;
+            const float column_scale = (float) m_render_width  / (float) width;
+
+            for_each_tile(height, width, [&](const pixel_tile& tile) {
+                for (int i = tile.row_begin; i < tile.row_end; ++ i) {
+                    // Same point of the screen in downscaled pixels
+                    const float y = (float) i * row_scale;
+
+                    const int   top    = std::min((int) y, m_render_height - 1);
+                    const int   bottom = std::min(top + 1, m_render_height - 1);
+                    const float weight_y = y - (float) top;
+
+                    for (int j = tile.column_begin; j < tile.column_end; ++ j) {
+                        const float x = (float) j * column_scale;
+
+                        const int   left  = std::min((int) x, m_render_width - 1);
+                        const int   right = std::min(left + 1, m_render_width - 1);
+                        const float weight_x = x - (float) left;
+
+                        const math::vec3& top_left     = m_downscaled[m_downscaled_layout.get_index(top,    left )];
+                        const math::vec3& top_right    = m_downscaled[m_downscaled_layout.get_index(top,    right)];
+                        const math::vec3& bottom_left  = m_downscaled[m_downscaled_layout.get_index(bottom, left )];
+                        const math::vec3& bottom_right = m_downscaled[m_downscaled_layout.get_index(bottom, right)];
+
+                        float color[3];
+                        for (int channel = 0; channel < 3; ++ channel) {
+                            const float upper = top_left   [channel] + (top_right   [channel] - top_left   [channel]) * weight_x;
+                            const float lower = bottom_left[channel] + (bottom_right[channel] - bottom_left[channel]) * weight_x;
+
+                            color[channel] = upper + (lower - upper) * weight_y;
+                        }
+
+                        get_target_color(i, j) = { color[0], color[1], color[2] };
+                    }
+                }
+            });
+        }
+
+        void request_frame() {
+            request_redraw();
+            wake_shading_thread();
+        }
+
+        void wake_shading_thread() {
+            m_frame_requests.fetch_add(1, std::memory_order_release);
+            m_frame_requests.notify_one();
+        }
+
+        void shading_loop() {
+            while (!m_is_stopping.load(std::memory_order_acquire)) {
+                // Taken before anything is looked at, so requests made later wake the wait below
+                const uint32_t requests = m_frame_requests.load(std::memory_order_acquire);
+
+                while (std::optional<input_event> event = m_input_events.try_pop())
+                    dispatch_input(*event);
+
+                if (shade_frame()) {
+                    m_frames->publish();
+                    request_redraw(); // Wake window's thread up to present it
+                }
+
+                if (is_rendering_on_demand() && !is_converging())
+                    m_frame_requests.wait(requests, std::memory_order_acquire);
+            }
+        }
+
+        void stop_shading_thread() {
+            if (!m_shading_thread.joinable())
+                return;
+
+            m_is_stopping.store(true, std::memory_order_release);
+            wake_shading_thread();
+
+            m_shading_thread.join();
+            m_is_stopping.store(false, std::memory_order_relaxed);
+        }
+
+        // Frame that was just drawn with tiles is the first one accumulated
+        void start_accumulation() {
+            m_accumulated.resize((size_t) width * height * 3);
+
+            for_each_tile(height, width, [this](const pixel_tile& tile) {
+                for (int i = tile.row_begin; i < tile.row_end; ++ i)
+                    for (int j = tile.column_begin; j < tile.column_end; ++ j) {
+                        const math::vec3 color = get_target_color(i, j);
+
+                        float* sum = &m_accumulated[m_layout.get_index(i, j) * 3];
+                        for (int channel = 0; channel < 3; ++ channel)
+                            sum[channel] = color[channel];
+                    }
+            });
+
+            m_accumulated_frames = 1;
+        }
+
+        // Radical inverse of index in given base, consecutive indices
+        // fill [0, 1) evenly (Halton sequence)
+        static float radical_inverse(int index, int base) {
+            float result = 0.0f, digit_weight = 1.0f / (float) base;
+
+            for (; index > 0; index /= base, digit_weight /= (float) base)
+                result += (float) (index % base) * digit_weight;
+
+            return result;
+        }
+
+        bool accumulate_frame() {
+            if (m_accumulated_frames >= MAX_ACCUMULATED_FRAMES)
+                return false; // Converged, image stays as it is
+
+            // Whole frame shares the offset, so rays stay as coherent as they are
+            // in tiles, offsets of consecutive frames spread over the pixel
+            const float offset_i = radical_inverse(m_accumulated_frames, 2) - 0.5f;
+            const float offset_j = radical_inverse(m_accumulated_frames, 3) - 0.5f;
+
+            const float inverse_count = 1.0f / (float) (m_accumulated_frames + 1);
+
+            impl_type* impl = static_cast<impl_type*>(this);
+            for_each_tile(height, width, [&](const pixel_tile& tile) {
+                for (int i = tile.row_begin; i < tile.row_end; ++ i)
+                    for (int j = tile.column_begin; j < tile.column_end; ++ j) {
+                        const math::vec4 color = impl->draw_pixel({
+                            2 * ((float) i + offset_i) / static_cast<float>(height) - 1,
+                            2 * ((float) j + offset_j) / static_cast<float>(width)  - 1
+                        });
+
+                        float* sum = &m_accumulated[m_layout.get_index(i, j) * 3];
+                        for (int channel = 0; channel < 3; ++ channel)
+                            sum[channel] += color[channel];
+
+                        get_target_color(i, j) = {
+                            sum[0] * inverse_count, sum[1] * inverse_count, sum[2] * inverse_count
+                        };
+                    }
+            });
+
+            ++ m_accumulated_frames;
+            return true;
+        }
+
+        bool refine_adaptive_sampling() {
+            if (m_sampler->is_finished())
+                return false; // Image stays as it is
+
+            impl_type* impl = static_cast<impl_type*>(this);
+
+            const adaptive_sampling_stats& stats = m_sampler->refine([&](float i, float j) {
+                const math::vec4 color = impl->draw_pixel({ 2 * i / static_cast<float>(height) - 1,
+                                                            2 * j / static_cast<float>(width)  - 1 });
+
+                return math::vec3 { color.x(), color.y(), color.z() };
+            });
+
+            for (int i = 0; i < height; ++ i)
+                for (int j = 0; j < width; ++ j)
+                    get_target_color(i, j) = m_sampler->get_color(i, j);
+
+            impl->on_sampling_round(stats);
+            return true;
+        }
+
         inline static constexpr math::vec3 DEFAULT_COLOR = { 1.0f, 1.0f, 1.0f };
     };
 
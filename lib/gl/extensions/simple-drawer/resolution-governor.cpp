@@ -0,0 +1,74 @@
+#include "resolution-governor.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gl {
+
+    namespace {
+
+        // Weight of the newest frame in the average, about last ten frames matter
+        constexpr double AVERAGE_WEIGHT = 0.2;
+
+        // Most scale can grow by at once, growing overshoots easily (cost of new pixels
+        // isn't known), while dropping should get under budget as soon as possible
+        constexpr float MAX_GROWTH = 0.125f;
+
+    }
+
+    resolution_governor::resolution_governor(resolution_governor_settings settings)
+        : m_settings(settings) {}
+
+    float resolution_governor::get_ideal_scale() const {
+        // Time ~ pixels ~ scale squared
+        const double ideal = m_scale * std::sqrt(m_settings.target_frame_time / m_average_frame_time);
+
+        const float quantized = std::floor((float) ideal / SCALE_STEP) * SCALE_STEP;
+        return std::clamp(quantized, m_settings.min_scale, 1.0f);
+    }
+
+    void resolution_governor::set_scale(float scale) {
+        // Average was measured at old scale, predict it for the new one,
+        // so that decisions right after the change aren't based on stale times
+        const double ratio = (double) scale / m_scale;
+        m_average_frame_time *= ratio * ratio;
+
+        m_scale = scale;
+        m_fast_frames = 0;
+    }
+
+    float resolution_governor::update(double frame_time) {
+        m_average_frame_time = m_average_frame_time == 0.0? frame_time :
+            m_average_frame_time + (frame_time - m_average_frame_time) * AVERAGE_WEIGHT;
+
+        if (!(m_average_frame_time > 0.0))
+            return m_scale;
+
+        const double target = m_settings.target_frame_time;
+
+        if (m_average_frame_time > target * (1.0 + m_settings.hysteresis)) {
+            m_fast_frames = 0;
+
+            const float scale = get_ideal_scale();
+            if (scale < m_scale)
+                set_scale(scale);
+
+            return m_scale;
+        }
+
+        if (m_average_frame_time < target * (1.0 - m_settings.hysteresis) && m_scale < 1.0f) {
+            if (++ m_fast_frames < m_settings.growth_delay)
+                return m_scale;
+
+            const float scale = std::min(get_ideal_scale(), m_scale + MAX_GROWTH);
+            if (scale > m_scale)
+                set_scale(scale);
+
+            return m_scale;
+        }
+
+        m_fast_frames = 0; // Within budget
+        return m_scale;
+    }
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+namespace gl {
+
+    struct resolution_governor_settings {
+        double target_frame_time = 1.0 / 60.0; // In seconds
+
+        // Scale only changes once average frame time is this much (relatively)
+        // away from the target, so that it doesn't flip back and forth
+        double hysteresis = 0.15;
+
+        // Frames in a row that should be fast enough before scale grows, so that
+        // single fast frame doesn't bring expensive resolution back too early
+        int growth_delay = 15;
+
+        float min_scale = 0.25f;
+    };
+
+    // Picks render resolution scale (of both sides, so that pixel count is scale squared)
+    // that keeps frame time near the target, assuming time is proportional to pixel count.
+    //
+    // Frame times are averaged exponentially, scale drops as soon as average is over
+    // the budget, but only grows after a run of fast frames, and never by much at once
+    class resolution_governor {
+    public:
+        // Scale changes in steps of this, so that small fluctuations don't change it at all
+        static constexpr float SCALE_STEP = 1.0f / 32.0f;
+
+        explicit resolution_governor(resolution_governor_settings settings = {});
+
+        // Reports time of a frame rendered at current scale, returns scale for the next one
+        float update(double frame_time);
+
+        float get_scale() const { return m_scale; }
+
+        // Exponential average, in seconds
+        double get_average_frame_time() const { return m_average_frame_time; }
+
+        const resolution_governor_settings& get_settings() const { return m_settings; }
+
+    private:
+        resolution_governor_settings m_settings;
+
+        float m_scale = 1.0f;
+
+        double m_average_frame_time = 0.0; // Zero until first frame
+        int m_fast_frames = 0;
+
+        // Scale that would hit the target exactly, quantized, within [min_scale, 1]
+        float get_ideal_scale() const;
+
+        void set_scale(float scale);
+    };
+
+}
@@ -0,0 +1,100 @@
+#include "retained-lists.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+namespace gl {
+
+    command_list* retained_lists::begin(std::string_view name, std::optional<uint64_t> version,
+                                        const drawing_manager& caller) {
+        assert(m_current == nullptr && "Retained lists can't be nested!");
+
+        auto found = m_lists.find(name);
+        if (found == m_lists.end())
+            found = m_lists.try_emplace(std::string(name)).first;
+
+        m_current = &found->second;
+        m_caller = &caller;
+
+        // Drawn again this frame, it's still drawn once, where it was first
+        if (!std::exchange(m_current->is_used, true))
+            m_draw_order.push_back({ m_current, caller.m_vertices.size(),
+                                     caller.m_parallel != nullptr? caller.m_parallel->get_chunk_count() : 0 });
+
+        const bool is_up_to_date = version.has_value() && m_current->is_recorded &&
+                                   m_current->version == version &&
+                                   m_current->settings_hash == caller.hash_settings();
+        if (is_up_to_date)
+            return nullptr;
+
+        m_current->version = version;
+        m_current->commands.clear();
+
+        m_is_recording = true;
+        return &m_current->commands;
+    }
+
+    void retained_lists::end() {
+        assert(m_current != nullptr && "No retained list to end!");
+
+        list& current = *std::exchange(m_current, nullptr);
+        const drawing_manager& caller = *std::exchange(m_caller, nullptr);
+        if (!std::exchange(m_is_recording, false))
+            return; // Up to date, nothing was recorded
+
+        // Recorded the same thing again (new version can still draw the same)
+        const uint64_t hash = current.commands.hash();
+        const uint64_t settings_hash = caller.hash_settings();
+        if (current.is_recorded && hash == current.hash && settings_hash == current.settings_hash)
+            return;
+
+        current.hash = hash;
+        current.settings_hash = settings_hash;
+        current.is_recorded = true;
+
+        tessellate(current, caller);
+    }
+
+    void retained_lists::tessellate(list& current, const drawing_manager& caller) {
+        // Same as per-frame geometry, but arena only starts a new "frame" when list changes
+        const size_t last_vertex_count = current.vertices.size();
+
+        release_storage(current.vertices);
+        current.arena.begin_frame();
+        current.vertices.reserve(last_vertex_count);
+
+        drawing_manager manager = caller.make_worker(current.vertices);
+        current.commands.replay(manager);
+
+        current.vertices.update();
+    }
+
+    void retained_lists::draw(const shaders::shader_program& shader, const colored_vertex_array& vertices,
+                              const parallel_geometry& parallel) const {
+        const size_t vertex_count = vertices.get_vertex_array().get_element_count();
+
+        size_t drawn = 0;
+        for (const auto& [current, main_count, chunk_count]: m_draw_order) {
+            const size_t before = std::min(parallel.get_drawn_count(main_count, chunk_count), vertex_count);
+
+            gl::draw(gl::drawing_type::TRIANGLES, vertices, shader, drawn, before - drawn);
+            drawn = before;
+
+            if (!current->vertices.empty())
+                gl::draw(gl::drawing_type::TRIANGLES, current->vertices, shader);
+        }
+
+        gl::draw(gl::drawing_type::TRIANGLES, vertices, shader, drawn, vertex_count - drawn);
+    }
+
+    void retained_lists::end_frame() {
+        std::erase_if(m_lists, [](const auto& named_list) { return !named_list.second.is_used; });
+
+        for (auto& [name, current]: m_lists)
+            current.is_used = false;
+
+        m_draw_order.clear();
+    }
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "command-list.h"
+#include "drawing-manager.h"
+#include "frame-arena.h"
+#include "opengl-setup.h"
+#include "parallel-geometry.h"
+#include "vec-layout.h"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gl {
+
+    // Named command lists whose tessellated geometry stays uploaded between frames.
+    // List is re-tessellated and re-uploaded only when its version (if it's given
+    // one) or its recorded content (if not) changes, so static parts of a plot,
+    // like axes and grids, cost nothing per frame except a draw call
+    class retained_lists {
+    public:
+        // Recording of list /name/ this frame, nullptr if it's already up to date
+        // with /version/. Without version, list is always recorded, but only
+        // tessellated if it differs from what was recorded last time. List starts
+        // with /caller/'s settings (like draw_parallel's tasks), and is recorded
+        // again when they change, since they change what it draws
+        command_list* begin(std::string_view name, std::optional<uint64_t> version,
+                            const drawing_manager& caller);
+
+        // Tessellates and uploads list started by begin(), if needed
+        void end();
+
+        // Draws lists used this frame along with frame's own /vertices/ (uploaded from
+        // /parallel/'s ranges, if it was used), every list goes right where it was begun,
+        // so lists layer with the rest the same way they do when drawn immediately
+        void draw(const shaders::shader_program& shader, const colored_vertex_array& vertices,
+                  const parallel_geometry& parallel) const;
+
+        // Forgets lists that weren't used this frame, they'd be stale anyway
+        void end_frame();
+
+    private:
+        struct list {
+            std::optional<uint64_t> version;
+            uint64_t hash = 0;
+            uint64_t settings_hash = 0; // Of caller's settings it was tessellated with
+
+            command_list commands;
+            bool is_recorded = false; // Has geometry for some version or hash
+
+            // Arena is list's own, so it's only reset when list changes
+            frame_arena arena;
+            colored_vertex_array vertices { arena_allocator<colored_vertex>(arena) };
+
+            bool is_used = false;
+
+            list() { vertices.set_layout(math::vector_layout<float, 2>() +
+                                         math::vector_layout<float, 3>()); }
+        };
+
+        void tessellate(list& current, const drawing_manager& caller);
+
+        // Lists are never moved, since vertices point into their arenas
+        std::map<std::string, list, std::less<>> m_lists;
+
+        // Lists in order they were begun, with how much of frame's geometry was drawn by then
+        struct placement {
+            const list* current;
+            size_t main_count, chunk_count;
+        };
+
+        std::vector<placement> m_draw_order;
+        list* m_current = nullptr;
+        const drawing_manager* m_caller = nullptr;
+        bool m_is_recording = false;
+    };
+
+}
@@ -3,6 +3,7 @@
 #include "drawing-manager.h"
 #include "opengl-setup.h"
 #include "renderer.h"
+#include "retained-lists.h"
 #include "vec-layout.h"
 
 namespace gl {
@@ -17,21 +18,72 @@ namespace gl {
             m_gradient_shader.from_file("res/gradient.glsl");
             m_verticies.set_layout(math::vector_layout<float, 2>() +
                                    math::vector_layout<float, 3>());
+
+            m_instanced_renderer.setup();
         }
 
+        // Lines, rectangles and vectors become instances expanded on GPU, they're
+        // drawn after (so, over) everything else drawing_manager has tessellated
+        void set_instancing(bool is_enabled) { m_is_instancing = is_enabled; }
+        bool is_instancing() const { return m_is_instancing; }
+
         void draw()  override final {
-            m_verticies.clear();
+            // Storage goes back to arena before it starts a new frame, then
+            // reserved for as many vertices as last frame had, so that
+            // drawing appends without reallocating
+            release_storage(m_verticies);
+            m_instances.release();
+
+            m_arena.begin_frame();
+            m_verticies.reserve(m_last_vertex_count);
+            m_instances.reserve(m_last_instance_count);
+
+            m_parallel.begin_frame();
 
-            drawing_manager draw_mgr { m_verticies };
+            drawing_manager draw_mgr { m_verticies, m_is_instancing? &m_instances : nullptr,
+                                       &m_retained, &m_parallel };
             m_draw(draw_mgr);
 
-            m_verticies.update();
-            gl::draw(gl::drawing_type::TRIANGLES, m_verticies, m_gradient_shader);
+            m_last_vertex_count = m_verticies.size();
+            m_last_instance_count = m_instances.get_instances().size();
+
+            // Chunks of parallel drawing are uploaded right from where tasks put them
+            if (m_parallel.is_used())
+                m_verticies.update(m_parallel.get_ranges(m_verticies));
+            else
+                m_verticies.update();
+
+            // Retained lists go in between, where they were drawn
+            m_retained.draw(m_gradient_shader, m_verticies, m_parallel);
+            m_retained.end_frame();
+
+            if (m_is_instancing)
+                m_instanced_renderer.draw(m_instances);
+        }
+
+        // Arena spills and peak bytes of the previous frame's geometry, spills
+        // should stay at zero for steady frames. Per-frame vertices and instance
+        // batches live in the arena, parallel chunks and retained lists keep
+        // their own arenas, which aren't counted here
+        const frame_arena::frame_stats& get_frame_stats() const {
+            return m_arena.get_last_frame_stats();
         }
 
     private:
         gl::shaders::shader_program m_gradient_shader;
-        gl::vertex_vector_array<colored_vertex> m_verticies;
+
+        frame_arena m_arena;
+        colored_vertex_array m_verticies { arena_allocator<colored_vertex>(m_arena) };
+        size_t m_last_vertex_count = 0;
+
+        retained_lists m_retained;
+        parallel_geometry m_parallel;
+
+        primitive_batches m_instances { m_arena };
+        size_t m_last_instance_count = 0;
+
+        instanced_primitive_renderer m_instanced_renderer;
+        bool m_is_instancing = false;
 
         rendering_function m_draw;
     };
@@ -3,6 +3,8 @@
 #include "drawing-manager.h"
 #include "renderer-handler-window.h"
 #include "simple-drawing-renderer.h"
+
+#include <iostream>
 #include <memory>
 
 
@@ -36,6 +38,21 @@ namespace gl {
 
         virtual void loop_draw(drawing_manager &mgr) = 0;
 
+        const frame_arena::frame_stats& get_frame_stats() const {
+            return m_renderer.get_frame_stats();
+        }
+
+        // Reports last frame's geometry allocations along with FPS, so that
+        // frames that keep spilling out of the arena show up right away
+        void on_fps_updated() override {
+            const frame_arena::frame_stats& stats = get_frame_stats();
+
+            std::cout << "FPS: " << get_fps() << ", arena spills: " << stats.arena_spills
+                      << ", peak: " << stats.peak_bytes / 1024 << " KiB" << std::endl;
+        }
+
+        void set_instancing(bool is_enabled) { m_renderer.set_instancing(is_enabled); }
+
     private:
         simple_drawing_renderer<details::simple_drawing_adapter> m_renderer =
             { details::simple_drawing_adapter(*this) };
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "numa-topology.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace gl {
+
+    // Allocator for std containers that places storage on /alignment/ boundary,
+    // 64 by default, which is cache line size on every platform we care about.
+    // This makes SoA streams safe for aligned SIMD loads and avoids false sharing
+    // on chunk boundaries when they are processed in parallel.
+    template <typename element_type, size_t alignment = 64>
+    class aligned_allocator {
+    public:
+        static_assert(alignment >= alignof(element_type), "Alignment is too weak for this type!");
+        static_assert((alignment & (alignment - 1)) == 0, "Alignment should be a power of two!");
+
+        using value_type = element_type;
+
+        // Required by std::allocator_traits for allocators with non-type parameters
+        template <typename other_type>
+        struct rebind { using other = aligned_allocator<other_type, alignment>; };
+
+        aligned_allocator() noexcept = default;
+
+        template <typename other_type>
+        aligned_allocator(const aligned_allocator<other_type, alignment>&) noexcept {}
+
+        value_type* allocate(size_t count) {
+            // std::aligned_alloc requires size to be multiple of alignment
+            size_t size = (count * sizeof(value_type) + alignment - 1) / alignment * alignment;
+
+            void* memory = std::aligned_alloc(alignment, size);
+            if (memory == nullptr)
+                throw std::bad_alloc();
+
+            return static_cast<value_type*>(memory);
+        }
+
+        void deallocate(value_type* memory, size_t /* count */) noexcept {
+            std::free(memory);
+        }
+
+        template <typename other_type>
+        bool operator==(const aligned_allocator<other_type, alignment>&) const noexcept {
+            return true;
+        }
+    };
+
+    template <typename value_type, size_t alignment = 64>
+    using aligned_vector = std::vector<value_type, aligned_allocator<value_type, alignment>>;
+
+    // Allocator for big buffers that get swept whole every frame (framebuffers, per-pixel
+    // vertices), places them in huge pages, so that sweeps take far fewer TLB misses.
+    //
+    // Allocations of at least a huge page get explicit huge pages (MAP_HUGETLB) if system
+    // has them reserved, or a huge page aligned mapping advised to become transparent
+    // huge pages (MADV_HUGEPAGE) otherwise, which kernel may or may not do. On NUMA
+    // machines, pages are first touched by global pool's nodes in the order partitioned
+    // runs split indices (see first_touch), so buffers laid out in task order end up
+    // local to workers that process them. Smaller allocations, and platforms without
+    // huge pages, fall back to aligned_allocator
+    template <typename element_type>
+    class huge_page_allocator {
+    public:
+        using value_type = element_type;
+
+        static constexpr size_t HUGE_PAGE_SIZE = 2 << 20; // Most common size, 2 MiB
+
+        huge_page_allocator() noexcept = default;
+
+        template <typename other_type>
+        huge_page_allocator(const huge_page_allocator<other_type>&) noexcept {}
+
+        value_type* allocate(size_t count) {
+#ifdef __linux__
+            const size_t size = count * sizeof(value_type);
+            if (size >= HUGE_PAGE_SIZE) {
+                const size_t mapped_size = get_mapped_size(size);
+
+                void* memory = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+                if (memory == MAP_FAILED)
+                    memory = map_transparent(mapped_size); // No huge pages reserved
+
+                // Nothing is touched yet, so pages can still go to nodes that will use them
+                first_touch(memory, mapped_size, HUGE_PAGE_SIZE);
+
+                return static_cast<value_type*>(memory);
+            }
+#endif
+
+            return aligned_allocator<value_type>().allocate(count);
+        }
+
+        void deallocate(value_type* memory, size_t count) noexcept {
+#ifdef __linux__
+            const size_t size = count * sizeof(value_type);
+            if (size >= HUGE_PAGE_SIZE) {
+                munmap(memory, get_mapped_size(size));
+                return;
+            }
+#endif
+
+            aligned_allocator<value_type>().deallocate(memory, count);
+        }
+
+        template <typename other_type>
+        bool operator==(const huge_page_allocator<other_type>&) const noexcept {
+            return true;
+        }
+
+    private:
+        // Both kinds of mappings take whole huge pages, so that they're unmapped the same way
+        static size_t get_mapped_size(size_t size) {
+            return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        }
+
+#ifdef __linux__
+        // Regular pages, with mapping aligned to huge page, since only
+        // whole aligned huge pages can become transparent ones
+        static void* map_transparent(size_t mapped_size) {
+            const size_t reserved_size = mapped_size + HUGE_PAGE_SIZE;
+
+            void* reserved = mmap(nullptr, reserved_size, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (reserved == MAP_FAILED)
+                throw std::bad_alloc();
+
+            // Trim what's before aligned start and after the end
+            char* begin = static_cast<char*>(reserved);
+            char* aligned = begin + (HUGE_PAGE_SIZE - (size_t) begin % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+
+            if (aligned != begin)
+                munmap(begin, (size_t) (aligned - begin));
+
+            const size_t tail_size = (size_t) (begin + reserved_size - (aligned + mapped_size));
+            if (tail_size > 0)
+                munmap(aligned + mapped_size, tail_size);
+
+            madvise(aligned, mapped_size, MADV_HUGEPAGE); // Fails harmlessly where they're off
+
+            return aligned;
+        }
+#endif
+    };
+
+    template <typename value_type>
+    using huge_page_vector = std::vector<value_type, huge_page_allocator<value_type>>;
+
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace gl {
+
+    // Monotonic arena for data that lives exactly one frame. Allocations are bumps
+    // of an offset in one block, nothing is freed until next begin_frame(). When a
+    // frame doesn't fit, arena spills into extra heap chunks and next begin_frame()
+    // replaces block with one big enough for that frame's high-water mark (plus
+    // headroom), so frames of steady size stop touching the heap at all
+    class frame_arena {
+    public:
+        static constexpr size_t ALIGNMENT = 64;
+
+        struct frame_stats {
+            // Arena's own trips to the heap: chunks it spilled into, and the block
+            // regrown after a spill. Heap allocations made around arena aren't here
+            size_t arena_spills;
+            size_t peak_bytes; // Bytes handed out, including abandoned ones
+        };
+
+        frame_arena() = default;
+
+        frame_arena(const frame_arena&) = delete;
+        frame_arena& operator=(const frame_arena&) = delete;
+
+        // Invalidates everything allocated during previous frame
+        void begin_frame() {
+            m_last_frame = m_current_frame;
+
+            if (!m_chunks.empty()) {
+                m_chunks.clear();
+
+                // Grow by half again, so that a slowly growing frame doesn't spill every time
+                const size_t capacity = round_up(m_current_frame.peak_bytes + m_current_frame.peak_bytes / 2);
+                m_block = allocate_chunk(capacity);
+                m_capacity = capacity;
+
+                m_current_frame = { 1, 0 };
+            } else
+                m_current_frame = { 0, 0 };
+
+            m_offset = 0;
+        }
+
+        void* allocate(size_t size) {
+            size = round_up(size);
+            m_current_frame.peak_bytes += size;
+
+            if (m_offset + size <= m_capacity) {
+                void* memory = m_block.get() + m_offset;
+                m_offset += size;
+                return memory;
+            }
+
+            // Spilled, chunk is kept until frame ends
+            m_chunks.push_back(allocate_chunk(size));
+            ++ m_current_frame.arena_spills;
+
+            return m_chunks.back().get();
+        }
+
+        const frame_stats& get_last_frame_stats() const { return m_last_frame; }
+        size_t get_capacity() const { return m_capacity; }
+
+    private:
+        struct chunk_deleter {
+            void operator()(std::byte* memory) const { std::free(memory); }
+        };
+
+        using chunk = std::unique_ptr<std::byte[], chunk_deleter>;
+
+        static size_t round_up(size_t size) {
+            return std::max<size_t>(ALIGNMENT, (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT);
+        }
+
+        static chunk allocate_chunk(size_t size) {
+            void* memory = std::aligned_alloc(ALIGNMENT, size);
+            if (memory == nullptr)
+                throw std::bad_alloc();
+
+            return chunk(static_cast<std::byte*>(memory));
+        }
+
+        chunk m_block;
+        size_t m_capacity = 0, m_offset = 0;
+
+        std::vector<chunk> m_chunks;
+
+        frame_stats m_current_frame = { 0, 0 }, m_last_frame = { 0, 0 };
+    };
+
+    // Allocator for std containers that takes memory from a frame arena, containers
+    // should drop their storage (see release_storage) before arena's next frame
+    template <typename element_type>
+    class arena_allocator {
+    public:
+        static_assert(alignof(element_type) <= frame_arena::ALIGNMENT, "Arena can't align this type!");
+
+        using value_type = element_type;
+
+        arena_allocator(frame_arena& arena) noexcept: m_arena(&arena) {}
+
+        template <typename other_type>
+        arena_allocator(const arena_allocator<other_type>& other) noexcept: m_arena(other.get_arena()) {}
+
+        value_type* allocate(size_t count) {
+            return static_cast<value_type*>(m_arena->allocate(count * sizeof(value_type)));
+        }
+
+        void deallocate(value_type* /* memory */, size_t /* count */) noexcept {
+            // Freed all at once, when frame ends
+        }
+
+        frame_arena* get_arena() const noexcept { return m_arena; }
+
+        template <typename other_type>
+        bool operator==(const arena_allocator<other_type>& other) const noexcept {
+            return m_arena == other.get_arena();
+        }
+
+    private:
+        frame_arena* m_arena;
+    };
+
+    // Drops container's arena storage without touching the heap (shrink_to_fit is only a request)
+    template <typename value_type>
+    void release_storage(std::vector<value_type, arena_allocator<value_type>>& vector) {
+        std::vector<value_type, arena_allocator<value_type>>(vector.get_allocator()).swap(vector);
+    }
+
+}
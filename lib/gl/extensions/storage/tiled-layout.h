@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace gl {
+
+    // Layout of per-pixel data (of width x height image) in square tiles: every TILE_SIZE
+    // rows form a band, band is a sequence of tiles left to right, and every tile stores
+    // its pixels contiguously, row by row. Pixels of a tile, and their neighbors in
+    // adjacent rows, are then a few cache lines apart instead of a whole scanline, so
+    // that tile-parallel shading and neighborhood passes stay in cache.
+    //
+    // Tiles on the right and bottom edges are as narrow (or short) as pixels left
+    // for them, so there's no padding, layout holds exactly width * height pixels
+    class tiled_layout {
+    public:
+        // Same as pixel_drawing_window's tiles, so that each of them is one block of memory
+        static constexpr int TILE_SIZE = 8;
+
+        tiled_layout(int width, int height)
+            : m_width(width), m_height(height) {}
+
+        int get_width()  const { return m_width;  }
+        int get_height() const { return m_height; }
+
+        size_t get_size() const { return (size_t) m_width * m_height; }
+
+        size_t get_index(int i, int j) const {
+            const int band = i / TILE_SIZE, tile = j / TILE_SIZE;
+
+            const int band_height = std::min(TILE_SIZE, m_height - band * TILE_SIZE);
+            const int tile_width  = std::min(TILE_SIZE, m_width  - tile * TILE_SIZE);
+
+            // Tiles before this one in its band are all full width
+            return (size_t) band * TILE_SIZE * m_width + (size_t) tile * TILE_SIZE * band_height +
+                   (size_t) (i % TILE_SIZE) * tile_width + (size_t) (j % TILE_SIZE);
+        }
+
+    private:
+        int m_width, m_height;
+    };
+
+}
@@ -25,6 +25,12 @@ namespace gl {
         return {{ GL_UNSIGNED_INT, count, count * sizeof(unsigned int) }};
     }
 
+    // Bytes are normalized to [0, 1] when read by shaders (see vertex_array), meant for packed colors
+    template <>
+    vertex_layout vertex::of_type<unsigned char>(size_t count) {
+        return {{ GL_UNSIGNED_BYTE, count, count * sizeof(unsigned char) }};
+    }
+
     vertex::operator vertex_layout() {
         return vertex_layout { *this };
     }
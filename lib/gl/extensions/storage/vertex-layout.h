@@ -24,6 +24,7 @@ namespace gl {
         operator vertex_layout();
 
         friend class vertex_array;
+        friend class instanced_vertex_array;
     };
 
     // --------------------------------- VERTEX LAYOUT ---------------------------------
@@ -39,6 +40,7 @@ namespace gl {
         vertex_layout& operator+(const vertex_layout& other);
 
         friend class vertex_array;
+        friend class instanced_vertex_array;
     };
 
     vertex_layout operator+(const vertex& first, const vertex& second);
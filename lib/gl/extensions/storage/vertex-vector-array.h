@@ -4,32 +4,58 @@
 #include "vertex-buffer.h"
 #include "vertex-layout.h"
 
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace gl {
 
-    template <typename value_type>
-    class vertex_vector_array: public std::vector<value_type> {
+    // Allocator can be swapped for huge_page_allocator (or other ones
+    // from aligned-allocator.h) for big arrays updated every frame.
+    //
+    // GL objects are only created when array is first uploaded or drawn, so
+    // it can be filled (e.g. tessellated into) without any context at all
+    template <typename value_type, typename allocator_type = std::allocator<value_type>>
+    class vertex_vector_array: public std::vector<value_type, allocator_type> {
     public:
-        vertex_vector_array(): m_element_array_holder() {}
+        vertex_vector_array() = default;
+
+        // For allocators with state, like arena_allocator
+        explicit vertex_vector_array(const allocator_type& allocator)
+            : std::vector<value_type, allocator_type>(allocator) {}
 
         void set_layout(gl::vertex_layout layout) {
-            m_element_array_holder.set_layout(layout);
+            m_layout = layout;
+
+            if (m_element_array_holder)
+                m_element_array_holder->set_layout(layout);
         }
 
         const vertex_array& get_vertex_array() const {
-            return m_element_array_holder;
+            return get_holder();
         }
 
-        void update() { m_element_array_holder.assign(*this); }
+        void update() { get_holder().assign(*this); }
+
+        // Uploads /ranges/ of value_type elements instead of own ones, e.g. to
+        // put together parts of geometry that live in separate containers
+        void update(std::span<const raw_data> ranges) { get_holder().assign(ranges); }
 
         void assign_and_update(std::initializer_list<value_type> init) {
-            std::vector<value_type>::assign(init);
+            std::vector<value_type, allocator_type>::assign(init);
             update();
         }
 
     private:
-        vertex_array m_element_array_holder;
+        gl::vertex_layout m_layout;
+        mutable std::optional<vertex_array> m_element_array_holder;
+
+        vertex_array& get_holder() const {
+            if (!m_element_array_holder)
+                m_element_array_holder.emplace(m_layout);
+
+            return *m_element_array_holder;
+        }
     };
 
 };
@@ -0,0 +1,69 @@
+#include "instanced-vertex-array.h"
+#include "vertex-array.h"
+
+#include "opengl-wrapper.h"
+
+namespace gl {
+
+    instanced_vertex_array::instanced_vertex_array(vertex_layout new_mesh_layout,
+                                                   vertex_layout new_instance_layout)
+        : mesh_buffer(), instance_buffer(),
+          mesh_layout(new_mesh_layout), instance_layout(new_instance_layout) {
+
+        gl::raw::gen_vertex_arrays(1, &this->id);
+    }
+
+    void instanced_vertex_array::set_attributes(const vertex_layout& layout, unsigned int first_index,
+                                                unsigned int divisor) const {
+        unsigned int total_size = 0;
+        for (vertex current: layout.vertices)
+            total_size += current.size;
+
+        unsigned int offset = 0;
+        for (unsigned int i = 0; i < layout.vertices.size(); ++ i) {
+            const vertex& layout_element = layout.vertices[i];
+
+            gl::raw::enable_vertex_attrib_array(first_index + i);
+            gl::raw::vertex_attrib_pointer(first_index + i, (int) layout_element.count,
+                                           layout_element.type_id,
+                                           vertex_array::is_normalized(layout_element),
+                                           (int) total_size,
+                                           (const void*)(uintptr_t) offset);
+
+            gl::raw::vertex_attrib_divisor(first_index + i, divisor);
+
+            offset += layout_element.size;
+        }
+    }
+
+    void instanced_vertex_array::assign_mesh(raw_data new_data, size_t element_count) {
+        this->mesh_element_count = element_count;
+        this->mesh_buffer.set_data(new_data);
+
+        this->bind();
+        this->mesh_buffer.bind();
+
+        set_attributes(this->mesh_layout, 0, 0);
+    }
+
+    void instanced_vertex_array::assign_instances(raw_data new_data, size_t count) {
+        this->instance_count = count;
+        this->instance_buffer.set_data(new_data);
+
+        this->bind();
+        this->instance_buffer.bind();
+
+        set_attributes(this->instance_layout, (unsigned int) this->mesh_layout.vertices.size(), 1);
+    }
+
+    size_t instanced_vertex_array::get_mesh_element_count() const {
+        return mesh_element_count;
+    }
+
+    size_t instanced_vertex_array::get_instance_count() const {
+        return instance_count;
+    }
+
+    void instanced_vertex_array::bind() const { gl::raw::bind_vertex_array(this->id); }
+
+};
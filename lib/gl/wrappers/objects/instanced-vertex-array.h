@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vertex-buffer.h"
+#include "vertex-layout.h"
+
+#include <GL/glew.h>
+
+#include <vector>
+
+namespace gl {
+
+    // Vertex array with two buffers: a mesh that every instance shares, and
+    // per-instance attributes, which advance once per instance instead of per
+    // vertex. Instance attributes come right after mesh's ones in shaders
+    class instanced_vertex_array final {
+    private:
+        unsigned int id;
+        size_t mesh_element_count = 0, instance_count = 0;
+
+        vertex_buffer mesh_buffer, instance_buffer;
+        vertex_layout mesh_layout, instance_layout;
+
+        void set_attributes(const vertex_layout& layout, unsigned int first_index,
+                            unsigned int divisor) const;
+
+    public:
+        instanced_vertex_array(vertex_layout new_mesh_layout, vertex_layout new_instance_layout);
+
+        void assign_mesh(raw_data new_data, size_t element_count);
+        void assign_instances(raw_data new_data, size_t count);
+
+        template <typename value_type, typename allocator_type>
+        void assign_mesh(const std::vector<value_type, allocator_type>& mesh) {
+            assign_mesh({ (void*) mesh.data(), mesh.size() * sizeof(value_type) }, mesh.size());
+        }
+
+        template <typename value_type, typename allocator_type>
+        void assign_instances(const std::vector<value_type, allocator_type>& instances) {
+            assign_instances({ (void*) instances.data(), instances.size() * sizeof(value_type) },
+                             instances.size());
+        }
+
+        size_t get_mesh_element_count() const;
+        size_t get_instance_count() const;
+
+        void bind() const;
+    };
+
+};
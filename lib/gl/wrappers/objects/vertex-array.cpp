@@ -5,6 +5,10 @@
 #include "opengl-wrapper.h"
 
 namespace gl {
+    GLboolean vertex_array::is_normalized(const vertex& element) {
+        return element.type_id == GL_UNSIGNED_BYTE? GL_TRUE : GL_FALSE;
+    }
+
     vertex_array::vertex_array(): buffer(), layout() {
         gl::raw::gen_vertex_arrays(1, &this->id);
     }
@@ -24,13 +28,29 @@ namespace gl {
 
     void vertex_array::assign(raw_data new_data) {
         this->buffer.set_data(new_data);
-        
+        set_attributes();
+    }
+
+    void vertex_array::assign(std::span<const raw_data> ranges) {
+        this->buffer.set_data(ranges);
+        this->element_count = this->buffer.size() / get_layout_size();
+
+        set_attributes();
+    }
+
+    size_t vertex_array::get_layout_size() const {
+        size_t layout_size = 0;
+        for (vertex current: this->layout.vertices)
+            layout_size += current.size;
+
+        return layout_size;
+    }
+
+    void vertex_array::set_attributes() const {
         this->bind();
         this->buffer.bind();
 
-        unsigned int total_size = 0;
-        for (vertex current: this->layout.vertices)
-            total_size += current.size;
+        unsigned int total_size = (unsigned int) get_layout_size();
 
         unsigned int offset = 0;
         for (unsigned int i = 0; i < this->layout.vertices.size(); ++ i) {
@@ -38,7 +58,7 @@ namespace gl {
 
             gl::raw::enable_vertex_attrib_array(i);
             gl::raw::vertex_attrib_pointer(i, (int) layout_element.count,
-                                           layout_element.type_id, GL_FALSE,
+                                           layout_element.type_id, is_normalized(layout_element),
                                            (int) total_size,
                                            (const void*)(uintptr_t) offset);
 
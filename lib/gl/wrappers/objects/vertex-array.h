@@ -6,6 +6,7 @@
 #include <GL/glew.h>
 
 #include <initializer_list>
+#include <span>
 #include <vector>
 
 namespace gl {
@@ -18,14 +19,19 @@ namespace gl {
         vertex_buffer buffer;
         vertex_layout layout;
 
+        size_t get_layout_size() const;
+        void set_attributes() const;
+
     public:
         vertex_array();
 
         vertex_array(vertex_layout new_layout);
         vertex_array(vertex_layout new_layout, raw_data new_data);
 
-        template <typename value_type>
-        void assign(std::vector<value_type> data_buffer) {
+        // Buffers are taken by reference, per-pixel ones take
+        // tens of megabytes, copying them every frame adds up
+        template <typename value_type, typename allocator_type>
+        void assign(const std::vector<value_type, allocator_type>& data_buffer) {
             this->element_count = data_buffer.size();
 
             size_t layout_size = 0;
@@ -33,13 +39,13 @@ namespace gl {
                 layout_size += current.size;
 
             assign(this->layout, {
-                    (void*) &(*data_buffer.begin()),
+                    (void*) data_buffer.data(),
                     layout_size * data_buffer.size()
             });
         }
 
-        template <typename value_type>
-        void assign(vertex_layout new_layout, std::vector<value_type> data_buffer) {
+        template <typename value_type, typename allocator_type>
+        void assign(vertex_layout new_layout, const std::vector<value_type, allocator_type>& data_buffer) {
             this->layout = new_layout;
             assign(data_buffer);
         }
@@ -51,6 +57,9 @@ namespace gl {
         void assign(raw_data new_buffer);
         void assign(vertex_layout new_layout, raw_data new_data);
 
+        // Elements are split in ranges, which are uploaded one after another
+        void assign(std::span<const raw_data> ranges);
+
         void set_layout(vertex_layout layout);
 
         size_t size() const;
@@ -58,6 +67,9 @@ namespace gl {
 
         void bind() const;
 
+        // Byte attributes are packed colors, read by shaders as [0, 1] floats
+        static GLboolean is_normalized(const vertex& element);
+
         ~vertex_array();
     };
 
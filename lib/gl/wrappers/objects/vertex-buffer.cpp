@@ -31,6 +31,23 @@ namespace gl {
                              data.data, GL_DYNAMIC_DRAW);
     }
 
+    void vertex_buffer::set_data(std::span<const raw_data> ranges) {
+        size_t total_size = 0;
+        for (const raw_data& range: ranges)
+            total_size += range.size;
+
+        this->data = { NULL, total_size };
+
+        bind();
+        gl::raw::buffer_data(GL_ARRAY_BUFFER, (int) total_size, NULL, GL_DYNAMIC_DRAW);
+
+        size_t offset = 0;
+        for (const raw_data& range: ranges) {
+            gl::raw::buffer_sub_data(GL_ARRAY_BUFFER, (GLintptr) offset, (GLsizeiptr) range.size, range.data);
+            offset += range.size;
+        }
+    }
+
     size_t vertex_buffer::size() const {
         return data.size;
     }
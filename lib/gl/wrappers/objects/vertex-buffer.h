@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <span>
 
 namespace gl {
 
@@ -24,6 +25,9 @@ namespace gl {
         ~vertex_buffer();
 
         void set_data(raw_data new_data);
+
+        // Buffer holds ranges one after another, each uploaded in place
+        void set_data(std::span<const raw_data> ranges);
         void bind() const;
 
         size_t size() const;
@@ -34,12 +34,14 @@ void glBegin(GLenum mode),
 void glBindBuffer(GLenum target, GLuint buffer),
 void glBindVertexArray(GLuint array),
 void glBufferData(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage),
+void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data),
 void glClear(GLbitfield mask),
 void glColor3f(GLfloat red, GLfloat green, GLfloat blue),
 void glCompileShader(GLuint shader),
 void glDeleteBuffers(GLsizei n, const GLuint *buffers),
 void glDeleteProgram(GLuint program),
 void glDrawArrays(GLenum mode, GLint first, GLsizei count),
+void glDrawArraysInstancedBaseInstance(GLenum mode, GLint first, GLsizei count, GLsizei instancecount, GLuint baseinstance),
 void glEnableVertexAttribArray(GLuint index),
 void glEnd(),
 void glGenBuffers(GLsizei n, GLuint *buffers),
@@ -92,6 +94,7 @@ void glUniformMatrix4x3fv(GLint location, GLsizei count, GLboolean transpose, co
 void glUseProgram(GLuint program),
 void glValidateProgram(GLuint program),
 void glVertex2f(GLfloat x, GLfloat y),
+void glVertexAttribDivisor(GLuint index, GLuint divisor),
 void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid* pointer))')
 
 divert(0)dnl
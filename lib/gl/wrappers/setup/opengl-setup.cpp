@@ -189,13 +189,12 @@ namespace gl {
     // GLFWwindow <=> gl::window mapping for deducing gl::window in key callback
     static std::map<GLFWwindow*, gl::window*> window_mapping {};
 
-    window::window(const int width, const int height, const char* title)
+    window::window(const int width, const int height, const char* title, const int sample_count)
         : current_fps(0), width(width), height(height) {
 
         if (!glfwInit())
             throw std::runtime_error("Failed to initialize glfw!");
 
-        static constexpr int sample_count = 16;
         glfwWindowHint(GLFW_SAMPLES, sample_count);
 
         glfw_window = glfwCreateWindow(width, height, title, NULL, NULL);
@@ -217,7 +216,9 @@ namespace gl {
         if (glewInit() != GLEW_OK)
             throw std::runtime_error("Failed to initialize glew!");
 
-        glEnable(GL_MULTISAMPLE);
+        if (sample_count > 0)
+            glEnable(GL_MULTISAMPLE);
+
         // glEnable(GL_BLEND); // Allow transparency
     }
     
@@ -230,17 +231,54 @@ namespace gl {
         return current_fps;
     }
 
+    int window::get_idle_wakeups() const noexcept {
+        return current_idle_wakeups;
+    }
+
+    void window::set_render_on_demand(bool is_enabled) noexcept {
+        is_render_on_demand = is_enabled;
+        request_redraw();
+    }
+
+    bool window::is_rendering_on_demand() const noexcept {
+        return is_render_on_demand;
+    }
+
+    void window::request_redraw() noexcept {
+        if (!is_redraw_requested.exchange(true))
+            glfwPostEmptyEvent();
+    }
+
+    void window::set_animating(bool is_enabled) noexcept {
+        is_animating = is_enabled;
+    }
+
+    void window::close() noexcept {
+        glfwSetWindowShouldClose(glfw_window, GLFW_TRUE);
+        glfwPostEmptyEvent(); // Sleeping loop should notice
+    }
+
     GLFWwindow* window::get_glfw_window() const noexcept {
         return this->glfw_window;
     }
 
+    void window::dispatch_input(const input_event& event) {
+        switch (event.kind) {
+        case input_event::type::KEY_PRESSED: on_key_pressed(event.pressed_key); break;
+        case input_event::type::MOUSE_MOVED: on_mouse_moved(event.cursor);      break;
+        }
+    }
+
     static void key_press_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
         // Unused for now (maybe in the future this could take advantage of them)
         (void) scancode;
         (void) mods;
             
-        if (action == GLFW_PRESS || action == GLFW_REPEAT)
-            window_mapping[window]->on_key_pressed((gl::key) key);
+        if (action == GLFW_PRESS || action == GLFW_REPEAT) {
+            window_mapping[window]->request_redraw();
+            window_mapping[window]->on_input({ .kind = input_event::type::KEY_PRESSED,
+                                               .pressed_key = (gl::key) key });
+        }
     }
 
     static void mouse_press_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -259,36 +297,59 @@ namespace gl {
         if (ypos < 0)
             return;
 
-        current_window.on_mouse_moved({
-            static_cast<float>(xpos / (current_window.width / 2.0) - 1.0),
-            static_cast<float>(1.0 - ypos / (current_window.height / 2.0))
+        current_window.request_redraw();
+        current_window.on_input({
+            .kind = input_event::type::MOUSE_MOVED,
+            .cursor = {
+                static_cast<float>(xpos / (current_window.width / 2.0) - 1.0),
+                static_cast<float>(1.0 - ypos / (current_window.height / 2.0))
+            }
         });
     }
 
+    static void refresh_callback(GLFWwindow* window) {
+        // Window got exposed or resized, its contents may be gone
+        window_mapping[window]->request_redraw();
+    }
+
     void window::draw_loop() {
         setup();
 
         glfwSetKeyCallback(this->glfw_window, &key_press_callback);
         glfwSetCursorPosCallback(this->glfw_window, &mouse_press_callback);
+        glfwSetWindowRefreshCallback(this->glfw_window, &refresh_callback);
 
-        static int fps_counter = 0;
+        int fps_counter = 0, idle_counter = 0;
 
         double last_time = glfwGetTime();
         while (!glfwWindowShouldClose(glfw_window)) {
-            gl::raw::clear(GL_COLOR_BUFFER_BIT);
+            // Request is taken before drawing, so ones made during it get their own frame
+            const bool should_draw = is_redraw_requested.exchange(false) ||
+                                     !is_render_on_demand || is_animating;
+
+            if (should_draw) {
+                gl::raw::clear(GL_COLOR_BUFFER_BIT);
 
-            draw();
+                draw();
 
-            glfwSwapBuffers(glfw_window);
-            glfwPollEvents();
+                glfwSwapBuffers(glfw_window);
+                glfwPollEvents();
+
+                fps_counter ++;
+            } else {
+                // Nothing changed, sleep until something does
+                glfwWaitEventsTimeout(IDLE_TIMEOUT);
+
+                idle_counter ++;
+            }
 
             double current_time = glfwGetTime();
-            fps_counter ++;
             if (current_time - last_time >= 1.0) {
                 current_fps = fps_counter;
+                current_idle_wakeups = idle_counter;
                 on_fps_updated();
 
-                fps_counter = 0;
+                fps_counter = idle_counter = 0;
                 last_time = current_time;
             }
         }
@@ -309,4 +370,25 @@ namespace gl {
         shaders.bind();
         draw(type, array);
     }
+
+    void draw(drawing_type type, const vertex_array& array, const shaders::shader_program& shaders,
+              size_t first, size_t count) {
+        if (count == 0)
+            return;
+
+        shaders.bind();
+        array.bind();
+        gl::raw::draw_arrays((unsigned int) type, (int) first, (int) count);
+    }
+
+    void draw_instanced(drawing_type type, const instanced_vertex_array& array,
+                        const shaders::shader_program& shaders,
+                        size_t first_vertex, size_t vertex_count,
+                        size_t first_instance, size_t instance_count) {
+        shaders.bind();
+        array.bind();
+
+        gl::raw::draw_arrays_instanced_base_instance((unsigned int) type, (int) first_vertex, (int) vertex_count,
+                                                     (int) instance_count, (unsigned int) first_instance);
+    }
 }
@@ -3,6 +3,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <atomic>
 #include <initializer_list>
 #include <stdexcept>
 #include <string>
@@ -11,6 +12,7 @@
 
 #include "math.h"
 #include "vec.h"
+#include "instanced-vertex-array.h"
 #include "vertex-array.h"
 #include "vertex-vector-array.h"
 
@@ -193,15 +195,36 @@ namespace gl {
         MENU          = GLFW_KEY_MENU,
     };
 
+    // Input that window received, as passed to on_key_pressed or on_mouse_moved
+    struct input_event {
+        enum class type { KEY_PRESSED, MOUSE_MOVED };
+
+        type kind = type::KEY_PRESSED;
+
+        key pressed_key {};                // For KEY_PRESSED
+        math::vec2 cursor { 0.0f, 0.0f }; // For MOUSE_MOVED
+    };
+
     class window {
     private:
-        int current_fps;
+        int current_fps = 0;
+        int current_idle_wakeups = 0;
         GLFWwindow* glfw_window;
 
+        bool is_render_on_demand = false;
+        bool is_animating = false;
+
+        // Set from any thread, first frame is always drawn
+        std::atomic<bool> is_redraw_requested { true };
+
     public:
         const int width, height;
 
-        window(int width, int height, const char* title);
+        // Multisampling is expensive for dense geometry, windows that
+        // present already antialiased pixels should pass 0 to disable it
+        static constexpr int DEFAULT_SAMPLE_COUNT = 16;
+
+        window(int width, int height, const char* title, int sample_count = DEFAULT_SAMPLE_COUNT);
 
         // This class shouldn't be copied or moved
         window(const window&) = delete;
@@ -209,11 +232,34 @@ namespace gl {
 
         void bind() const;
 
+        // Frames actually drawn during last second
         int get_fps() const noexcept;
+
+        // Times render on demand loop went to sleep instead of drawing during last second
+        int get_idle_wakeups() const noexcept;
+
         GLFWwindow* get_glfw_window() const noexcept;
 
+        // ==> Render on demand: instead of drawing frames back to back, loop sleeps
+        //     until input arrives, redraw is requested or window is animating
+
+        // Longest sleep, so that FPS keeps getting updated while idle
+        static constexpr double IDLE_TIMEOUT = 0.5; // In seconds
+
+        void set_render_on_demand(bool is_enabled) noexcept;
+        bool is_rendering_on_demand() const noexcept;
+
+        // Can be called from any thread, wakes loop up if it's sleeping
+        void request_redraw() noexcept;
+
+        // Animating window is redrawn continuously, like without render on demand
+        void set_animating(bool is_enabled) noexcept;
+
         void draw_loop();
 
+        // Can be called from any thread, draw_loop returns after current frame
+        void close() noexcept;
+
         virtual void setup() {};
         virtual void draw() = 0;
 
@@ -227,6 +273,16 @@ namespace gl {
             (void) cursor; // Ignore parameter
         }
 
+        // Every input event goes through here, default implementation dispatches
+        // it right away, windows that handle input elsewhere (e.g. on another
+        // thread) can take it and dispatch it themselves later
+        virtual void on_input(const input_event& event) {
+            dispatch_input(event);
+        }
+
+        // Calls on_key_pressed or on_mouse_moved for event
+        void dispatch_input(const input_event& event);
+
         virtual ~window();
     };
 
@@ -250,15 +306,33 @@ namespace gl {
 
     void draw(drawing_type type, const vertex_array& array);
 
-    template <typename value_type>
-    void draw(drawing_type type, const vertex_vector_array<value_type>& array,
+    // Draws only vertices [first, first + count) of /array/
+    void draw(drawing_type type, const vertex_array& array, const shaders::shader_program& shaders,
+              size_t first, size_t count);
+
+    // Draws instances [first_instance, first_instance + instance_count), each
+    // with mesh's vertices [first_vertex, first_vertex + vertex_count)
+    void draw_instanced(drawing_type type, const instanced_vertex_array& array,
+                        const shaders::shader_program& shaders,
+                        size_t first_vertex, size_t vertex_count,
+                        size_t first_instance, size_t instance_count);
+
+    template <typename value_type, typename allocator_type>
+    void draw(drawing_type type, const vertex_vector_array<value_type, allocator_type>& array,
               const shaders::shader_program& shaders) {
 
         draw(type, array.get_vertex_array(), shaders);
     }
 
-    template <typename value_type>
-    void draw(drawing_type type, const vertex_vector_array<value_type>& array) {
+    template <typename value_type, typename allocator_type>
+    void draw(drawing_type type, const vertex_vector_array<value_type, allocator_type>& array) {
         draw(type, array.get_vertex_array());
     }
+
+    template <typename value_type, typename allocator_type>
+    void draw(drawing_type type, const vertex_vector_array<value_type, allocator_type>& array,
+              const shaders::shader_program& shaders, size_t first, size_t count) {
+
+        draw(type, array.get_vertex_array(), shaders, first, count);
+    }
 }
@@ -0,0 +1,60 @@
+#shader vertex   ------------------------------------------------------------------------------------------
+
+#version 460 core
+
+// Mesh, see instanced_primitive_renderer::setup
+layout(location = 0) in vec3 corner; // Along, across, part (0 for body, 1 for vector's head)
+
+// Instance, see primitive_instance
+layout(location = 1) in vec2  from;
+layout(location = 2) in vec2  to;
+layout(location = 3) in float width;
+layout(location = 4) in vec4  color;
+
+// Same as primitive_shape
+const int LINE = 0, RECTANGLE = 1, VECTOR = 2;
+
+uniform int shape;
+
+uniform vec2 axes_scale;
+uniform vec2 axes_offset;
+
+uniform float vector_gap; // Vector's line stops that short of its head's tip
+
+out vec3 frag_color;
+
+void main() {
+    vec2 world;
+
+    if (shape == RECTANGLE)
+        world = mix(from, to, vec2(corner.x, corner.y + 0.5));
+    else {
+        vec2 direction = normalize(to - from);
+        vec2 normal = vec2(-direction.y, direction.x);
+
+        if (corner.z == 0.0) {
+            vec2 end = shape == VECTOR? to - direction * vector_gap : to;
+
+            // Rectangular caps, like drawing_manager::draw_line
+            vec2 begin_cap = from - direction * width / 2.0;
+            vec2 end_cap   = end  + direction * width / 2.0;
+
+            world = mix(begin_cap, end_cap, corner.x) + normal * (corner.y * width);
+        } else
+            world = to + direction * corner.x + normal * corner.y;
+    }
+
+    frag_color = color.rgb;
+    gl_Position = vec4(world * axes_scale + axes_offset, 0.0, 1.0);
+}
+
+#shader fragment ------------------------------------------------------------------------------------------
+
+#version 460 core
+
+in vec3 frag_color;
+out vec4 color;
+
+void main() {
+    color = vec4(frag_color, 1.0f);
+}
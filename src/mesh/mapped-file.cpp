@@ -0,0 +1,48 @@
+#include "mapped-file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace raycaster {
+
+    mapped_file::mapped_file(const std::string& filename) {
+        int descriptor = open(filename.c_str(), O_RDONLY);
+        if (descriptor == -1)
+            throw std::runtime_error("Failed to open '" + filename + "': " + std::strerror(errno));
+
+        struct stat status;
+        if (fstat(descriptor, &status) == -1) {
+            close(descriptor);
+            throw std::runtime_error("Failed to stat '" + filename + "': " + std::strerror(errno));
+        }
+
+        m_size = (size_t) status.st_size;
+        if (m_size == 0) { // Mapping of zero length is invalid, but empty file is fine
+            close(descriptor);
+            return;
+        }
+
+        void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        close(descriptor); // Mapping keeps file referenced on its own
+
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error("Failed to map '" + filename + "': " + std::strerror(errno));
+
+        // Whole file is going to be read soon (in parallel), ask for read-ahead
+        madvise(mapping, m_size, MADV_WILLNEED);
+
+        m_data = static_cast<const char*>(mapping);
+    }
+
+    mapped_file::~mapped_file() {
+        if (m_data != nullptr)
+            munmap(const_cast<char*>(m_data), m_size);
+    }
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace raycaster {
+
+    // Read-only memory mapping of the whole file, lets loaders parse it from
+    // many threads at once without copying it through stream buffers first
+    class mapped_file {
+    public:
+        explicit mapped_file(const std::string& filename);
+
+        // This class shouldn't be copied (it owns mapping)
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+        std::string_view view() const { return { m_data, m_size }; }
+
+        ~mapped_file();
+
+    private:
+        const char* m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+}
@@ -0,0 +1,128 @@
+#include "mesh-bvh.h"
+
+#include <cmath>
+#include <limits>
+
+namespace raycaster {
+
+    void mesh_bvh::build(const triangle_mesh& mesh, uint32_t material, gl::thread_pool& pool) {
+        m_material = material;
+
+        const size_t count = mesh.get_triangle_count();
+
+        static constexpr size_t GRAIN = 1 << 14;
+
+        std::vector<aabb> bounds(count);
+        gl::parallel_for(0, count, GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i) {
+                aabb current;
+                for (size_t corner = 0; corner < 3; ++ corner)
+                    current.extend(mesh.positions[mesh.indices[3 * i + corner]]);
+
+                bounds[i] = current;
+            }
+        }, pool);
+
+        m_bvh.build(bounds, pool);
+
+        // ==> Store triangles in the order leaves reference them:
+
+        const std::vector<uint32_t>& order = m_bvh.get_primitive_order();
+
+        m_triangles.resize(count);
+        gl::parallel_for(0, count, GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i) {
+                const uint32_t* corners = &mesh.indices[3 * order[i]];
+
+                const math::vec3& p0 = mesh.positions[corners[0]];
+                const math::vec3& p1 = mesh.positions[corners[1]];
+                const math::vec3& p2 = mesh.positions[corners[2]];
+
+                triangle& current = m_triangles[i];
+                for (int axis = 0; axis < 3; ++ axis) {
+                    current.vertex[axis] = p0[axis];
+
+                    current.edge1[axis] = p1[axis] - p0[axis];
+                    current.edge2[axis] = p2[axis] - p0[axis];
+                }
+            }
+        }, pool);
+    }
+
+    bool mesh_bvh::intersect_triangle(uint32_t index, const ray& current_ray, hit& closest) const {
+        const triangle& current = m_triangles[index];
+
+        const float origin[3]    = { current_ray.origin.x(),    current_ray.origin.y(),    current_ray.origin.z()    };
+        const float direction[3] = { current_ray.direction.x(), current_ray.direction.y(), current_ray.direction.z() };
+
+        auto cross = [](const float lhs[3], const float rhs[3], float result[3]) {
+            result[0] = lhs[1] * rhs[2] - lhs[2] * rhs[1];
+            result[1] = lhs[2] * rhs[0] - lhs[0] * rhs[2];
+            result[2] = lhs[0] * rhs[1] - lhs[1] * rhs[0];
+        };
+
+        auto dot = [](const float lhs[3], const float rhs[3]) {
+            return lhs[0] * rhs[0] + lhs[1] * rhs[1] + lhs[2] * rhs[2];
+        };
+
+        // ==> Möller–Trumbore:
+
+        float p[3];
+        cross(direction, current.edge2, p);
+
+        const float determinant = dot(current.edge1, p);
+        if (std::abs(determinant) < 1e-12f)
+            return false; // Ray is parallel to triangle's plane
+
+        const float inverse_determinant = 1.0f / determinant;
+
+        const float relative_origin[3] = { origin[0] - current.vertex[0],
+                                           origin[1] - current.vertex[1],
+                                           origin[2] - current.vertex[2] };
+
+        const float u = dot(relative_origin, p) * inverse_determinant;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+
+        float q[3];
+        cross(relative_origin, current.edge1, q);
+
+        const float v = dot(direction, q) * inverse_determinant;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+
+        const float distance = dot(current.edge2, q) * inverse_determinant;
+        if (distance < ray_epsilon || distance >= closest.distance)
+            return false;
+
+        // Geometric normal, facing the ray (meshes aren't required to be closed)
+        float normal[3];
+        cross(current.edge1, current.edge2, normal);
+
+        float scale = 1.0f / std::sqrt(dot(normal, normal));
+        if (dot(normal, direction) > 0.0f)
+            scale = - scale;
+
+        closest.distance = distance;
+        closest.position = current_ray.origin + current_ray.direction * distance;
+        closest.normal   = { normal[0] * scale, normal[1] * scale, normal[2] * scale };
+        closest.material = m_material;
+
+        closest.edge_distance = std::numeric_limits<float>::infinity();
+
+        return true;
+    }
+
+    bool mesh_bvh::intersect(const ray& current_ray, hit& closest) const {
+        return m_bvh.intersect(current_ray, closest, [this](uint32_t index, const ray& current_ray, hit& closest) {
+            return intersect_triangle(index, current_ray, closest);
+        });
+    }
+
+    bool mesh_bvh::occluded(const ray& current_ray, float max_distance) const {
+        return m_bvh.occluded(current_ray, max_distance, [this](uint32_t index, const ray& current_ray, hit& closest) {
+            return intersect_triangle(index, current_ray, closest);
+        });
+    }
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "aabb.h"
+#include "bvh.h"
+#include "ray.h"
+#include "thread-pool.h"
+#include "triangle-mesh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace raycaster {
+
+    // Triangle mesh prepared for ray tracing: triangles are reordered to follow
+    // BVH's leaves and stored in form Möller–Trumbore test consumes directly
+    class mesh_bvh {
+    public:
+        void build(const triangle_mesh& mesh, uint32_t material = 0,
+                   gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Finds nearest intersection closer than /closest/ and updates it
+        bool intersect(const ray& current_ray, hit& closest) const;
+
+        // Checks if any triangle is closer than /max_distance/ along the ray
+        bool occluded(const ray& current_ray, float max_distance) const;
+
+        aabb get_bounds() const { return m_bvh.get_bounds(); }
+        size_t get_triangle_count() const { return m_triangles.size(); }
+
+    private:
+        struct triangle {
+            float vertex[3];
+            float edge1[3], edge2[3];
+        };
+
+        bvh m_bvh;
+        std::vector<triangle> m_triangles;
+
+        uint32_t m_material = 0;
+
+        bool intersect_triangle(uint32_t index, const ray& current_ray, hit& closest) const;
+    };
+
+}
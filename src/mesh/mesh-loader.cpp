@@ -0,0 +1,825 @@
+#include "mesh-loader.h"
+#include "mapped-file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace raycaster {
+
+    // ------------------------------------ HELPERS ------------------------------------
+
+    namespace {
+
+        // Chunks smaller than this aren't worth a separate task
+        static constexpr size_t MIN_CHUNK_SIZE = 1 << 16;
+
+        // Splits text into about /count/ chunks, each ending right after a newline
+        std::vector<std::string_view> split_lines(std::string_view text, size_t count) {
+            count = std::max<size_t>(1, std::min(count, text.size() / MIN_CHUNK_SIZE));
+
+            std::vector<std::string_view> chunks;
+            chunks.reserve(count);
+
+            size_t begin = 0;
+            for (size_t i = 1; i <= count && begin < text.size(); ++ i) {
+                size_t end = text.size();
+
+                if (i != count) {
+                    // Move chunk's end right after the next newline
+                    size_t newline = text.find('\n', std::max(begin, text.size() / count * i));
+                    end = newline == std::string_view::npos? text.size() : newline + 1;
+                }
+
+                chunks.push_back(text.substr(begin, end - begin));
+                begin = end;
+            }
+
+            return chunks;
+        }
+
+        // Cursor over one line of text, all parsers work on top of it
+        class line_reader {
+        public:
+            line_reader(const char* begin, const char* end)
+                : m_current(begin), m_end(end) {}
+
+            void skip_spaces() {
+                while (m_current < m_end && (*m_current == ' ' || *m_current == '\t' || *m_current == '\r'))
+                    ++ m_current;
+            }
+
+            bool at_end() {
+                skip_spaces();
+                return m_current == m_end;
+            }
+
+            char peek() const { return m_current < m_end? *m_current : '\0'; }
+            void advance() { ++ m_current; }
+
+            // Skip everything up to the next whitespace
+            void skip_word() {
+                while (m_current < m_end && *m_current != ' ' && *m_current != '\t' && *m_current != '\r')
+                    ++ m_current;
+            }
+
+            template <typename number_type>
+            bool read(number_type& value) {
+                skip_spaces();
+                if (m_current < m_end && *m_current == '+')
+                    ++ m_current; // from_chars doesn't accept explicit plus
+
+                auto [end, error] = std::from_chars(m_current, m_end, value);
+                if (error != std::errc())
+                    return false;
+
+                m_current = end;
+                return true;
+            }
+
+        private:
+            const char* m_current;
+            const char* m_end;
+        };
+
+        // Calls callback(line_reader) for every line of the chunk
+        template <typename callback_type>
+        void for_each_line(std::string_view chunk, callback_type&& callback) {
+            const char* current = chunk.data();
+            const char* end = chunk.data() + chunk.size();
+
+            while (current < end) {
+                const char* newline = static_cast<const char*>(
+                    std::memchr(current, '\n', (size_t) (end - current)));
+
+                const char* line_end = newline == nullptr? end : newline;
+
+                line_reader line(current, line_end);
+                callback(line);
+
+                current = line_end + 1;
+            }
+        }
+
+        void add_fan(std::vector<uint32_t>& indices, const std::vector<uint32_t>& polygon) {
+            for (size_t i = 1; i + 1 < polygon.size(); ++ i)
+                indices.insert(indices.end(), { polygon[0], polygon[i], polygon[i + 1] });
+        }
+
+        // Concatenates per-chunk vectors into /result/ in chunk order, in parallel,
+        // /filler/ is only needed because not every type is default constructible
+        template <typename value_type, typename chunk_type, typename getter_type>
+        void concatenate(std::vector<value_type>& result, std::vector<chunk_type>& chunks,
+                         getter_type&& get, const value_type& filler, gl::thread_pool& pool) {
+            std::vector<size_t> offsets(chunks.size() + 1, 0);
+            for (size_t i = 0; i < chunks.size(); ++ i)
+                offsets[i + 1] = offsets[i] + get(chunks[i]).size();
+
+            result.resize(offsets.back(), filler);
+            pool.run(chunks.size(), [&](size_t i) {
+                std::copy(get(chunks[i]).begin(), get(chunks[i]).end(), result.begin() + (long) offsets[i]);
+            });
+        }
+
+    }
+
+    bool has_extension(const std::string& filename, std::string_view extension) {
+        if (filename.size() < extension.size())
+            return false;
+
+        return std::equal(extension.begin(), extension.end(),
+                          filename.end() - (long) extension.size(), [](char lhs, char rhs) {
+                              return lhs == std::tolower((unsigned char) rhs);
+                          });
+    }
+
+    triangle_mesh load_mesh(const std::string& filename, gl::thread_pool& pool) {
+        if (has_extension(filename, ".obj"))
+            return load_obj(filename, pool);
+
+        if (has_extension(filename, ".ply"))
+            return load_ply(filename, pool);
+
+        throw std::runtime_error("Unknown mesh format: '" + filename + "'");
+    }
+
+    // -------------------------------------- OBJ --------------------------------------
+
+    namespace {
+
+        struct obj_chunk {
+            std::vector<math::vec3> positions;
+
+            // 0-based absolute indices, except for those listed in /relative/,
+            // which are indices into chunk's own positions (possibly negative),
+            // since OBJ's negative indices depend on vertices read before
+            std::vector<int64_t> indices;
+            std::vector<size_t> relative;
+
+            bool is_valid = true;
+        };
+
+        void parse_obj_chunk(std::string_view text, obj_chunk& chunk) {
+            std::vector<int64_t> polygon;
+
+            for_each_line(text, [&](line_reader& line) {
+                line.skip_spaces();
+
+                char type = line.peek();
+                if (type != 'v' && type != 'f')
+                    return; // Comments, normals, groups, materials...
+
+                line.advance();
+                if (line.peek() != ' ' && line.peek() != '\t')
+                    return; // "vn", "vt" and others
+
+                if (type == 'v') {
+                    float x = 0.0f, y = 0.0f, z = 0.0f;
+                    if (!line.read(x) || !line.read(y) || !line.read(z))
+                        chunk.is_valid = false;
+
+                    chunk.positions.push_back({ x, y, z });
+                    return;
+                }
+
+                polygon.clear();
+                while (!line.at_end()) {
+                    int64_t index;
+                    if (!line.read(index) || index == 0) {
+                        chunk.is_valid = false;
+                        return;
+                    }
+
+                    polygon.push_back(index);
+                    line.skip_word(); // Texture and normal indices: "/vt/vn"
+                }
+
+                for (size_t i = 1; i + 1 < polygon.size(); ++ i)
+                    for (int64_t index: { polygon[0], polygon[i], polygon[i + 1] }) {
+                        if (index < 0) {
+                            chunk.relative.push_back(chunk.indices.size());
+                            chunk.indices.push_back((int64_t) chunk.positions.size() + index);
+                        } else
+                            chunk.indices.push_back(index - 1);
+                    }
+            });
+        }
+
+    }
+
+    triangle_mesh load_obj(const std::string& filename, gl::thread_pool& pool) {
+        mapped_file file(filename);
+
+        std::vector<std::string_view> texts = split_lines(file.view(), pool.get_thread_count() * 4);
+        std::vector<obj_chunk> chunks(texts.size());
+
+        pool.run(texts.size(), [&](size_t i) { parse_obj_chunk(texts[i], chunks[i]); });
+
+        // ==> Resolve relative indices now that every chunk's base is known:
+
+        int64_t base = 0;
+        for (obj_chunk& chunk: chunks) {
+            if (!chunk.is_valid)
+                throw std::runtime_error("Malformed OBJ file: '" + filename + "'");
+
+            for (size_t position: chunk.relative)
+                chunk.indices[position] += base;
+
+            base += (int64_t) chunk.positions.size();
+        }
+
+        // ==> Merge chunks:
+
+        triangle_mesh mesh;
+        concatenate(mesh.positions, chunks, [](obj_chunk& chunk) -> auto& { return chunk.positions; },
+                    math::vec3 { 0.0f, 0.0f, 0.0f }, pool);
+
+        std::vector<int64_t> indices;
+        concatenate(indices, chunks, [](obj_chunk& chunk) -> auto& { return chunk.indices; },
+                    int64_t { 0 }, pool);
+
+        const int64_t vertex_count = (int64_t) mesh.positions.size();
+
+        mesh.indices.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); ++ i) {
+            if (indices[i] < 0 || indices[i] >= vertex_count)
+                throw std::runtime_error("Vertex index out of range in OBJ file: '" + filename + "'");
+
+            mesh.indices[i] = (uint32_t) indices[i];
+        }
+
+        return mesh;
+    }
+
+    // -------------------------------------- PLY --------------------------------------
+
+    namespace {
+
+        enum class ply_format { ASCII, BINARY_LITTLE_ENDIAN, BINARY_BIG_ENDIAN };
+
+        enum class ply_type { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+        size_t get_type_size(ply_type type) {
+            switch (type) {
+            case ply_type::INT8:    case ply_type::UINT8:   return 1;
+            case ply_type::INT16:   case ply_type::UINT16:  return 2;
+            case ply_type::INT32:   case ply_type::UINT32:
+            case ply_type::FLOAT32:                         return 4;
+            case ply_type::FLOAT64:                         return 8;
+            }
+
+            return 0;
+        }
+
+        ply_type parse_type(std::string_view name) {
+            static const std::pair<std::string_view, ply_type> names[] = {
+                { "char",  ply_type::INT8    }, { "int8",    ply_type::INT8    },
+                { "uchar", ply_type::UINT8   }, { "uint8",   ply_type::UINT8   },
+                { "short", ply_type::INT16   }, { "int16",   ply_type::INT16   },
+                { "ushort",ply_type::UINT16  }, { "uint16",  ply_type::UINT16  },
+                { "int",   ply_type::INT32   }, { "int32",   ply_type::INT32   },
+                { "uint",  ply_type::UINT32  }, { "uint32",  ply_type::UINT32  },
+                { "float", ply_type::FLOAT32 }, { "float32", ply_type::FLOAT32 },
+                { "double",ply_type::FLOAT64 }, { "float64", ply_type::FLOAT64 },
+            };
+
+            for (auto [type_name, type]: names)
+                if (type_name == name)
+                    return type;
+
+            throw std::runtime_error("Unknown PLY property type: '" + std::string(name) + "'");
+        }
+
+        struct ply_property {
+            std::string name;
+            ply_type type;
+
+            bool is_list = false;
+            ply_type count_type = ply_type::UINT8;
+        };
+
+        struct ply_element {
+            std::string name;
+            size_t count = 0;
+
+            std::vector<ply_property> properties;
+
+            // Size of one row in binary formats, 0 if rows have lists
+            size_t get_row_size() const {
+                size_t size = 0;
+                for (const ply_property& property: properties) {
+                    if (property.is_list)
+                        return 0;
+
+                    size += get_type_size(property.type);
+                }
+
+                return size;
+            }
+
+            int find_property(std::string_view property_name) const {
+                for (size_t i = 0; i < properties.size(); ++ i)
+                    if (properties[i].name == property_name)
+                        return (int) i;
+
+                return -1;
+            }
+        };
+
+        struct ply_header {
+            ply_format format = ply_format::ASCII;
+            std::vector<ply_element> elements;
+
+            size_t body_offset = 0;
+        };
+
+        ply_header parse_ply_header(std::string_view text, const std::string& filename) {
+            auto fail = [&](const std::string& reason) {
+                return std::runtime_error("Invalid PLY header in '" + filename + "': " + reason);
+            };
+
+            ply_header header;
+            bool is_first_line = true, has_format = false;
+
+            size_t position = 0;
+            while (true) {
+                size_t newline = text.find('\n', position);
+                if (newline == std::string_view::npos)
+                    throw fail("no end_header");
+
+                std::string_view line = text.substr(position, newline - position);
+                position = newline + 1;
+
+                if (!line.empty() && line.back() == '\r')
+                    line.remove_suffix(1);
+
+                // Split line into words:
+                std::vector<std::string_view> words;
+                for (size_t begin = 0; begin < line.size(); ) {
+                    size_t end = line.find(' ', begin);
+                    if (end == std::string_view::npos)
+                        end = line.size();
+
+                    if (end > begin)
+                        words.push_back(line.substr(begin, end - begin));
+
+                    begin = end + 1;
+                }
+
+                if (is_first_line) {
+                    if (line != "ply")
+                        throw fail("missing magic");
+
+                    is_first_line = false;
+                    continue;
+                }
+
+                if (words.empty() || words[0] == "comment" || words[0] == "obj_info")
+                    continue;
+
+                if (words[0] == "end_header")
+                    break;
+
+                if (words[0] == "format" && words.size() >= 2) {
+                    if      (words[1] == "ascii")                header.format = ply_format::ASCII;
+                    else if (words[1] == "binary_little_endian") header.format = ply_format::BINARY_LITTLE_ENDIAN;
+                    else if (words[1] == "binary_big_endian")    header.format = ply_format::BINARY_BIG_ENDIAN;
+                    else
+                        throw fail("unknown format");
+
+                    has_format = true;
+                } else if (words[0] == "element" && words.size() == 3) {
+                    ply_element element;
+                    element.name = words[1];
+
+                    auto [end, error] = std::from_chars(words[2].data(), words[2].data() + words[2].size(), element.count);
+                    if (error != std::errc())
+                        throw fail("invalid element count");
+
+                    header.elements.push_back(element);
+                } else if (words[0] == "property" && !header.elements.empty()) {
+                    ply_property property;
+
+                    if (words.size() == 5 && words[1] == "list") {
+                        property.is_list = true;
+                        property.count_type = parse_type(words[2]);
+                        property.type = parse_type(words[3]);
+                        property.name = words[4];
+                    } else if (words.size() == 3) {
+                        property.type = parse_type(words[1]);
+                        property.name = words[2];
+                    } else
+                        throw fail("invalid property");
+
+                    header.elements.back().properties.push_back(property);
+                } else
+                    throw fail("unexpected line '" + std::string(line) + "'");
+            }
+
+            if (!has_format)
+                throw fail("no format");
+
+            header.body_offset = position;
+            return header;
+        }
+
+        double read_binary(const char* data, ply_type type, bool swap) {
+            char bytes[8];
+            size_t size = get_type_size(type);
+
+            std::memcpy(bytes, data, size);
+            if (swap)
+                std::reverse(bytes, bytes + size);
+
+            auto as = [&]<typename value_type>(value_type value) {
+                std::memcpy(&value, bytes, sizeof(value));
+                return (double) value;
+            };
+
+            switch (type) {
+            case ply_type::INT8:    return as(int8_t   {});
+            case ply_type::UINT8:   return as(uint8_t  {});
+            case ply_type::INT16:   return as(int16_t  {});
+            case ply_type::UINT16:  return as(uint16_t {});
+            case ply_type::INT32:   return as(int32_t  {});
+            case ply_type::UINT32:  return as(uint32_t {});
+            case ply_type::FLOAT32: return as(float    {});
+            case ply_type::FLOAT64: return as(double   {});
+            }
+
+            return 0.0;
+        }
+
+        struct ply_layout {
+            size_t vertex_element, face_element;
+            int x, y, z, vertex_indices;
+        };
+
+        ply_layout find_ply_layout(const ply_header& header, const std::string& filename) {
+            ply_layout layout = { SIZE_MAX, SIZE_MAX, -1, -1, -1, -1 };
+
+            for (size_t i = 0; i < header.elements.size(); ++ i) {
+                const ply_element& element = header.elements[i];
+
+                if (element.name == "vertex") {
+                    layout.vertex_element = i;
+
+                    layout.x = element.find_property("x");
+                    layout.y = element.find_property("y");
+                    layout.z = element.find_property("z");
+                } else if (element.name == "face") {
+                    layout.face_element = i;
+
+                    layout.vertex_indices = element.find_property("vertex_indices");
+                    if (layout.vertex_indices == -1)
+                        layout.vertex_indices = element.find_property("vertex_index");
+                }
+            }
+
+            if (layout.vertex_element == SIZE_MAX || layout.x == -1 || layout.y == -1 || layout.z == -1)
+                throw std::runtime_error("PLY file has no vertex positions: '" + filename + "'");
+
+            if (layout.face_element != SIZE_MAX && (layout.vertex_indices == -1 ||
+                !header.elements[layout.face_element].properties[(size_t) layout.vertex_indices].is_list))
+                throw std::runtime_error("PLY file has no face indices: '" + filename + "'");
+
+            return layout;
+        }
+
+        // ==> ASCII body, every line is one row of some element:
+
+        triangle_mesh load_ascii_ply(std::string_view body, const ply_header& header,
+                                     const ply_layout& layout, const std::string& filename,
+                                     gl::thread_pool& pool) {
+            std::vector<std::string_view> texts = split_lines(body, pool.get_thread_count() * 4);
+
+            // Count lines of each chunk in parallel, to know from which row each starts
+            std::vector<size_t> first_lines(texts.size() + 1, 0);
+            pool.run(texts.size(), [&](size_t i) {
+                first_lines[i + 1] = (size_t) std::count(texts[i].begin(), texts[i].end(), '\n');
+            });
+
+            for (size_t i = 0; i < texts.size(); ++ i)
+                first_lines[i + 1] += first_lines[i];
+
+            // Lines where every element's rows begin
+            std::vector<size_t> element_lines(header.elements.size() + 1, 0);
+            for (size_t i = 0; i < header.elements.size(); ++ i)
+                element_lines[i + 1] = element_lines[i] + header.elements[i].count;
+
+            const ply_element& vertex = header.elements[layout.vertex_element];
+
+            triangle_mesh mesh;
+            mesh.positions.resize(vertex.count, math::vec3 { 0.0f, 0.0f, 0.0f });
+
+            struct face_chunk {
+                std::vector<uint32_t> indices;
+                bool is_valid = true;
+
+                // Rows of every element seen in chunk, last one counts rows past all elements
+                std::vector<size_t> row_counts;
+            };
+
+            std::vector<face_chunk> faces(texts.size());
+
+            pool.run(texts.size(), [&](size_t i) {
+                std::vector<uint32_t> polygon;
+                size_t line_index = first_lines[i];
+
+                // Values of the current row, only positions and indices matter
+                std::vector<double> row;
+
+                std::vector<size_t>& row_counts = faces[i].row_counts;
+                row_counts.resize(header.elements.size() + 1, 0);
+
+                for_each_line(texts[i], [&](line_reader& line) {
+                    size_t current_line = line_index ++;
+
+                    auto element = std::upper_bound(element_lines.begin(), element_lines.end(), current_line);
+                    size_t element_index = (size_t) (element - element_lines.begin()) - 1;
+
+                    // Blank lines after the last row are fine, anything else there isn't
+                    if (element_index < header.elements.size() || !line.at_end())
+                        ++ row_counts[element_index];
+
+                    if (element_index == layout.vertex_element) {
+                        row.clear();
+                        for (size_t property = 0; property < vertex.properties.size(); ++ property) {
+                            double value;
+                            if (!line.read(value)) {
+                                faces[i].is_valid = false;
+                                return;
+                            }
+
+                            row.push_back(value);
+                        }
+
+                        mesh.positions[current_line - element_lines[element_index]] = {
+                            (float) row[(size_t) layout.x],
+                            (float) row[(size_t) layout.y],
+                            (float) row[(size_t) layout.z]
+                        };
+                    } else if (element_index == layout.face_element) {
+                        const ply_element& face = header.elements[element_index];
+
+                        for (size_t property = 0; property < face.properties.size(); ++ property) {
+                            size_t count = 1;
+                            if (face.properties[property].is_list && !line.read(count)) {
+                                faces[i].is_valid = false;
+                                return;
+                            }
+
+                            polygon.clear();
+                            for (size_t k = 0; k < count; ++ k) {
+                                double value;
+                                if (!line.read(value)) {
+                                    faces[i].is_valid = false;
+                                    return;
+                                }
+
+                                polygon.push_back((uint32_t) value);
+                            }
+
+                            if ((int) property == layout.vertex_indices)
+                                add_fan(faces[i].indices, polygon);
+                        }
+                    }
+                });
+            });
+
+            std::vector<size_t> row_counts(header.elements.size() + 1, 0);
+            for (const face_chunk& chunk: faces) {
+                if (!chunk.is_valid)
+                    throw std::runtime_error("Malformed PLY body: '" + filename + "'");
+
+                for (size_t i = 0; i < row_counts.size(); ++ i)
+                    row_counts[i] += chunk.row_counts[i];
+            }
+
+            // Short body would otherwise leave rows missing without a word
+            for (size_t i = 0; i < header.elements.size(); ++ i)
+                if (row_counts[i] != header.elements[i].count)
+                    throw std::runtime_error("PLY body has " + std::to_string(row_counts[i]) + " rows of '" +
+                                             header.elements[i].name + "', header declares " +
+                                             std::to_string(header.elements[i].count) + ": '" + filename + "'");
+
+            if (row_counts.back() != 0)
+                throw std::runtime_error("PLY body has rows past declared elements: '" + filename + "'");
+
+            concatenate(mesh.indices, faces, [](face_chunk& chunk) -> auto& { return chunk.indices; },
+                        uint32_t { 0 }, pool);
+            return mesh;
+        }
+
+        // ==> Binary body, rows of elements without lists have fixed size:
+
+        triangle_mesh load_binary_ply(std::string_view body, const ply_header& header,
+                                      const ply_layout& layout, const std::string& filename,
+                                      gl::thread_pool& pool) {
+            const bool is_little_endian = header.format == ply_format::BINARY_LITTLE_ENDIAN;
+            const bool swap = is_little_endian != (std::endian::native == std::endian::little);
+
+            auto fail = [&]() { return std::runtime_error("Truncated PLY body: '" + filename + "'"); };
+
+            // Size of variable-sized row starting at /data/
+            auto get_row_size = [&](const ply_element& element, const char* data) {
+                size_t size = 0;
+                for (const ply_property& property: element.properties) {
+                    if (property.is_list) {
+                        if (data + size + get_type_size(property.count_type) > body.data() + body.size())
+                            throw fail();
+
+                        size_t count = (size_t) read_binary(data + size, property.count_type, swap);
+                        size += get_type_size(property.count_type) + count * get_type_size(property.type);
+                    } else
+                        size += get_type_size(property.type);
+                }
+
+                return size;
+            };
+
+            triangle_mesh mesh;
+
+            const char* current = body.data();
+            const char* end = body.data() + body.size();
+
+            // Reads faces as fixed-size rows, which works only if every face has the same number of
+            // vertices (typically all are triangles) and no other lists, returns size of faces read
+            // or 0 if they aren't like that
+            auto read_uniform_faces = [&](const ply_element& element, const char* data,
+                                          std::vector<uint32_t>& indices) {
+                const ply_property& list = element.properties[(size_t) layout.vertex_indices];
+
+                // Offset of the list inside of the row and size of everything else
+                size_t list_offset = 0, fixed_size = 0;
+                for (size_t i = 0; i < element.properties.size(); ++ i) {
+                    if ((int) i == layout.vertex_indices)
+                        list_offset = fixed_size;
+                    else if (element.properties[i].is_list)
+                        return size_t { 0 };
+                    else
+                        fixed_size += get_type_size(element.properties[i].type);
+                }
+
+                const size_t value_offset = list_offset + get_type_size(list.count_type);
+                if (element.count == 0 || value_offset > (size_t) (end - data))
+                    return size_t { 0 };
+
+                // Rows are as long as the first one
+                const size_t vertex_count = (size_t) read_binary(data + list_offset, list.count_type, swap);
+                const size_t value_size = get_type_size(list.type);
+                const size_t row_size = fixed_size + get_type_size(list.count_type) + vertex_count * value_size;
+
+                if ((size_t) (end - data) / row_size < element.count)
+                    return size_t { 0 };
+
+                const size_t triangle_count = vertex_count < 3? 0 : vertex_count - 2;
+                indices.resize(element.count * triangle_count * 3);
+
+                std::atomic<bool> is_uniform = true;
+                gl::parallel_for(0, element.count, MIN_CHUNK_SIZE / 16, [&](size_t from, size_t to) {
+                    for (size_t i = from; i < to; ++ i) {
+                        const char* row = data + i * row_size;
+                        if ((size_t) read_binary(row + list_offset, list.count_type, swap) != vertex_count) {
+                            is_uniform.store(false, std::memory_order_relaxed);
+                            return;
+                        }
+
+                        auto read_index = [&](size_t k) {
+                            return (uint32_t) read_binary(row + value_offset + k * value_size, list.type, swap);
+                        };
+
+                        // Same fan as add_fan()
+                        uint32_t* triangle = indices.data() + i * triangle_count * 3;
+                        for (size_t k = 1; k + 1 < vertex_count; ++ k, triangle += 3) {
+                            triangle[0] = read_index(0);
+                            triangle[1] = read_index(k);
+                            triangle[2] = read_index(k + 1);
+                        }
+                    }
+                }, pool);
+
+                return is_uniform.load()? row_size * element.count : 0;
+            };
+
+            for (size_t element_index = 0; element_index < header.elements.size(); ++ element_index) {
+                const ply_element& element = header.elements[element_index];
+                const size_t row_size = element.get_row_size();
+
+                if (element_index == layout.vertex_element && row_size != 0) {
+                    if ((size_t) (end - current) < row_size * element.count)
+                        throw fail();
+
+                    // Offsets of coordinates inside of the row
+                    size_t offsets[3] = {}, offset = 0;
+                    for (size_t i = 0; i < element.properties.size(); ++ i) {
+                        if ((int) i == layout.x) offsets[0] = offset;
+                        if ((int) i == layout.y) offsets[1] = offset;
+                        if ((int) i == layout.z) offsets[2] = offset;
+
+                        offset += get_type_size(element.properties[i].type);
+                    }
+
+                    const ply_type types[3] = {
+                        element.properties[(size_t) layout.x].type,
+                        element.properties[(size_t) layout.y].type,
+                        element.properties[(size_t) layout.z].type
+                    };
+
+                    // Rows have fixed size, so every vertex can be read independently
+                    mesh.positions.resize(element.count, math::vec3 { 0.0f, 0.0f, 0.0f });
+                    gl::parallel_for(0, element.count, MIN_CHUNK_SIZE / 16, [&](size_t from, size_t to) {
+                        for (size_t i = from; i < to; ++ i) {
+                            const char* row = current + i * row_size;
+
+                            mesh.positions[i] = { (float) read_binary(row + offsets[0], types[0], swap),
+                                                  (float) read_binary(row + offsets[1], types[1], swap),
+                                                  (float) read_binary(row + offsets[2], types[2], swap) };
+                        }
+                    }, pool);
+
+                    current += row_size * element.count;
+                } else if (element_index == layout.face_element) {
+                    // Faces are usually all triangles, then they are read in parallel like vertices
+                    if (size_t faces_size = read_uniform_faces(element, current, mesh.indices); faces_size != 0) {
+                        current += faces_size;
+                        continue;
+                    }
+
+                    // Otherwise lists make rows variable-sized, faces have to be walked sequentially
+                    mesh.indices.clear();
+                    std::vector<uint32_t> polygon;
+
+                    for (size_t row = 0; row < element.count; ++ row) {
+                        for (size_t property_index = 0; property_index < element.properties.size(); ++ property_index) {
+                            const ply_property& property = element.properties[property_index];
+
+                            size_t count = 1;
+                            if (property.is_list) {
+                                if (current + get_type_size(property.count_type) > end)
+                                    throw fail();
+
+                                count = (size_t) read_binary(current, property.count_type, swap);
+                                current += get_type_size(property.count_type);
+                            }
+
+                            const size_t value_size = get_type_size(property.type);
+                            if (current + count * value_size > end)
+                                throw fail();
+
+                            if ((int) property_index == layout.vertex_indices) {
+                                polygon.clear();
+                                for (size_t k = 0; k < count; ++ k)
+                                    polygon.push_back((uint32_t) read_binary(current + k * value_size, property.type, swap));
+
+                                add_fan(mesh.indices, polygon);
+                            }
+
+                            current += count * value_size;
+                        }
+                    }
+                } else if (row_size != 0) {
+                    if ((size_t) (end - current) < row_size * element.count)
+                        throw fail();
+
+                    current += row_size * element.count;
+                } else
+                    for (size_t row = 0; row < element.count; ++ row)
+                        current += get_row_size(element, current);
+            }
+
+            if (mesh.positions.size() != header.elements[layout.vertex_element].count)
+                throw std::runtime_error("PLY vertices have list properties: '" + filename + "'");
+
+            return mesh;
+        }
+
+    }
+
+    triangle_mesh load_ply(const std::string& filename, gl::thread_pool& pool) {
+        mapped_file file(filename);
+
+        const ply_header header = parse_ply_header(file.view(), filename);
+        const ply_layout layout = find_ply_layout(header, filename);
+
+        std::string_view body = file.view().substr(header.body_offset);
+
+        triangle_mesh mesh = header.format == ply_format::ASCII?
+            load_ascii_ply (body, header, layout, filename, pool) :
+            load_binary_ply(body, header, layout, filename, pool);
+
+        for (uint32_t index: mesh.indices)
+            if (index >= mesh.positions.size())
+                throw std::runtime_error("Vertex index out of range in PLY file: '" + filename + "'");
+
+        return mesh;
+    }
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "thread-pool.h"
+#include "triangle-mesh.h"
+
+#include <string>
+#include <string_view>
+
+namespace raycaster {
+
+    // Whether filename ends with /extension/ (given in lower case), in any case
+    bool has_extension(const std::string& filename, std::string_view extension);
+
+    // Loads mesh picking format by file's extension (".obj" or ".ply"),
+    // polygons are triangulated as fans. Files are memory mapped and
+    // parsed in parallel chunks, so loading is mostly bound by I/O.
+    triangle_mesh load_mesh(const std::string& filename,
+                            gl::thread_pool& pool = gl::thread_pool::global());
+
+    // Wavefront OBJ, only positions ("v") and faces ("f") are read
+    triangle_mesh load_obj(const std::string& filename,
+                           gl::thread_pool& pool = gl::thread_pool::global());
+
+    // Stanford PLY in ascii, binary_little_endian or binary_big_endian
+    // format, with "vertex" (x, y, z) and "face" (vertex_indices) elements
+    triangle_mesh load_ply(const std::string& filename,
+                           gl::thread_pool& pool = gl::thread_pool::global());
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "vec.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace raycaster {
+
+    // Indexed triangle list, triangle i is made of
+    // positions[indices[3 * i]], ..., positions[indices[3 * i + 2]]
+    struct triangle_mesh {
+        std::vector<math::vec3> positions;
+        std::vector<uint32_t> indices;
+
+        size_t get_triangle_count() const { return indices.size() / 3; }
+    };
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "vec.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace raycaster {
+
+    // Axis aligned bounding box, empty one is inverted (min > max), so
+    // that extending it with anything yields that thing's bounds
+    struct aabb {
+        math::vec3 min {  std::numeric_limits<float>::infinity(),
+                          std::numeric_limits<float>::infinity(),
+                          std::numeric_limits<float>::infinity() };
+
+        math::vec3 max { -std::numeric_limits<float>::infinity(),
+                         -std::numeric_limits<float>::infinity(),
+                         -std::numeric_limits<float>::infinity() };
+
+        aabb() = default;
+        aabb(math::vec3 new_min, math::vec3 new_max)
+            : min(new_min), max(new_max) {}
+
+        bool is_empty() const {
+            return min.x() > max.x() || min.y() > max.y() || min.z() > max.z();
+        }
+
+        aabb& extend(const math::vec3 point) {
+            for (int i = 0; i < 3; ++ i) {
+                min[i] = std::min(std::as_const(min)[i], point[i]);
+                max[i] = std::max(std::as_const(max)[i], point[i]);
+            }
+
+            return *this;
+        }
+
+        aabb& extend(const aabb& other) {
+            for (int i = 0; i < 3; ++ i) {
+                min[i] = std::min(std::as_const(min)[i], other.min[i]);
+                max[i] = std::max(std::as_const(max)[i], other.max[i]);
+            }
+
+            return *this;
+        }
+
+        math::vec3 extent() const { return max - min; }
+        math::vec3 center() const { return (min + max) * 0.5f; }
+
+        float surface_area() const {
+            if (is_empty())
+                return 0.0f;
+
+            const math::vec3 size = extent();
+            return 2.0f * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+        }
+
+        // Largest axis of the box: 0 for x, 1 for y and 2 for z
+        int largest_axis() const {
+            const math::vec3 size = extent();
+
+            if (size.x() >= size.y() && size.x() >= size.z())
+                return 0;
+
+            return size.y() >= size.z()? 1 : 2;
+        }
+    };
+
+}
@@ -0,0 +1,535 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace raycaster {
+
+    // ---------------------------------- NODE BOUNDS ----------------------------------
+
+    aabb bvh::node::get_child_bounds(int slot) const {
+        return { { bounds[0][0][slot], bounds[0][1][slot], bounds[0][2][slot] },
+                 { bounds[1][0][slot], bounds[1][1][slot], bounds[1][2][slot] } };
+    }
+
+    void bvh::node::set_child_bounds(int slot, const aabb& child_bounds) {
+        for (int axis = 0; axis < 3; ++ axis) {
+            bounds[0][axis][slot] = child_bounds.min[axis];
+            bounds[1][axis][slot] = child_bounds.max[axis];
+        }
+    }
+
+    // --------------------------------- BINARY BUILDER --------------------------------
+
+    namespace {
+
+        // Plain box, cheaper than aabb in builder's hot loops (no vec proxies)
+        struct box {
+            float min[3] = {  std::numeric_limits<float>::infinity(),
+                              std::numeric_limits<float>::infinity(),
+                              std::numeric_limits<float>::infinity() };
+
+            float max[3] = { -std::numeric_limits<float>::infinity(),
+                             -std::numeric_limits<float>::infinity(),
+                             -std::numeric_limits<float>::infinity() };
+
+            void extend(const box& other) {
+                for (int axis = 0; axis < 3; ++ axis) {
+                    min[axis] = std::min(min[axis], other.min[axis]);
+                    max[axis] = std::max(max[axis], other.max[axis]);
+                }
+            }
+
+            void extend(const float point[3]) {
+                for (int axis = 0; axis < 3; ++ axis) {
+                    min[axis] = std::min(min[axis], point[axis]);
+                    max[axis] = std::max(max[axis], point[axis]);
+                }
+            }
+
+            float surface_area() const {
+                float size[3] = { max[0] - min[0], max[1] - min[1], max[2] - min[2] };
+                if (size[0] < 0.0f || size[1] < 0.0f || size[2] < 0.0f)
+                    return 0.0f;
+
+                return 2.0f * (size[0] * size[1] + size[1] * size[2] + size[2] * size[0]);
+            }
+
+            aabb to_aabb() const {
+                return { { min[0], min[1], min[2] }, { max[0], max[1], max[2] } };
+            }
+        };
+
+        struct binary_node {
+            box bounds;
+
+            uint32_t left = 0, right = 0;   // Children of inner node
+            uint32_t first = 0, count = 0;  // Primitives of leaf (count > 0)
+
+            bool is_leaf() const { return count > 0; }
+        };
+
+        // Builder partitions these records themselves rather than indices
+        // to them, so that every level reads primitives sequentially
+        struct primitive_info {
+            box bounds;
+            float centroid[3];
+
+            uint32_t index;
+        };
+
+        static constexpr int BIN_COUNT = 16;
+
+        struct bin {
+            box bounds;
+            uint32_t count = 0;
+        };
+
+        struct binning {
+            bin bins[3][BIN_COUNT];
+
+            void merge(const binning& other) {
+                for (int axis = 0; axis < 3; ++ axis)
+                    for (int i = 0; i < BIN_COUNT; ++ i) {
+                        bins[axis][i].bounds.extend(other.bins[axis][i].bounds);
+                        bins[axis][i].count += other.bins[axis][i].count;
+                    }
+            }
+        };
+
+        // Leaves can't be bigger, no matter what SAH thinks about it
+        static constexpr uint32_t MAX_LEAF_SIZE = 8;
+
+        // Below that depth splits are plain median splits, which bounds
+        // tree's depth (and so traversal stack) for adversarial inputs
+        static constexpr int MAX_SAH_DEPTH = 32;
+
+        // Nodes with more primitives are binned by all threads together
+        static constexpr size_t PARALLEL_BINNING_THRESHOLD = 1 << 16;
+
+        class binary_builder {
+        public:
+            binary_builder(std::vector<primitive_info>& primitives)
+                : m_primitives(primitives) {}
+
+            // Root of built subtree is always nodes[0] after the call, safe
+            // to call concurrently for non-overlapping ranges of primitives
+            void build(uint32_t first, uint32_t count, int depth,
+                       std::vector<binary_node>& nodes) const {
+                nodes.clear();
+                nodes.emplace_back();
+
+                build_node(0, first, count, depth, nodes, nullptr, nullptr);
+            }
+
+            // Builds top of the tree, deferring subtrees smaller than
+            // /task_size/ to /tasks/, their nodes are left as placeholders
+            struct task { uint32_t node, first, count; int depth; };
+
+            void build_top(uint32_t task_size, std::vector<binary_node>& nodes,
+                           std::vector<task>& tasks, gl::thread_pool& pool) {
+                nodes.clear();
+                nodes.emplace_back();
+
+                m_task_size = task_size;
+                build_node(0, 0, (uint32_t) m_primitives.size(), 0, nodes, &tasks, &pool);
+            }
+
+        private:
+            std::vector<primitive_info>& m_primitives;
+
+            uint32_t m_task_size = 0;
+
+            void bin_range(uint32_t first, uint32_t count, const box& centroid_bounds,
+                           const float scale[3], binning& result) const {
+                for (uint32_t i = first; i < first + count; ++ i) {
+                    const primitive_info& primitive = m_primitives[i];
+
+                    for (int axis = 0; axis < 3; ++ axis) {
+                        int index = (int) ((primitive.centroid[axis] - centroid_bounds.min[axis]) * scale[axis]);
+                        index = std::clamp(index, 0, BIN_COUNT - 1);
+
+                        result.bins[axis][index].bounds.extend(primitive.bounds);
+                        result.bins[axis][index].count ++;
+                    }
+                }
+            }
+
+            void build_node(uint32_t index, uint32_t first, uint32_t count, int depth,
+                            std::vector<binary_node>& nodes, std::vector<task>* tasks,
+                            gl::thread_pool* pool) const {
+
+                box bounds, centroid_bounds;
+                for (uint32_t i = first; i < first + count; ++ i) {
+                    bounds.extend(m_primitives[i].bounds);
+                    centroid_bounds.extend(m_primitives[i].centroid);
+                }
+
+                nodes[index].bounds = bounds;
+
+                if (tasks != nullptr && count <= m_task_size) {
+                    tasks->push_back({ index, first, count, depth });
+                    return;
+                }
+
+                auto make_leaf = [&]() {
+                    nodes[index].first = first;
+                    nodes[index].count = count;
+                };
+
+                if (count <= 2) // Nothing to gain from splitting
+                    return make_leaf();
+
+                // ==> Find best split with binned SAH:
+
+                float scale[3];
+                for (int axis = 0; axis < 3; ++ axis) {
+                    float extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+                    scale[axis] = extent > 0.0f? (float) BIN_COUNT * (1.0f - 1e-5f) / extent : 0.0f;
+                }
+
+                binning bins;
+                if (count >= PARALLEL_BINNING_THRESHOLD && pool != nullptr) {
+                    const size_t chunk_count = pool->get_thread_count() * 4;
+                    const uint32_t chunk_size = (uint32_t) ((count + chunk_count - 1) / chunk_count);
+
+                    std::vector<binning> partial(chunk_count);
+                    pool->run(chunk_count, [&](size_t chunk) {
+                        uint32_t from = first + (uint32_t) chunk * chunk_size;
+                        uint32_t to   = std::min(first + count, from + chunk_size);
+
+                        if (from < to)
+                            bin_range(from, to - from, centroid_bounds, scale, partial[chunk]);
+                    });
+
+                    for (const binning& current: partial)
+                        bins.merge(current);
+                } else
+                    bin_range(first, count, centroid_bounds, scale, bins);
+
+                float best_cost = std::numeric_limits<float>::infinity();
+                int best_axis = -1, best_split = 0;
+
+                for (int axis = 0; axis < 3; ++ axis) {
+                    if (scale[axis] == 0.0f)
+                        continue; // All centroids are in one plane
+
+                    // Sweep from the right, remembering cost of everything right to the split
+                    float right_costs[BIN_COUNT];
+
+                    box right_bounds; uint32_t right_count = 0;
+                    for (int i = BIN_COUNT - 1; i > 0; -- i) {
+                        right_bounds.extend(bins.bins[axis][i].bounds);
+                        right_count += bins.bins[axis][i].count;
+
+                        right_costs[i] = right_bounds.surface_area() * (float) right_count;
+                    }
+
+                    box left_bounds; uint32_t left_count = 0;
+                    for (int i = 0; i < BIN_COUNT - 1; ++ i) {
+                        left_bounds.extend(bins.bins[axis][i].bounds);
+                        left_count += bins.bins[axis][i].count;
+
+                        float cost = left_bounds.surface_area() * (float) left_count + right_costs[i + 1];
+                        if (left_count > 0 && left_count < count && cost < best_cost)
+                            best_cost = cost, best_axis = axis, best_split = i + 1;
+                    }
+                }
+
+                const float area = bounds.surface_area();
+                const float leaf_cost = bvh::INTERSECTION_COST * (float) count;
+
+                best_cost = bvh::TRAVERSAL_COST + bvh::INTERSECTION_COST *
+                    (area > 0.0f? best_cost / area : (float) count);
+
+                if (count <= MAX_LEAF_SIZE && leaf_cost <= best_cost)
+                    return make_leaf();
+
+                // ==> Partition primitives:
+
+                uint32_t middle;
+                if (best_axis != -1 && depth < MAX_SAH_DEPTH) {
+                    auto split = std::partition(m_primitives.begin() + first, m_primitives.begin() + first + count,
+                        [&](const primitive_info& primitive) {
+                            float centroid = primitive.centroid[best_axis];
+                            int bin_index = (int) ((centroid - centroid_bounds.min[best_axis]) * scale[best_axis]);
+
+                            return std::clamp(bin_index, 0, BIN_COUNT - 1) < best_split;
+                        });
+
+                    middle = (uint32_t) (split - m_primitives.begin());
+                } else {
+                    // No usable SAH split, fall back to median along the largest axis
+                    int axis = 0;
+                    for (int i = 1; i < 3; ++ i)
+                        if (centroid_bounds.max[i] - centroid_bounds.min[i] >
+                            centroid_bounds.max[axis] - centroid_bounds.min[axis])
+                            axis = i;
+
+                    middle = first + count / 2;
+                    std::nth_element(m_primitives.begin() + first, m_primitives.begin() + middle,
+                                     m_primitives.begin() + first + count,
+                        [&](const primitive_info& lhs, const primitive_info& rhs) {
+                            return lhs.centroid[axis] < rhs.centroid[axis];
+                        });
+                }
+
+                // Children are placed after everything in parent's subtree is
+                // allocated, that's fine, parent's index is still less than theirs
+                uint32_t left = (uint32_t) nodes.size(), right = left + 1;
+                nodes.emplace_back(), nodes.emplace_back();
+
+                nodes[index].left = left, nodes[index].right = right;
+
+                build_node(left,  first,  middle - first,         depth + 1, nodes, tasks, pool);
+                build_node(right, middle, first + count - middle, depth + 1, nodes, tasks, pool);
+            }
+        };
+
+        // ==> Collapse binary tree into 4-wide one:
+
+        class collapser {
+        public:
+            collapser(const std::vector<binary_node>& binary_nodes,
+                      std::vector<bvh::node, gl::aligned_allocator<bvh::node>>& nodes,
+                      std::vector<uint32_t>& depths)
+                : m_binary_nodes(binary_nodes), m_nodes(nodes), m_depths(depths) {}
+
+            uint32_t collapse(uint32_t binary_index, uint32_t depth = 0) {
+                // Gather up to four children, opening largest inner ones first:
+                uint32_t children[bvh::WIDTH];
+                int child_count = 0;
+
+                const binary_node& root = m_binary_nodes[binary_index];
+                if (root.is_leaf())
+                    children[child_count ++] = binary_index;
+                else {
+                    children[child_count ++] = root.left;
+                    children[child_count ++] = root.right;
+                }
+
+                while (child_count < bvh::WIDTH) {
+                    int best = -1;
+                    float best_area = -1.0f;
+
+                    for (int i = 0; i < child_count; ++ i) {
+                        const binary_node& current = m_binary_nodes[children[i]];
+                        if (!current.is_leaf() && current.bounds.surface_area() > best_area)
+                            best = i, best_area = current.bounds.surface_area();
+                    }
+
+                    if (best == -1)
+                        break;
+
+                    const binary_node& opened = m_binary_nodes[children[best]];
+                    children[best] = opened.left;
+                    children[child_count ++] = opened.right;
+                }
+
+                uint32_t index = (uint32_t) m_nodes.size();
+                m_nodes.emplace_back();
+                m_depths.push_back(depth);
+
+                for (int slot = 0; slot < bvh::WIDTH; ++ slot) {
+                    m_nodes[index].set_child_bounds(slot, aabb()); // Empty
+                    m_nodes[index].child[slot] = bvh::EMPTY;
+                    m_nodes[index].count[slot] = 0;
+                }
+
+                for (int slot = 0; slot < child_count; ++ slot) {
+                    const binary_node& child = m_binary_nodes[children[slot]];
+
+                    uint32_t reference = child.is_leaf()? child.first : collapse(children[slot], depth + 1);
+
+                    // Careful, collapse() could have reallocated m_nodes
+                    m_nodes[index].set_child_bounds(slot, child.bounds.to_aabb());
+                    m_nodes[index].child[slot] = reference;
+                    m_nodes[index].count[slot] = child.count;
+                }
+
+                return index;
+            }
+
+        private:
+            const std::vector<binary_node>& m_binary_nodes;
+            std::vector<bvh::node, gl::aligned_allocator<bvh::node>>& m_nodes;
+            std::vector<uint32_t>& m_depths;
+        };
+
+    }
+
+    // -------------------------------------- BVH --------------------------------------
+
+    void bvh::build(std::span<const aabb> primitive_bounds, gl::thread_pool& pool) {
+        m_nodes.clear();
+        m_primitive_order.clear();
+        m_levels.clear(), m_level_offsets.clear();
+
+        m_built_sah_cost = 0.0f;
+
+        if (primitive_bounds.empty())
+            return;
+
+        const size_t count = primitive_bounds.size();
+
+        // ==> Gather primitive info in builder-friendly layout:
+
+        static constexpr size_t GRAIN = 1 << 14;
+
+        std::vector<primitive_info> primitives(count);
+        m_primitive_order.resize(count);
+
+        gl::parallel_for(0, count, GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i) {
+                primitive_info& info = primitives[i];
+
+                for (int axis = 0; axis < 3; ++ axis) {
+                    info.bounds.min[axis] = primitive_bounds[i].min[axis];
+                    info.bounds.max[axis] = primitive_bounds[i].max[axis];
+
+                    info.centroid[axis] = (info.bounds.min[axis] + info.bounds.max[axis]) * 0.5f;
+                }
+
+                info.index = (uint32_t) i;
+            }
+        }, pool);
+
+        // ==> Build top of the tree on this thread (binning in parallel), and
+        //     then build subtrees it leaves behind in parallel:
+
+        binary_builder builder(primitives);
+
+        const uint32_t task_size = (uint32_t) std::max<size_t>(
+            count / (pool.get_thread_count() * 8), PARALLEL_BINNING_THRESHOLD / 16);
+
+        std::vector<binary_node> nodes;
+        std::vector<binary_builder::task> tasks;
+
+        builder.build_top(task_size, nodes, tasks, pool);
+
+        std::vector<std::vector<binary_node>> subtrees(tasks.size());
+        pool.run(tasks.size(), [&](size_t i) {
+            const binary_builder::task& current = tasks[i];
+            builder.build(current.first, current.count, current.depth, subtrees[i]);
+        });
+
+        // Splice subtrees in: subtree root replaces placeholder, the rest is appended
+        for (size_t i = 0; i < tasks.size(); ++ i) {
+            const uint32_t offset = (uint32_t) nodes.size() - 1; // Local 1 goes to nodes.size()
+
+            for (binary_node& current: subtrees[i])
+                if (!current.is_leaf())
+                    current.left += offset, current.right += offset;
+
+            nodes[tasks[i].node] = subtrees[i][0];
+            nodes.insert(nodes.end(), subtrees[i].begin() + 1, subtrees[i].end());
+        }
+
+        gl::parallel_for(0, count, GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i)
+                m_primitive_order[i] = primitives[i].index;
+        }, pool);
+
+        // ==> Collapse into final layout:
+
+        std::vector<uint32_t> depths;
+
+        m_nodes.reserve(nodes.size() / 2 + 1);
+        collapser(nodes, m_nodes, depths).collapse(0);
+
+        // ==> Group nodes by depth for refits (counting sort):
+
+        const uint32_t max_depth = *std::max_element(depths.begin(), depths.end());
+
+        m_level_offsets.assign(max_depth + 2, 0);
+        for (uint32_t depth: depths)
+            ++ m_level_offsets[depth + 1];
+
+        for (uint32_t depth = 0; depth <= max_depth; ++ depth)
+            m_level_offsets[depth + 1] += m_level_offsets[depth];
+
+        std::vector<uint32_t> positions(m_level_offsets.begin(), m_level_offsets.end() - 1);
+
+        m_levels.resize(m_nodes.size());
+        for (uint32_t index = 0; index < m_nodes.size(); ++ index)
+            m_levels[positions[depths[index]] ++] = index;
+
+        m_built_sah_cost = get_sah_cost();
+    }
+
+    void bvh::refit(std::span<const aabb> primitive_bounds, gl::thread_pool& pool) {
+        if (m_nodes.empty())
+            return;
+
+        // Levels are small near the root, no point in waking threads for them
+        static constexpr size_t GRAIN = 1 << 10;
+
+        for (size_t depth = m_level_offsets.size() - 1; depth -- > 0; ) {
+            const uint32_t level_begin = m_level_offsets[depth], level_end = m_level_offsets[depth + 1];
+
+            gl::parallel_for(level_begin, level_end, GRAIN, [&](size_t from, size_t to) {
+                for (size_t i = from; i < to; ++ i) {
+                    node& current = m_nodes[m_levels[i]];
+
+                    for (int slot = 0; slot < WIDTH; ++ slot) {
+                        if (current.child[slot] == EMPTY)
+                            continue;
+
+                        aabb bounds;
+                        if (current.count[slot] > 0) {
+                            const uint32_t first = current.child[slot];
+                            for (uint32_t j = first; j < first + current.count[slot]; ++ j)
+                                bounds.extend(primitive_bounds[m_primitive_order[j]]);
+                        } else {
+                            // Child is one level deeper, so it's already refitted
+                            const node& child = m_nodes[current.child[slot]];
+                            for (int child_slot = 0; child_slot < WIDTH; ++ child_slot)
+                                if (child.child[child_slot] != EMPTY)
+                                    bounds.extend(child.get_child_bounds(child_slot));
+                        }
+
+                        current.set_child_bounds(slot, bounds);
+                    }
+                }
+            }, pool);
+        }
+    }
+
+    aabb bvh::get_bounds() const {
+        aabb bounds;
+        if (m_nodes.empty())
+            return bounds;
+
+        for (int slot = 0; slot < WIDTH; ++ slot)
+            if (m_nodes[0].child[slot] != EMPTY)
+                bounds.extend(m_nodes[0].get_child_bounds(slot));
+
+        return bounds;
+    }
+
+    float bvh::get_sah_cost() const {
+        const float root_area = get_bounds().surface_area();
+        if (m_nodes.empty() || root_area <= 0.0f)
+            return 0.0f;
+
+        float cost = TRAVERSAL_COST; // Root is always visited
+        for (const node& current: m_nodes)
+            for (int slot = 0; slot < WIDTH; ++ slot) {
+                if (current.child[slot] == EMPTY)
+                    continue;
+
+                float probability = current.get_child_bounds(slot).surface_area() / root_area;
+
+                cost += probability * (current.count[slot] > 0?
+                    INTERSECTION_COST * (float) current.count[slot] : TRAVERSAL_COST);
+            }
+
+        return cost;
+    }
+
+    float bvh::get_sah_degradation() const {
+        return m_built_sah_cost > 0.0f? get_sah_cost() / m_built_sah_cost : 1.0f;
+    }
+
+}
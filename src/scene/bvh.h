@@ -0,0 +1,223 @@
+#pragma once
+
+#include "aabb.h"
+#include "aligned-allocator.h"
+#include "ray.h"
+#include "thread-pool.h"
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace raycaster {
+
+    // 4-wide bounding volume hierarchy over arbitrary primitives. Built as binary
+    // tree with binned SAH and then collapsed, so that every node holds bounds of
+    // four children in SoA form and can be tested against a ray with one SIMD op.
+    class bvh {
+    public:
+        static constexpr int WIDTH = 4;
+
+        static constexpr uint32_t EMPTY = UINT32_MAX;
+
+        // 128 bytes, exactly two cache lines
+        struct alignas(64) node {
+            // Indexed as [0 for min, 1 for max][axis][slot], unused slots have
+            // inverted bounds (+inf, -inf) that no ray can ever intersect
+            float bounds[2][3][WIDTH];
+
+            // Inner child (count == 0): index of child node or EMPTY for unused slot,
+            // leaf child (count  > 0): index of its first primitive in leaf order
+            uint32_t child[WIDTH];
+            uint32_t count[WIDTH];
+
+            aabb get_child_bounds(int slot) const;
+            void set_child_bounds(int slot, const aabb& bounds);
+        };
+
+        // Builds hierarchy over primitives with given bounds, big subtrees
+        // are built in parallel, as well as binning for big nodes near the root
+        void build(std::span<const aabb> primitive_bounds,
+                   gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Recomputes bounds of every node bottom-up for primitives that moved,
+        // topology stays the same, so quality degrades the more they move.
+        // Nodes of every level are refitted in parallel, deepest level first
+        void refit(std::span<const aabb> primitive_bounds,
+                   gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Leaves reference primitives in this order, users are expected to reorder
+        // their primitive data accordingly, so that leaves read it sequentially
+        const std::vector<uint32_t>& get_primitive_order() const { return m_primitive_order; }
+
+        // Finds nearest hit, calls intersector(primitive, ray, closest) -> bool for
+        // primitives of leaves ray enters, where primitive is in leaf order
+        template <typename intersector_type>
+        bool intersect(const ray& current_ray, hit& closest, intersector_type&& intersector) const;
+
+        // Checks if any primitive is closer than /max_distance/ along the ray, stops
+        // at the first one intersector reports a hit for, doesn't order children
+        template <typename intersector_type>
+        bool occluded(const ray& current_ray, float max_distance, intersector_type&& intersector) const;
+
+        const std::vector<node, gl::aligned_allocator<node>>& get_nodes() const { return m_nodes; }
+
+        aabb get_bounds() const;
+
+        bool empty() const { return m_nodes.empty(); }
+
+        // Expected cost of tracing random ray according to surface area heuristic,
+        // lets compare quality of hierarchies built over the same primitives
+        float get_sah_cost() const;
+
+        // How many times SAH cost grew due to refits since the last build,
+        // hierarchy is worth rebuilding when this gets too big
+        float get_sah_degradation() const;
+
+        // ==> SAH constants (relative cost of traversal step and intersection):
+
+        static constexpr float TRAVERSAL_COST    = 1.0f;
+        static constexpr float INTERSECTION_COST = 1.0f;
+
+    private:
+        std::vector<node, gl::aligned_allocator<node>> m_nodes;
+        std::vector<uint32_t> m_primitive_order;
+
+        // Nodes of depth d are m_levels[m_level_offsets[d] ... m_level_offsets[d + 1]]
+        std::vector<uint32_t> m_levels;
+        std::vector<uint32_t> m_level_offsets;
+
+        float m_built_sah_cost = 0.0f;
+
+        template <bool is_any_hit, typename intersector_type>
+        bool traverse(const ray& current_ray, hit& closest, intersector_type&& intersector) const;
+    };
+
+
+    template <typename intersector_type>
+    bool bvh::intersect(const ray& current_ray, hit& closest, intersector_type&& intersector) const {
+        return traverse<false>(current_ray, closest, intersector);
+    }
+
+    template <typename intersector_type>
+    bool bvh::occluded(const ray& current_ray, float max_distance, intersector_type&& intersector) const {
+        hit closest;
+        closest.distance = max_distance;
+
+        return traverse<true>(current_ray, closest, intersector);
+    }
+
+    template <bool is_any_hit, typename intersector_type>
+    bool bvh::traverse(const ray& current_ray, hit& closest, intersector_type&& intersector) const {
+        if (m_nodes.empty())
+            return false;
+
+        // Avoid infinite inverse direction turning into NaN when multiplied by 0
+        auto safe_inverse = [](float value) {
+            static constexpr float MIN_DIRECTION = 1e-20f;
+            return 1.0f / (std::abs(value) > MIN_DIRECTION? value : std::copysign(MIN_DIRECTION, value));
+        };
+
+        const float origin[3]    = { current_ray.origin.x(),    current_ray.origin.y(),    current_ray.origin.z()    };
+        const float direction[3] = { current_ray.direction.x(), current_ray.direction.y(), current_ray.direction.z() };
+
+        __m128 origins[3], inverses[3];
+        int near_side[3]; // Which of the planes ray meets first, picks min or max
+
+        for (int axis = 0; axis < 3; ++ axis) {
+            origins [axis] = _mm_set1_ps(origin[axis]);
+            inverses[axis] = _mm_set1_ps(safe_inverse(direction[axis]));
+
+            near_side[axis] = direction[axis] < 0.0f;
+        }
+
+        struct entry {
+            uint32_t child, count;
+            float distance;
+        };
+
+        // Every node adds at most 3 entries more than it pops, so this is plenty
+        static constexpr int STACK_SIZE = 64 * (WIDTH - 1) + 1;
+
+        entry stack[STACK_SIZE];
+        int stack_size = 0;
+
+        stack[stack_size ++] = { 0, 0, 0.0f };
+
+        bool is_hit = false;
+        while (stack_size > 0) {
+            const entry current = stack[-- stack_size];
+
+            if (current.distance >= closest.distance)
+                continue; // Something closer was already found
+
+            if (current.count > 0) {
+                for (uint32_t i = current.child; i < current.child + current.count; ++ i) {
+                    is_hit |= intersector(i, current_ray, closest);
+
+                    if (is_any_hit && is_hit)
+                        return true;
+                }
+
+                continue;
+            }
+
+            const node& current_node = m_nodes[current.child];
+
+            // ==> Slab test against all four children at once:
+
+            __m128 t_near = _mm_setzero_ps(), t_far = _mm_set1_ps(closest.distance);
+            for (int axis = 0; axis < 3; ++ axis) {
+                __m128 near_plane = _mm_load_ps(current_node.bounds[    near_side[axis]][axis]);
+                __m128 far_plane  = _mm_load_ps(current_node.bounds[1 - near_side[axis]][axis]);
+
+                t_near = _mm_max_ps(t_near, _mm_mul_ps(_mm_sub_ps(near_plane, origins[axis]), inverses[axis]));
+                t_far  = _mm_min_ps(t_far,  _mm_mul_ps(_mm_sub_ps(far_plane,  origins[axis]), inverses[axis]));
+            }
+
+            int mask = _mm_movemask_ps(_mm_cmple_ps(t_near, t_far));
+            if (mask == 0)
+                continue;
+
+            alignas(16) float distances[WIDTH];
+            _mm_store_ps(distances, t_near);
+
+            if constexpr (is_any_hit) {
+                // Order doesn't matter, first occluder ends the search anyway
+                for (int slot = 0; slot < WIDTH; ++ slot)
+                    if (mask & (1 << slot))
+                        stack[stack_size ++] = { current_node.child[slot], current_node.count[slot], distances[slot] };
+
+                continue;
+            }
+
+            // Push farthest children first, so that nearest is popped first
+            entry hit_children[WIDTH];
+            int hit_count = 0;
+
+            for (int slot = 0; slot < WIDTH; ++ slot) {
+                if (!(mask & (1 << slot)))
+                    continue;
+
+                entry child = { current_node.child[slot], current_node.count[slot], distances[slot] };
+
+                int position = hit_count ++;
+                while (position > 0 && hit_children[position - 1].distance < child.distance) {
+                    hit_children[position] = hit_children[position - 1];
+                    -- position;
+                }
+
+                hit_children[position] = child;
+            }
+
+            for (int i = 0; i < hit_count; ++ i)
+                stack[stack_size ++] = hit_children[i];
+        }
+
+        return is_hit;
+    }
+
+}
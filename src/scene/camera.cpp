@@ -0,0 +1,189 @@
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace raycaster {
+
+    namespace {
+
+        math::vec3 cross(const math::vec3& lhs, const math::vec3& rhs) {
+            return { lhs.y() * rhs.z() - lhs.z() * rhs.y(),
+                     lhs.z() * rhs.x() - lhs.x() * rhs.z(),
+                     lhs.x() * rhs.y() - lhs.y() * rhs.x() };
+        }
+
+        // Rows are processed in chunks, small enough to balance
+        static constexpr size_t ROW_GRAIN = 8;
+
+    }
+
+    camera::camera(math::vec3 position, math::vec3 target, float field_of_view, math::vec3 up)
+        : m_position(position), m_field_of_view(field_of_view) {
+
+        look_at(target, up);
+    }
+
+    void camera::set_resolution(int width, int height) {
+        if (width == m_width && height == m_height)
+            return;
+
+        m_width = width, m_height = height;
+        m_are_intrinsics_changed = true;
+    }
+
+    void camera::set_field_of_view(float field_of_view) {
+        if (field_of_view == m_field_of_view)
+            return;
+
+        m_field_of_view = field_of_view;
+        m_are_intrinsics_changed = true;
+    }
+
+    void camera::look_at(math::vec3 target, math::vec3 up) {
+        m_forward = (target - m_position).normalized();
+        m_right   = cross(m_forward, up).normalized();
+        m_up      = cross(m_right, m_forward);
+
+        m_is_orientation_changed = true;
+    }
+
+    void camera::update(gl::thread_pool& pool) {
+        if (m_are_intrinsics_changed)
+            compute_local_directions(pool);
+
+        if (m_are_intrinsics_changed || m_is_orientation_changed)
+            rotate_directions(pool);
+
+        m_are_intrinsics_changed = m_is_orientation_changed = false;
+    }
+
+    float camera::get_pixel_angle() const {
+        const int pixels = std::max(1, std::min(m_width, m_height));
+        return 2.0f * std::tan(m_field_of_view * 0.5f) / (float) pixels;
+    }
+
+    math::vec3 camera::to_camera_space(const math::vec3& point) const {
+        const math::vec3 relative = point - m_position;
+        return { relative.dot(m_right), relative.dot(m_up), relative.dot(m_forward) };
+    }
+
+    math::vec3 camera::project(const math::vec3& point) const {
+        const math::vec3 local = to_camera_space(point);
+        const math::vec2 scale = get_screen_scale();
+
+        const float depth = local.z();
+
+        // Inverse of (2 i / height - 1) * scale.x = x / depth
+        const float i = (local.x() / (depth * scale.x()) + 1.0f) * 0.5f * (float) m_height;
+        const float j = (local.y() / (depth * scale.y()) + 1.0f) * 0.5f * (float) m_width;
+
+        return { i, j, depth };
+    }
+
+    camera camera::get_snapshot() const {
+        camera result(m_position, m_position + m_forward, m_field_of_view, m_up);
+
+        // Exactly the same basis, not one recomputed from it
+        result.m_right = m_right, result.m_up = m_up, result.m_forward = m_forward;
+        result.m_width = m_width, result.m_height = m_height;
+
+        return result;
+    }
+
+    math::vec2 camera::get_screen_scale() const {
+        // Screen spans [-1, 1] both ways, so shorter side sees field of view,
+        // and longer one is stretched to keep pixels square
+        const float shorter_side = (float) std::max(1, std::min(m_width, m_height));
+        const float tangent = std::tan(m_field_of_view * 0.5f);
+
+        return { tangent * (float) m_height / shorter_side,
+                 tangent * (float) m_width  / shorter_side };
+    }
+
+    void camera::compute_local_directions(gl::thread_pool& pool) {
+        const size_t pixel_count = (size_t) m_width * m_height;
+
+        m_local_x.resize(pixel_count), m_local_y.resize(pixel_count), m_local_z.resize(pixel_count);
+        m_world_x.resize(pixel_count), m_world_y.resize(pixel_count), m_world_z.resize(pixel_count);
+
+        const math::vec2 scale = get_screen_scale();
+        const float scale_x = scale.x(), scale_y = scale.y();
+
+        gl::parallel_for(0, m_height, ROW_GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i)
+                for (size_t j = 0; j < (size_t) m_width; ++ j) {
+                    const float x = (2.0f * (float) i / (float) m_height - 1.0f) * scale_x;
+                    const float y = (2.0f * (float) j / (float) m_width  - 1.0f) * scale_y;
+
+                    const float inverse_length = 1.0f / std::sqrt(x * x + y * y + 1.0f);
+
+                    const size_t index = i * m_width + j;
+                    m_local_x[index] = x * inverse_length;
+                    m_local_y[index] = y * inverse_length;
+                    m_local_z[index] = inverse_length;
+                }
+        }, pool);
+    }
+
+    void camera::rotate_directions(gl::thread_pool& pool) {
+        // Plain 3x3 rotation, compiler vectorizes it over SoA streams
+        const float basis[3][3] = {
+            { m_right.x(), m_up.x(), m_forward.x() },
+            { m_right.y(), m_up.y(), m_forward.y() },
+            { m_right.z(), m_up.z(), m_forward.z() }
+        };
+
+        gl::parallel_for(0, m_height, ROW_GRAIN, [&](size_t from, size_t to) {
+            const size_t begin = from * m_width, end = to * m_width;
+
+            const float* __restrict local_x = m_local_x.data();
+            const float* __restrict local_y = m_local_y.data();
+            const float* __restrict local_z = m_local_z.data();
+
+            float* __restrict world_x = m_world_x.data();
+            float* __restrict world_y = m_world_y.data();
+            float* __restrict world_z = m_world_z.data();
+
+            for (size_t index = begin; index < end; ++ index) {
+                const float x = local_x[index], y = local_y[index], z = local_z[index];
+
+                world_x[index] = basis[0][0] * x + basis[0][1] * y + basis[0][2] * z;
+                world_y[index] = basis[1][0] * x + basis[1][1] * y + basis[1][2] * z;
+                world_z[index] = basis[2][0] * x + basis[2][1] * y + basis[2][2] * z;
+            }
+        }, pool);
+    }
+
+    ray camera::get_ray(int i, int j) const {
+        const size_t index = (size_t) i * m_width + j;
+        return { m_position, { m_world_x[index], m_world_y[index], m_world_z[index] } };
+    }
+
+    ray camera::get_subpixel_ray(float i, float j) const {
+        const math::vec2 scale = get_screen_scale();
+
+        const float x = (2.0f * i / (float) m_height - 1.0f) * scale.x();
+        const float y = (2.0f * j / (float) m_width  - 1.0f) * scale.y();
+
+        return { m_position, (m_right * x + m_up * y + m_forward).normalized() };
+    }
+
+    void camera::get_packet(int i, int j, int count, ray_packet& packet) const {
+        const size_t first = (size_t) i * m_width + j;
+
+        packet.count = count;
+        for (int lane = 0; lane < count; ++ lane) {
+            packet.direction[0][lane] = m_world_x[first + lane];
+            packet.direction[1][lane] = m_world_y[first + lane];
+            packet.direction[2][lane] = m_world_z[first + lane];
+        }
+
+        const math::vec3& position = m_position;
+        for (int axis = 0; axis < 3; ++ axis)
+            std::fill_n(packet.origin[axis], ray_packet::SIZE, position[axis]);
+
+        packet.pad();
+    }
+
+}
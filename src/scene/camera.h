@@ -0,0 +1,101 @@
+#pragma once
+
+#include "aligned-allocator.h"
+#include "ray.h"
+#include "thread-pool.h"
+#include "vec.h"
+
+#include <cstddef>
+
+namespace raycaster {
+
+    // Pinhole camera generating primary rays from precomputed directions.
+    //
+    // Normalized direction of every pixel in camera's space is cached, and only
+    // recomputed when field of view or resolution changes. World space directions
+    // are cached too, turning camera just rotates them (no normalization needed),
+    // and moving it doesn't touch them at all.
+    //
+    // Pixels are laid out just like pixel_drawing_window's: pixel (i, j) is at
+    // (2 i / height - 1, 2 j / width - 1) on the screen, x goes along rows
+    class camera {
+    public:
+        static constexpr float DEFAULT_FIELD_OF_VIEW = 0.785398f; // 45°
+
+        camera(math::vec3 position, math::vec3 target,
+               float field_of_view = DEFAULT_FIELD_OF_VIEW,
+               math::vec3 up = { 0.0f, 1.0f, 0.0f });
+
+        // ==> Intrinsics (invalidate cached directions):
+
+        void set_resolution(int width, int height);
+
+        // Field of view (in radians) spans shorter side of the screen
+        void set_field_of_view(float field_of_view);
+
+        // ==> Pose:
+
+        void set_position(math::vec3 position) { m_position = position; }
+        void look_at(math::vec3 target, math::vec3 up = { 0.0f, 1.0f, 0.0f });
+
+        // Recomputes caches that were invalidated, call once before the frame
+        // is rendered, ray getters below are safe to call concurrently after that
+        void update(gl::thread_pool& pool = gl::thread_pool::global());
+
+        ray get_ray(int i, int j) const;
+
+        // Ray through any point of the screen in pixel coordinates, computed on
+        // the spot (not cached), for the few extra rays, like supersampling ones
+        ray get_subpixel_ray(float i, float j) const;
+
+        // Fills packet with rays of /count/ (at most 8) pixels in row i starting at j
+        void get_packet(int i, int j, int count, ray_packet& packet) const;
+
+        const math::vec3& get_position() const { return m_position; }
+        const math::vec3& get_forward()  const { return m_forward;  }
+
+        int get_width()  const { return m_width;  }
+        int get_height() const { return m_height; }
+
+        // Point relative to camera, in its basis: (right, up, forward)
+        math::vec3 to_camera_space(const math::vec3& point) const;
+
+        // Pixel coordinates (i, j) point is seen at (fractional, like get_subpixel_ray's ones),
+        // and its depth along forward, which isn't positive for points behind camera
+        math::vec3 project(const math::vec3& point) const;
+
+        // Camera with the same pose and intrinsics, but without cached directions (cheap to
+        // keep around), enough to project points into the view as it was at the time
+        camera get_snapshot() const;
+
+        // Pixel (i, j) looks along (x, y, 1) in camera space, where
+        // x = (2 i / height - 1) * scale.x, y = (2 j / width - 1) * scale.y
+        math::vec2 get_screen_scale() const;
+
+        // Angle between adjacent pixels' rays, lets tracers scale their
+        // tolerance with pixel's footprint (which grows with distance)
+        float get_pixel_angle() const;
+
+    private:
+        math::vec3 m_position;
+
+        // Orthonormal basis, camera looks along forward
+        math::vec3 m_right   { 1.0f, 0.0f, 0.0f };
+        math::vec3 m_up      { 0.0f, 1.0f, 0.0f };
+        math::vec3 m_forward { 0.0f, 0.0f, 1.0f };
+
+        float m_field_of_view;
+        int m_width = 0, m_height = 0;
+
+        bool m_are_intrinsics_changed  = true;
+        bool m_is_orientation_changed  = true;
+
+        // Pixel (i, j) is at index i * width + j, every stream is SoA
+        gl::aligned_vector<float> m_local_x, m_local_y, m_local_z;
+        gl::aligned_vector<float> m_world_x, m_world_y, m_world_z;
+
+        void compute_local_directions(gl::thread_pool& pool);
+        void rotate_directions(gl::thread_pool& pool);
+    };
+
+}
@@ -0,0 +1,187 @@
+#include "light-grid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace raycaster {
+
+    template <typename callback_type>
+    void light_grid::for_each_cluster(const cluster_range& range, callback_type&& callback) const {
+        for (int slice = range.from[2]; slice <= range.to[2]; ++ slice)
+            for (int row = range.from[0]; row <= range.to[0]; ++ row)
+                for (int column = range.from[1]; column <= range.to[1]; ++ column)
+                    callback(get_cluster_index(row, column, slice));
+    }
+
+    int light_grid::get_slice(float depth) const {
+        if (!(depth > m_near))
+            return 0;
+
+        // Clamped while still float, depth can be infinite
+        const float slice = std::log(depth / m_near) * m_inverse_log_depth_ratio;
+        return (int) std::min(slice, (float) (DEPTH_SLICES - 1));
+    }
+
+    light_grid::cluster_range light_grid::get_cluster_range(const camera& view,
+                                                            const light_bounds& light) const {
+        static constexpr cluster_range EMPTY = { { 0, 0, 0 }, { -1, -1, -1 } };
+
+        const float radius = light.radius;
+        if (std::isinf(radius))
+            return EMPTY; // Listed for every pixel instead
+
+        const math::vec3 center = view.to_camera_space(light.position);
+
+        const float depth = center.z();
+        if (depth + radius <= 0.0f)
+            return EMPTY; // Behind camera
+
+        cluster_range range;
+        range.from[2] = get_slice(depth - radius);
+        range.to  [2] = get_slice(depth + radius);
+
+        // ==> Screen footprint, bounded by slopes (x / z, y / z) over sphere's bounding box:
+
+        const math::vec2 scale = view.get_screen_scale();
+
+        const int pixels[2] = { view.get_height(), view.get_width() };
+        const int tiles [2] = { m_tile_rows, m_tile_columns };
+
+        for (int axis = 0; axis < 2; ++ axis) {
+            if (depth - radius <= 0.0f) {
+                // Reaches behind camera, slopes are unbounded
+                range.from[axis] = 0, range.to[axis] = tiles[axis] - 1;
+                continue;
+            }
+
+            const float low = center[axis] - radius, high = center[axis] + radius;
+
+            const float min_slope = std::min(low  / (depth - radius), low  / (depth + radius));
+            const float max_slope = std::max(high / (depth - radius), high / (depth + radius));
+
+            // Slope -> pixel, inverse of camera's (2 i / height - 1) * scale
+            const float half_size = 0.5f * (float) pixels[axis];
+
+            const float from = (min_slope / scale[axis] + 1.0f) * half_size;
+            const float to   = (max_slope / scale[axis] + 1.0f) * half_size;
+
+            if (to < 0.0f || from >= (float) pixels[axis])
+                return EMPTY; // Off screen
+
+            const float last_tile = (float) (tiles[axis] - 1);
+
+            range.from[axis] = (int) std::clamp(std::floor(from / TILE_SIZE), 0.0f, last_tile);
+            range.to  [axis] = (int) std::clamp(std::floor(to   / TILE_SIZE), 0.0f, last_tile);
+        }
+
+        return range;
+    }
+
+    void light_grid::build(const camera& view, std::span<const light_bounds> lights, float near, float far,
+                           gl::thread_pool& pool) {
+        m_cluster_offsets.clear();
+        m_light_indices.clear();
+        m_global_lights.clear();
+
+        m_tile_rows    = (view.get_height() + TILE_SIZE - 1) / TILE_SIZE;
+        m_tile_columns = (view.get_width()  + TILE_SIZE - 1) / TILE_SIZE;
+
+        // Keep slices well defined for degenerate ranges
+        m_near = std::max(near, 1e-4f);
+        far = std::max(far, m_near * 2.0f);
+
+        m_inverse_log_depth_ratio = (float) DEPTH_SLICES / std::log(far / m_near);
+
+        const size_t cluster_count = get_cluster_index(0, 0, DEPTH_SLICES);
+
+        // ==> Find clusters every light overlaps, in parallel:
+
+        static constexpr size_t LIGHT_GRAIN = 16, CLUSTER_GRAIN = 1024;
+
+        std::vector<cluster_range> ranges(lights.size());
+        gl::parallel_for(0, lights.size(), LIGHT_GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i)
+                ranges[i] = get_cluster_range(view, lights[i]);
+        }, pool);
+
+        for (size_t i = 0; i < lights.size(); ++ i)
+            if (std::isinf(lights[i].radius))
+                m_global_lights.push_back((uint32_t) i);
+
+        // ==> Count lights per cluster in parallel:
+
+        std::vector<std::atomic<uint32_t>> counters(cluster_count);
+        gl::parallel_for(0, lights.size(), LIGHT_GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i)
+                for_each_cluster(ranges[i], [&](size_t cluster) {
+                    counters[cluster].fetch_add(1, std::memory_order_relaxed);
+                });
+        }, pool);
+
+        // ==> Turn counts into offsets (exclusive prefix sum):
+
+        m_cluster_offsets.resize(cluster_count + 1);
+
+        uint32_t total = 0;
+        for (size_t cluster = 0; cluster < cluster_count; ++ cluster) {
+            m_cluster_offsets[cluster] = total;
+            total += counters[cluster].exchange(0, std::memory_order_relaxed);
+        }
+
+        m_cluster_offsets[cluster_count] = total;
+
+        // ==> Scatter light indices into their clusters in parallel:
+
+        m_light_indices.resize(total);
+        gl::parallel_for(0, lights.size(), LIGHT_GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i)
+                for_each_cluster(ranges[i], [&](size_t cluster) {
+                    uint32_t slot = counters[cluster].fetch_add(1, std::memory_order_relaxed);
+                    m_light_indices[m_cluster_offsets[cluster] + slot] = (uint32_t) i;
+                });
+        }, pool);
+
+        // Scatter order depends on scheduling, sort clusters to make it deterministic
+        // (and shading order with it, so frames don't flicker in last bits)
+        gl::parallel_for(0, cluster_count, CLUSTER_GRAIN, [&](size_t from, size_t to) {
+            for (size_t cluster = from; cluster < to; ++ cluster)
+                std::sort(m_light_indices.begin() + m_cluster_offsets[cluster],
+                          m_light_indices.begin() + m_cluster_offsets[cluster + 1]);
+        }, pool);
+    }
+
+    void light_grid::gather(int row_begin, int row_end, int column_begin, int column_end,
+                            float min_depth, float max_depth, std::vector<uint32_t>& lights) const {
+        lights.assign(m_global_lights.begin(), m_global_lights.end());
+
+        if (m_cluster_offsets.empty() || row_begin >= row_end || column_begin >= column_end)
+            return;
+
+        const int last_row = m_tile_rows - 1, last_column = m_tile_columns - 1;
+
+        cluster_range range;
+        range.from[0] = std::clamp(row_begin          / TILE_SIZE, 0, last_row);
+        range.to  [0] = std::clamp((row_end - 1)      / TILE_SIZE, 0, last_row);
+        range.from[1] = std::clamp(column_begin       / TILE_SIZE, 0, last_column);
+        range.to  [1] = std::clamp((column_end - 1)   / TILE_SIZE, 0, last_column);
+        range.from[2] = get_slice(min_depth);
+        range.to  [2] = get_slice(max_depth);
+
+        bool is_single_cluster = true;
+        for (int axis = 0; axis < 3; ++ axis)
+            is_single_cluster &= range.from[axis] == range.to[axis];
+
+        for_each_cluster(range, [&](size_t cluster) {
+            lights.insert(lights.end(), m_light_indices.begin() + m_cluster_offsets[cluster],
+                                        m_light_indices.begin() + m_cluster_offsets[cluster + 1]);
+        });
+
+        // Lists of several clusters overlap, merge them
+        if (!is_single_cluster || !m_global_lights.empty()) {
+            std::sort(lights.begin(), lights.end());
+            lights.erase(std::unique(lights.begin(), lights.end()), lights.end());
+        }
+    }
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "camera.h"
+#include "thread-pool.h"
+#include "vec.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace raycaster {
+
+    // Sphere outside of which light doesn't affect anything,
+    // radius can be infinite for lights that reach everywhere
+    struct light_bounds {
+        math::vec3 position;
+        float radius;
+    };
+
+    // Clustered light culling: screen is split into tiles, and view depth in front of camera
+    // into slices (exponentially growing, like perspective does with pixel footprints), every
+    // resulting cluster stores indices of lights whose radius of influence may overlap it.
+    //
+    // Lists are stored in one flat index array (compressed like CSR sparse matrices, same as
+    // uniform_grid's cells), and are rebuilt from scratch every frame, since both lights and
+    // camera can move. Lights of infinite radius skip clusters and are listed for every pixel
+    class light_grid {
+    public:
+        // Pixels per side of screen tile, multiple of pixel_drawing_window's TILE_SIZE,
+        // so that window's tiles never straddle clusters
+        static constexpr int TILE_SIZE = 32;
+        static constexpr int DEPTH_SLICES = 16;
+
+        // Depths of everything that gets shaded should lie in [near, far] (measured along camera's
+        // forward), ones that don't still get their lights, they just share edge slices' lists
+        void build(const camera& view, std::span<const light_bounds> lights, float near, float far,
+                   gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Replaces /lights/ with sorted indices of every light that may affect pixels in
+        // given rectangle at depths in [min_depth, max_depth] (clusters' lists merged)
+        void gather(int row_begin, int row_end, int column_begin, int column_end,
+                    float min_depth, float max_depth, std::vector<uint32_t>& lights) const;
+
+        size_t get_cluster_count() const { return m_cluster_offsets.empty()? 0 : m_cluster_offsets.size() - 1; }
+
+    private:
+        // Tiles along rows (i) and columns (j) of the screen
+        int m_tile_rows = 0, m_tile_columns = 0;
+
+        float m_near = 1.0f;
+        float m_inverse_log_depth_ratio = 1.0f; // DEPTH_SLICES / log(far / near)
+
+        // Cluster (row, column, slice) is at (slice * tile_rows + row) * tile_columns + column,
+        // its lights are at [offsets[cluster], offsets[cluster + 1]) in m_light_indices
+        std::vector<uint32_t> m_cluster_offsets;
+        std::vector<uint32_t> m_light_indices;
+
+        std::vector<uint32_t> m_global_lights;
+
+        // Inclusive ranges of clusters light overlaps along every axis, empty if none
+        struct cluster_range {
+            int from[3], to[3];
+
+            bool is_empty() const { return from[0] > to[0]; }
+        };
+
+        cluster_range get_cluster_range(const camera& view, const light_bounds& light) const;
+
+        size_t get_cluster_index(int row, int column, int slice) const {
+            return ((size_t) slice * m_tile_rows + row) * m_tile_columns + column;
+        }
+
+        int get_slice(float depth) const;
+
+        template <typename callback_type>
+        void for_each_cluster(const cluster_range& range, callback_type&& callback) const;
+    };
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "vec.h"
+
+#include <cstdint>
+#include <limits>
+
+namespace raycaster {
+
+    struct ray {
+        math::vec3 origin;
+        math::vec3 direction; // Expected to be normalized
+    };
+
+    // Up to 8 rays in SoA form, so that SIMD code loads every coordinate of
+    // all of them at once, lanes past /count/ are padding and are ignored
+    struct alignas(32) ray_packet {
+        static constexpr int SIZE = 8;
+
+        float origin[3][SIZE];
+        float direction[3][SIZE];
+
+        int count = 0;
+
+        void set_ray(int lane, const ray& current) {
+            for (int axis = 0; axis < 3; ++ axis) {
+                origin   [axis][lane] = current.origin[axis];
+                direction[axis][lane] = current.direction[axis];
+            }
+        }
+
+        ray get_ray(int lane) const {
+            return { { origin   [0][lane], origin   [1][lane], origin   [2][lane] },
+                     { direction[0][lane], direction[1][lane], direction[2][lane] } };
+        }
+
+        // Copies last ray into padding lanes, so they compute something sane
+        void pad() {
+            for (int lane = count; lane < SIZE; ++ lane)
+                for (int axis = 0; axis < 3; ++ axis) {
+                    origin   [axis][lane] = origin   [axis][count - 1];
+                    direction[axis][lane] = direction[axis][count - 1];
+                }
+        }
+    };
+
+    // Nearest intersection found so far, every intersector only accepts
+    // hits closer than /distance/, so it doubles as ray's upper bound
+    struct hit {
+        float distance = std::numeric_limits<float>::infinity();
+
+        math::vec3 position { 0.0f, 0.0f, 0.0f };
+        math::vec3 normal   { 0.0f, 0.0f, 0.0f };
+
+        uint32_t material = 0;
+
+        // How far (across the ray) silhouette of the surface is from the ray, lets
+        // renderers compute pixel's coverage analytically. Infinite when it's unknown,
+        // only spheres report theirs
+        float edge_distance = std::numeric_limits<float>::infinity();
+
+        bool is_hit() const { return distance != std::numeric_limits<float>::infinity(); }
+    };
+
+    // Minimal distance along the ray for hits to count, protects secondary
+    // rays from hitting the surface they were cast from
+    inline constexpr float ray_epsilon = 1e-4f;
+
+}
@@ -0,0 +1,58 @@
+#include "scene.h"
+
+namespace raycaster {
+
+    void scene::add_mesh(const triangle_mesh& mesh, uint32_t material, gl::thread_pool& pool) {
+        m_meshes.emplace_back().build(mesh, material, pool);
+    }
+
+    void scene::build(gl::thread_pool& pool) {
+        if (m_sphere_structure == sphere_structure::bvh)
+            m_sphere_bvh.build(m_spheres, pool);
+        else
+            m_sphere_grid.build(m_spheres, uniform_grid::DEFAULT_DENSITY, pool);
+    }
+
+    void scene::update(float rebuild_threshold, gl::thread_pool& pool) {
+        if (m_sphere_structure == sphere_structure::bvh)
+            m_sphere_bvh.update(m_spheres, rebuild_threshold, pool);
+        else
+            m_sphere_grid.build(m_spheres, uniform_grid::DEFAULT_DENSITY, pool);
+    }
+
+    bool scene::intersect(const ray& current_ray, hit& closest) const {
+        bool is_hit = m_sphere_structure == sphere_structure::bvh?
+            m_sphere_bvh.intersect(m_spheres, current_ray, closest) :
+            m_sphere_grid.intersect(m_spheres, current_ray, closest);
+
+        for (const mesh_bvh& mesh: m_meshes)
+            is_hit |= mesh.intersect(current_ray, closest);
+
+        return is_hit;
+    }
+
+    bool scene::occluded(const ray& current_ray, float max_distance) const {
+        const bool is_occluded = m_sphere_structure == sphere_structure::bvh?
+            m_sphere_bvh.occluded(m_spheres, current_ray, max_distance) :
+            m_sphere_grid.occluded(m_spheres, current_ray, max_distance);
+
+        if (is_occluded)
+            return true;
+
+        for (const mesh_bvh& mesh: m_meshes)
+            if (mesh.occluded(current_ray, max_distance))
+                return true;
+
+        return false;
+    }
+
+    aabb scene::get_bounds() const {
+        aabb bounds = m_spheres.get_bounds();
+
+        for (const mesh_bvh& mesh: m_meshes)
+            bounds.extend(mesh.get_bounds());
+
+        return bounds;
+    }
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "aabb.h"
+#include "mesh-bvh.h"
+#include "ray.h"
+#include "sphere-bvh.h"
+#include "sphere-scene.h"
+#include "thread-pool.h"
+#include "triangle-mesh.h"
+#include "uniform-grid.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace raycaster {
+
+    // Everything raycaster can intersect: spheres and triangle meshes,
+    // each with its own acceleration structure, so one nearest-hit query
+    // yields surface for the shading no matter what it belongs to
+    class scene {
+    public:
+        // Grid is faster to build and trace for static spheres, while
+        // hierarchy can be cheaply refitted when they are animated
+        enum class sphere_structure { grid, bvh };
+
+        explicit scene(sphere_structure structure = sphere_structure::grid)
+            : m_sphere_structure(structure) {}
+
+        sphere_scene& get_spheres() { return m_spheres; }
+        const sphere_scene& get_spheres() const { return m_spheres; }
+
+        // Mesh is converted (and its BVH is built) right away
+        void add_mesh(const triangle_mesh& mesh, uint32_t material = 0,
+                      gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Rebuilds spheres' acceleration structure, call after changing them
+        void build(gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Cheaper alternative to build() for spheres that only moved or changed
+        // radius since then, refits hierarchy when spheres use one (rebuilding
+        // it when refit degrades it past /rebuild_threshold/), grid is rebuilt
+        void update(float rebuild_threshold = sphere_bvh::DEFAULT_REBUILD_THRESHOLD,
+                    gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Finds nearest intersection closer than /closest/ and updates it
+        bool intersect(const ray& current_ray, hit& closest) const;
+
+        // Checks if anything is closer than /max_distance/ along the ray, stops
+        // at the first occluder found, so shadow rays should use this one
+        bool occluded(const ray& current_ray, float max_distance) const;
+
+        aabb get_bounds() const;
+
+    private:
+        sphere_scene m_spheres;
+
+        sphere_structure m_sphere_structure;
+        uniform_grid m_sphere_grid;
+        sphere_bvh m_sphere_bvh;
+
+        std::vector<mesh_bvh> m_meshes;
+    };
+
+}
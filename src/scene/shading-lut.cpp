@@ -0,0 +1,156 @@
+#include "shading-lut.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace raycaster {
+
+    // ------------------------------- OCTAHEDRAL MAPPING ------------------------------
+
+    namespace {
+
+        float sign_of(float value) { return value < 0.0f? -1.0f : 1.0f; }
+
+        // Unit vector -> point of [-1, 1]^2, lower hemisphere is folded over the corners
+        void encode_octahedral(const math::vec3& normal, float& u, float& v) {
+            const float x = normal.x(), y = normal.y(), z = normal.z();
+            const float inverse_norm = 1.0f / (std::abs(x) + std::abs(y) + std::abs(z));
+
+            u = x * inverse_norm, v = y * inverse_norm;
+            if (z < 0.0f) {
+                const float folded_u = (1.0f - std::abs(v)) * sign_of(u);
+                const float folded_v = (1.0f - std::abs(u)) * sign_of(v);
+
+                u = folded_u, v = folded_v;
+            }
+        }
+
+        math::vec3 decode_octahedral(float u, float v) {
+            float x = u, y = v;
+
+            const float z = 1.0f - std::abs(u) - std::abs(v);
+            if (z < 0.0f) {
+                x = (1.0f - std::abs(v)) * sign_of(u);
+                y = (1.0f - std::abs(u)) * sign_of(v);
+            }
+
+            return math::vec3 { x, y, z }.normalized();
+        }
+
+        // Rows of the table are processed in chunks, small enough to balance
+        static constexpr size_t ROW_GRAIN = 8;
+
+    }
+
+    // ------------------------------------ TERMS --------------------------------------
+
+    shading_terms shading_terms::evaluate(const math::vec3& normal, const math::vec3& to_light,
+                                          const math::vec3& to_view, float shininess) {
+        const float sin_alpha = normal.dot(to_light);
+
+        const math::vec3 mirrored_light = to_light - 2 * sin_alpha * normal;
+        const float sin_phi = mirrored_light.dot(to_view);
+
+        return { std::max(sin_alpha, 0.0f), std::pow(std::max(sin_phi, 0.0f), shininess) };
+    }
+
+    // ------------------------------------- TABLE -------------------------------------
+
+    void shading_lut::build(const math::vec3& to_light, const math::vec3& to_view, float shininess,
+                            int resolution, gl::thread_pool& pool) {
+        m_resolution = resolution;
+        m_shininess = shininess;
+
+        m_to_light = to_light;
+        m_to_view  = to_view;
+
+        m_texels.assign((size_t) resolution * resolution, { 0.0f, 0.0f });
+
+        // Texels sample their centers
+        const float scale = 2.0f / (float) resolution;
+
+        gl::parallel_for(0, resolution, ROW_GRAIN, [&](size_t from, size_t to) {
+            for (size_t row = from; row < to; ++ row)
+                for (size_t column = 0; column < (size_t) resolution; ++ column) {
+                    const math::vec3 normal = decode_octahedral(((float) column + 0.5f) * scale - 1.0f,
+                                                                ((float) row    + 0.5f) * scale - 1.0f);
+
+                    m_texels[row * resolution + column] =
+                        shading_terms::evaluate(normal, m_to_light, m_to_view, m_shininess);
+                }
+        }, pool);
+    }
+
+    shading_terms shading_lut::lookup(const math::vec3& normal) const {
+        float u, v;
+        encode_octahedral(normal, u, v);
+
+        // Continuous texel coordinates, texel centers are at integers
+        const float half_resolution = 0.5f * (float) m_resolution;
+
+        const float column = std::clamp((u + 1.0f) * half_resolution - 0.5f, 0.0f, (float) (m_resolution - 1));
+        const float row    = std::clamp((v + 1.0f) * half_resolution - 0.5f, 0.0f, (float) (m_resolution - 1));
+
+        const int column0 = (int) column, row0 = (int) row;
+        const int column1 = std::min(column0 + 1, m_resolution - 1);
+        const int row1    = std::min(row0    + 1, m_resolution - 1);
+
+        const float weight_u = column - (float) column0;
+        const float weight_v = row    - (float) row0;
+
+        const shading_terms& t00 = m_texels[(size_t) row0 * m_resolution + column0];
+        const shading_terms& t01 = m_texels[(size_t) row0 * m_resolution + column1];
+        const shading_terms& t10 = m_texels[(size_t) row1 * m_resolution + column0];
+        const shading_terms& t11 = m_texels[(size_t) row1 * m_resolution + column1];
+
+        auto filter = [&](float shading_terms::* term) {
+            const float top    = t00.*term + (t01.*term - t00.*term) * weight_u;
+            const float bottom = t10.*term + (t11.*term - t10.*term) * weight_u;
+
+            return top + (bottom - top) * weight_v;
+        };
+
+        return { filter(&shading_terms::diffuse), filter(&shading_terms::specular) };
+    }
+
+    float shading_lut::measure_error(const aabb& bounds, const math::vec3& light_position,
+                                     const math::vec3& view_position, size_t samples) const {
+        if (empty() || bounds.is_empty() || !std::isfinite(bounds.extent().len()))
+            return std::numeric_limits<float>::infinity(); // Nothing to verify against
+
+        // Fixed seed, same config always gets the same verdict
+        std::mt19937 generator(1);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f), symmetric(-1.0f, 1.0f);
+
+        const math::vec3& min = bounds.min;
+        const math::vec3 extent = bounds.extent();
+
+        float max_error = 0.0f;
+        for (size_t i = 0; i < samples; ++ i) {
+            const math::vec3 point = { min.x() + unit(generator) * extent.x(),
+                                       min.y() + unit(generator) * extent.y(),
+                                       min.z() + unit(generator) * extent.z() };
+
+            // Uniform over the sphere: points of the cube that are in the ball, projected
+            const math::vec3 offset = { symmetric(generator), symmetric(generator), symmetric(generator) };
+
+            const float length = offset.len();
+            if (length > 1.0f || length < 1e-3f)
+                continue;
+
+            const math::vec3 normal = offset * (1.0f / length);
+
+            const shading_terms exact = shading_terms::evaluate(normal, (light_position - point).normalized(),
+                                                                (view_position  - point).normalized(), m_shininess);
+            const shading_terms cached = lookup(normal);
+
+            max_error = std::max(max_error, std::abs(exact.diffuse  - cached.diffuse) +
+                                            std::abs(exact.specular - cached.specular));
+        }
+
+        return max_error;
+    }
+
+}
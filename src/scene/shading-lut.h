@@ -0,0 +1,61 @@
+#pragma once
+
+#include "aabb.h"
+#include "thread-pool.h"
+#include "vec.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace raycaster {
+
+    // Lighting terms of a surface point, before light's and material's colors are applied
+    struct shading_terms {
+        float diffuse;
+        float specular;
+
+        // Phong terms for unit normal and unit directions from surface to light and to viewer
+        static shading_terms evaluate(const math::vec3& normal, const math::vec3& to_light,
+                                      const math::vec3& to_view, float shininess);
+    };
+
+    // Shading terms of a light tabulated over every possible normal.
+    //
+    // Terms only depend on normal when directions to light and viewer are the same all
+    // over the surface, that is, when light is distant and view is close to orthographic.
+    // Table is built for directions seen from one point (e.g. center of the scene), and
+    // measure_error tells how far that is from exact terms elsewhere, so that callers
+    // can decide if it's good enough.
+    //
+    // Normals are mapped to the square with octahedral mapping, which covers whole
+    // sphere of directions with texels of roughly equal solid angle
+    class shading_lut {
+    public:
+        static constexpr int DEFAULT_RESOLUTION = 512;
+
+        void build(const math::vec3& to_light, const math::vec3& to_view, float shininess,
+                   int resolution = DEFAULT_RESOLUTION, gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Bilinearly filtered terms for unit normal
+        shading_terms lookup(const math::vec3& normal) const;
+
+        // Largest difference between lookup and exact terms (diffuse and specular ones summed) over
+        // /samples/ random points of /bounds/ with random normals, exact terms see light and viewer
+        // where they really are
+        float measure_error(const aabb& bounds, const math::vec3& light_position,
+                            const math::vec3& view_position, size_t samples) const;
+
+        bool empty() const { return m_texels.empty(); }
+
+    private:
+        int m_resolution = 0;
+        float m_shininess = 0.0f;
+
+        math::vec3 m_to_light { 0.0f, 0.0f, 1.0f };
+        math::vec3 m_to_view  { 0.0f, 0.0f, 1.0f };
+
+        // Texel (u, v) is at v * resolution + u
+        std::vector<shading_terms> m_texels;
+    };
+
+}
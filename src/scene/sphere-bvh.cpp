@@ -0,0 +1,52 @@
+#include "sphere-bvh.h"
+
+namespace raycaster {
+
+    void sphere_bvh::gather_bounds(const sphere_scene& scene, gl::thread_pool& pool) {
+        static constexpr size_t GRAIN = 1 << 14;
+
+        m_sphere_bounds.resize(scene.size());
+        gl::parallel_for(0, scene.size(), GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i)
+                m_sphere_bounds[i] = scene.get_sphere_bounds(i);
+        }, pool);
+    }
+
+    void sphere_bvh::build(const sphere_scene& scene, gl::thread_pool& pool) {
+        gather_bounds(scene, pool);
+        m_bvh.build(m_sphere_bounds, pool);
+    }
+
+    bool sphere_bvh::update(const sphere_scene& scene, float rebuild_threshold, gl::thread_pool& pool) {
+        if (scene.size() != m_bvh.get_primitive_order().size()) {
+            build(scene, pool); // Topology can't follow added or removed spheres
+            return true;
+        }
+
+        gather_bounds(scene, pool);
+        m_bvh.refit(m_sphere_bounds, pool);
+
+        if (m_bvh.get_sah_degradation() <= rebuild_threshold)
+            return false;
+
+        m_bvh.build(m_sphere_bounds, pool);
+        return true;
+    }
+
+    bool sphere_bvh::intersect(const sphere_scene& scene, const ray& current_ray, hit& closest) const {
+        const std::vector<uint32_t>& order = m_bvh.get_primitive_order();
+
+        return m_bvh.intersect(current_ray, closest, [&](uint32_t index, const ray& current_ray, hit& closest) {
+            return scene.intersect(order[index], current_ray, closest);
+        });
+    }
+
+    bool sphere_bvh::occluded(const sphere_scene& scene, const ray& current_ray, float max_distance) const {
+        const std::vector<uint32_t>& order = m_bvh.get_primitive_order();
+
+        return m_bvh.occluded(current_ray, max_distance, [&](uint32_t index, const ray& current_ray, hit& closest) {
+            return scene.intersect(order[index], current_ray, closest);
+        });
+    }
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "aabb.h"
+#include "bvh.h"
+#include "ray.h"
+#include "sphere-scene.h"
+#include "thread-pool.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace raycaster {
+
+    // BVH over sphere scene, unlike uniform grid it can follow moving spheres
+    // by refitting, which is much cheaper than building it again every frame
+    class sphere_bvh {
+    public:
+        // Refitted hierarchy is rebuilt when its SAH cost grows this many times
+        static constexpr float DEFAULT_REBUILD_THRESHOLD = 1.5f;
+
+        void build(const sphere_scene& scene, gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Follows spheres that moved or changed radius (but not added or removed
+        // ones), refits hierarchy and rebuilds it only if refit made it too bad.
+        // Returns whether it was rebuilt
+        bool update(const sphere_scene& scene, float rebuild_threshold = DEFAULT_REBUILD_THRESHOLD,
+                    gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Finds nearest intersection closer than /closest/ and updates it,
+        // /scene/ should be the same one hierarchy was built or updated for
+        bool intersect(const sphere_scene& scene, const ray& current_ray, hit& closest) const;
+
+        // Checks if any sphere is closer than /max_distance/ along the ray
+        bool occluded(const sphere_scene& scene, const ray& current_ray, float max_distance) const;
+
+        aabb get_bounds() const { return m_bvh.get_bounds(); }
+
+        const bvh& get_hierarchy() const { return m_bvh; }
+
+    private:
+        bvh m_bvh;
+
+        std::vector<aabb> m_sphere_bounds; // Kept to avoid allocation every update
+
+        void gather_bounds(const sphere_scene& scene, gl::thread_pool& pool);
+    };
+
+}
@@ -0,0 +1,144 @@
+#include "sphere-scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace raycaster {
+
+    size_t sphere_scene::add_sphere(math::vec3 center, float radius, uint32_t material) {
+        m_center_x.push_back(center.x());
+        m_center_y.push_back(center.y());
+        m_center_z.push_back(center.z());
+
+        m_radius.push_back(radius);
+        m_material.push_back(material);
+
+        return m_radius.size() - 1;
+    }
+
+    void sphere_scene::set_sphere(size_t index, math::vec3 center, float radius) {
+        m_center_x[index] = center.x();
+        m_center_y[index] = center.y();
+        m_center_z[index] = center.z();
+
+        m_radius[index] = radius;
+    }
+
+    void sphere_scene::append(const sphere_scene& other) {
+        m_center_x.insert(m_center_x.end(), other.m_center_x.begin(), other.m_center_x.end());
+        m_center_y.insert(m_center_y.end(), other.m_center_y.begin(), other.m_center_y.end());
+        m_center_z.insert(m_center_z.end(), other.m_center_z.begin(), other.m_center_z.end());
+
+        m_radius.insert(m_radius.end(), other.m_radius.begin(), other.m_radius.end());
+        m_material.insert(m_material.end(), other.m_material.begin(), other.m_material.end());
+    }
+
+    void sphere_scene::reserve(size_t count) {
+        m_center_x.reserve(count), m_center_y.reserve(count), m_center_z.reserve(count);
+        m_radius.reserve(count), m_material.reserve(count);
+    }
+
+    void sphere_scene::clear() {
+        m_center_x.clear(), m_center_y.clear(), m_center_z.clear();
+        m_radius.clear(), m_material.clear();
+    }
+
+    math::vec3 sphere_scene::get_center(size_t index) const {
+        return { m_center_x[index], m_center_y[index], m_center_z[index] };
+    }
+
+    aabb sphere_scene::get_sphere_bounds(size_t index) const {
+        const math::vec3 center = get_center(index);
+        const float radius = m_radius[index];
+
+        return { center - math::vec3 { radius, radius, radius },
+                 center + math::vec3 { radius, radius, radius } };
+    }
+
+    aabb sphere_scene::get_bounds() const {
+        aabb bounds;
+        for (size_t i = 0; i < size(); ++ i)
+            bounds.extend(get_sphere_bounds(i));
+
+        return bounds;
+    }
+
+    bool sphere_scene::intersect(size_t index, const ray& current_ray, hit& closest) const {
+        const math::vec3 center = get_center(index);
+        const float radius = m_radius[index];
+
+        // Solve |origin + t * direction - center|^2 = radius^2 for t,
+        // direction is normalized, so quadratic coefficient is 1:
+        const math::vec3 relative_origin = current_ray.origin - center;
+
+        const float b = relative_origin.dot(current_ray.direction);
+        const float c = relative_origin.dot(relative_origin) - radius * radius;
+
+        const float discriminant = b * b - c;
+        if (discriminant < 0.0f)
+            return false;
+
+        const float root = std::sqrt(discriminant);
+
+        float distance = - b - root; // Near intersection first
+        bool is_inside = false;
+
+        if (distance < ray_epsilon)
+            distance = - b + root, is_inside = true; // Ray starts inside of the sphere
+
+        if (distance < ray_epsilon || distance >= closest.distance)
+            return false;
+
+        closest.distance = distance;
+        closest.position = current_ray.origin + current_ray.direction * distance;
+        closest.normal   = (closest.position - center) * (1.0f / radius);
+        closest.material = m_material[index];
+
+        // Ray passes sqrt(radius^2 - discriminant) from the center, silhouette
+        // is on the radius (there's none to see from the inside)
+        closest.edge_distance = is_inside? std::numeric_limits<float>::infinity() :
+            radius - std::sqrt(std::max(radius * radius - discriminant, 0.0f));
+
+        return true;
+    }
+
+    sphere_scene sphere_scene::load(const std::string& filename) {
+        std::ifstream input_file(filename);
+        if (!input_file)
+            throw std::runtime_error("Failed to open scene file: '" + filename + "'");
+
+        sphere_scene scene;
+
+        std::string line;
+        size_t line_number = 0;
+        while (std::getline(input_file, line)) {
+            ++ line_number;
+
+            // Comments run from '#' to the end of line
+            if (const size_t comment = line.find('#'); comment != std::string::npos)
+                line.erase(comment);
+
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue; // Blank, or comment only
+
+            std::istringstream fields(line);
+
+            float x, y, z, radius;
+            if (!(fields >> x >> y >> z >> radius))
+                throw std::runtime_error("Invalid sphere at " + filename + ":" +
+                                         std::to_string(line_number));
+
+            uint32_t material = 0;
+            fields >> material; // Optional, stays 0 when absent
+
+            scene.add_sphere({ x, y, z }, radius, material);
+        }
+
+        return scene;
+    }
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "aabb.h"
+#include "aligned-allocator.h"
+#include "ray.h"
+#include "vec.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace raycaster {
+
+    // Spheres stored as structure of arrays, every stream is cache line aligned,
+    // so intersectors can sweep over any of them with aligned vector loads
+    class sphere_scene {
+    public:
+        size_t add_sphere(math::vec3 center, float radius, uint32_t material = 0);
+        void set_sphere(size_t index, math::vec3 center, float radius);
+
+        void append(const sphere_scene& other);
+
+        void reserve(size_t count);
+        void clear();
+
+        size_t size() const { return m_radius.size(); }
+        bool empty() const { return m_radius.empty(); }
+
+        // ==> Raw SoA streams:
+
+        const float* center_x() const { return m_center_x.data(); }
+        const float* center_y() const { return m_center_y.data(); }
+        const float* center_z() const { return m_center_z.data(); }
+
+        const float*    radius()   const { return m_radius.data();   }
+        const uint32_t* material() const { return m_material.data(); }
+
+        // ==> Geometry queries:
+
+        math::vec3 get_center(size_t index) const;
+
+        aabb get_sphere_bounds(size_t index) const;
+        aabb get_bounds() const;
+
+        // Updates /closest/ if ray hits sphere /index/ closer than it
+        bool intersect(size_t index, const ray& current_ray, hit& closest) const;
+
+        // Loads scene from text file, where every line describes one sphere as
+        // "x y z radius [material]", # starts a comment, blank lines are ignored
+        static sphere_scene load(const std::string& filename);
+
+    private:
+        gl::aligned_vector<float> m_center_x, m_center_y, m_center_z;
+        gl::aligned_vector<float> m_radius;
+
+        gl::aligned_vector<uint32_t> m_material;
+    };
+
+}
@@ -0,0 +1,232 @@
+#include "uniform-grid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace raycaster {
+
+    // Grid resolution along any axis is clamped, so degenerate
+    // (e.g. flat) scenes can't explode grid's memory footprint
+    static constexpr int MAX_AXIS_RESOLUTION = 256;
+
+    template <typename callback_type>
+    void uniform_grid::for_each_overlapped_cell(const sphere_scene& scene, size_t index,
+                                                callback_type&& callback) const {
+        const float center[3] = { scene.center_x()[index],
+                                  scene.center_y()[index],
+                                  scene.center_z()[index] };
+
+        const float radius = scene.radius()[index];
+
+        int from[3], to[3];
+        for (int axis = 0; axis < 3; ++ axis) {
+            const float min = m_bounds.min[axis];
+
+            from[axis] = (int) std::floor((center[axis] - radius - min) * m_inverse_cell_size[axis]);
+            to  [axis] = (int) std::floor((center[axis] + radius - min) * m_inverse_cell_size[axis]);
+
+            from[axis] = std::clamp(from[axis], 0, m_resolution[axis] - 1);
+            to  [axis] = std::clamp(to  [axis], 0, m_resolution[axis] - 1);
+        }
+
+        for (int z = from[2]; z <= to[2]; ++ z)
+            for (int y = from[1]; y <= to[1]; ++ y)
+                for (int x = from[0]; x <= to[0]; ++ x) {
+                    const int cell[3] = { x, y, z };
+
+                    // Skip cells that only sphere's bounding box overlaps:
+                    float distance_squared = 0.0f;
+                    for (int axis = 0; axis < 3; ++ axis) {
+                        float cell_min = m_bounds.min[axis] + (float) cell[axis] * m_cell_size[axis];
+                        float cell_max = cell_min + m_cell_size[axis];
+
+                        float closest = std::clamp(center[axis], cell_min, cell_max);
+                        distance_squared += (closest - center[axis]) * (closest - center[axis]);
+                    }
+
+                    if (distance_squared <= radius * radius)
+                        callback(get_cell_index(x, y, z));
+                }
+    }
+
+    void uniform_grid::build(const sphere_scene& scene, float density, gl::thread_pool& pool) {
+        m_cell_offsets.clear();
+        m_sphere_indices.clear();
+
+        if (scene.empty())
+            return;
+
+        m_bounds = scene.get_bounds();
+
+        // Pad bounds a little, so that flat scenes still have some volume
+        // and spheres on the boundary don't fall outside because of rounding
+        const math::vec3 extent = m_bounds.extent();
+        const float padding = std::max({ extent.x(), extent.y(), extent.z() }) * 1e-3f + 1e-4f;
+
+        m_bounds.min -= math::vec3 { padding, padding, padding };
+        m_bounds.max += math::vec3 { padding, padding, padding };
+
+        // ==> Choose resolution so cells are close to cubes and there's
+        //     about /density/ of them per sphere:
+
+        const math::vec3 size = m_bounds.extent();
+        const float volume = size.x() * size.y() * size.z();
+
+        const float cells_per_unit = std::cbrt(density * (float) scene.size() / volume);
+        for (int axis = 0; axis < 3; ++ axis) {
+            m_resolution[axis] = std::clamp((int) std::ceil(size[axis] * cells_per_unit),
+                                            1, MAX_AXIS_RESOLUTION);
+
+            m_cell_size[axis] = size[axis] / (float) m_resolution[axis];
+            m_inverse_cell_size[axis] = 1.0f / m_cell_size[axis];
+        }
+
+        const size_t cell_count = get_cell_index(0, 0, m_resolution[2]);
+
+        // ==> Count spheres per cell in parallel:
+
+        static constexpr size_t SPHERE_GRAIN = 1024, CELL_GRAIN = 4096;
+
+        std::vector<std::atomic<uint32_t>> counters(cell_count);
+        gl::parallel_for(0, scene.size(), SPHERE_GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i)
+                for_each_overlapped_cell(scene, i, [&](size_t cell) {
+                    counters[cell].fetch_add(1, std::memory_order_relaxed);
+                });
+        }, pool);
+
+        // ==> Turn counts into offsets (exclusive prefix sum):
+
+        m_cell_offsets.resize(cell_count + 1);
+
+        uint32_t total = 0;
+        for (size_t cell = 0; cell < cell_count; ++ cell) {
+            m_cell_offsets[cell] = total;
+            total += counters[cell].exchange(0, std::memory_order_relaxed);
+        }
+
+        m_cell_offsets[cell_count] = total;
+
+        // ==> Scatter sphere indices into their cells in parallel:
+
+        m_sphere_indices.resize(total);
+        gl::parallel_for(0, scene.size(), SPHERE_GRAIN, [&](size_t from, size_t to) {
+            for (size_t i = from; i < to; ++ i)
+                for_each_overlapped_cell(scene, i, [&](size_t cell) {
+                    uint32_t slot = counters[cell].fetch_add(1, std::memory_order_relaxed);
+                    m_sphere_indices[m_cell_offsets[cell] + slot] = (uint32_t) i;
+                });
+        }, pool);
+
+        // Scatter order depends on scheduling, sort cells to make it deterministic
+        // (this also makes traversal read scene's streams in increasing order)
+        gl::parallel_for(0, cell_count, CELL_GRAIN, [&](size_t from, size_t to) {
+            for (size_t cell = from; cell < to; ++ cell)
+                std::sort(m_sphere_indices.begin() + m_cell_offsets[cell],
+                          m_sphere_indices.begin() + m_cell_offsets[cell + 1]);
+        }, pool);
+    }
+
+    bool uniform_grid::intersect(const sphere_scene& scene, const ray& current_ray, hit& closest) const {
+        return traverse<false>(scene, current_ray, closest);
+    }
+
+    bool uniform_grid::occluded(const sphere_scene& scene, const ray& current_ray, float max_distance) const {
+        hit closest;
+        closest.distance = max_distance;
+
+        return traverse<true>(scene, current_ray, closest);
+    }
+
+    template <bool is_any_hit>
+    bool uniform_grid::traverse(const sphere_scene& scene, const ray& current_ray, hit& closest) const {
+        if (m_cell_offsets.empty())
+            return false;
+
+        const float origin[3]    = { current_ray.origin.x(),    current_ray.origin.y(),    current_ray.origin.z()    };
+        const float direction[3] = { current_ray.direction.x(), current_ray.direction.y(), current_ray.direction.z() };
+
+        // ==> Clip ray with grid's bounds (slab test):
+
+        float t_enter = 0.0f, t_exit = closest.distance;
+        for (int axis = 0; axis < 3; ++ axis) {
+            const float inverse_direction = 1.0f / direction[axis];
+
+            float t_near = (m_bounds.min[axis] - origin[axis]) * inverse_direction;
+            float t_far  = (m_bounds.max[axis] - origin[axis]) * inverse_direction;
+
+            if (t_near > t_far)
+                std::swap(t_near, t_far);
+
+            // Written this way to stay false for NaN, which appears when ray
+            // is parallel to the slab and starts exactly on its boundary
+            t_enter = t_near > t_enter? t_near : t_enter;
+            t_exit  = t_far  < t_exit?  t_far  : t_exit;
+        }
+
+        if (t_enter > t_exit)
+            return false;
+
+        // ==> Setup 3D DDA (Amanatides & Woo):
+
+        int cell[3], step[3], end[3];
+        float t_next[3], t_delta[3];
+
+        for (int axis = 0; axis < 3; ++ axis) {
+            const float entry = origin[axis] + direction[axis] * t_enter;
+
+            cell[axis] = (int) std::floor((entry - m_bounds.min[axis]) * m_inverse_cell_size[axis]);
+            cell[axis] = std::clamp(cell[axis], 0, m_resolution[axis] - 1);
+
+            if (direction[axis] > 0.0f) {
+                step[axis] = 1, end[axis] = m_resolution[axis];
+
+                float boundary = m_bounds.min[axis] + (float) (cell[axis] + 1) * m_cell_size[axis];
+                t_next [axis] = (boundary - origin[axis]) / direction[axis];
+                t_delta[axis] = m_cell_size[axis] / direction[axis];
+            } else if (direction[axis] < 0.0f) {
+                step[axis] = -1, end[axis] = -1;
+
+                float boundary = m_bounds.min[axis] + (float) cell[axis] * m_cell_size[axis];
+                t_next [axis] = (boundary - origin[axis]) / direction[axis];
+                t_delta[axis] = - m_cell_size[axis] / direction[axis];
+            } else {
+                step[axis] = 0, end[axis] = -1;
+
+                t_next [axis] = std::numeric_limits<float>::infinity();
+                t_delta[axis] = std::numeric_limits<float>::infinity();
+            }
+        }
+
+        bool is_hit = false;
+        while (true) {
+            const size_t cell_index = get_cell_index(cell[0], cell[1], cell[2]);
+            for (uint32_t i = m_cell_offsets[cell_index]; i < m_cell_offsets[cell_index + 1]; ++ i) {
+                is_hit |= scene.intersect(m_sphere_indices[i], current_ray, closest);
+
+                if (is_any_hit && is_hit)
+                    return true; // Any occluder will do, no need to look for the nearest
+            }
+
+            // Next cell to visit is behind the axis boundary that is crossed first
+            int axis = t_next[0] < t_next[1]? (t_next[0] < t_next[2]? 0 : 2)
+                                            : (t_next[1] < t_next[2]? 1 : 2);
+
+            // Sphere can span several cells, so hit found here may lie in farther cell
+            // and closer sphere can still be ahead, only hits inside this cell are final:
+            if (closest.distance <= t_next[axis] || t_next[axis] > t_exit)
+                break;
+
+            cell[axis] += step[axis];
+            if (cell[axis] == end[axis])
+                break;
+
+            t_next[axis] += t_delta[axis];
+        }
+
+        return is_hit;
+    }
+
+}
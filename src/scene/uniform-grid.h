@@ -0,0 +1,59 @@
+#pragma once
+
+#include "aabb.h"
+#include "ray.h"
+#include "sphere-scene.h"
+#include "thread-pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace raycaster {
+
+    // Uniform grid over sphere scene, cells store indices of all spheres that
+    // overlap them in one flat array (compressed like CSR sparse matrices)
+    class uniform_grid {
+    public:
+        // Average number of cells per sphere, trades memory for traversal speed
+        static constexpr float DEFAULT_DENSITY = 4.0f;
+
+        void build(const sphere_scene& scene, float density = DEFAULT_DENSITY,
+                   gl::thread_pool& pool = gl::thread_pool::global());
+
+        // Finds nearest intersection closer than /closest/ and updates it,
+        // /scene/ should be the same one (and unchanged) grid was built for
+        bool intersect(const sphere_scene& scene, const ray& current_ray, hit& closest) const;
+
+        // Checks if anything is closer than /max_distance/ along the ray, stops at the
+        // first such sphere, whichever it is, so it's cheaper than intersect (for shadows)
+        bool occluded(const sphere_scene& scene, const ray& current_ray, float max_distance) const;
+
+        size_t get_cell_count() const { return m_cell_offsets.empty()? 0 : m_cell_offsets.size() - 1; }
+        const aabb& get_bounds() const { return m_bounds; }
+
+    private:
+        aabb m_bounds;
+
+        int m_resolution[3] = { 0, 0, 0 };
+        float m_cell_size[3], m_inverse_cell_size[3];
+
+        // Spheres of cell i are m_sphere_indices[m_cell_offsets[i] ... m_cell_offsets[i + 1]]
+        std::vector<uint32_t> m_cell_offsets;
+        std::vector<uint32_t> m_sphere_indices;
+
+        size_t get_cell_index(int x, int y, int z) const {
+            return ((size_t) z * (size_t) m_resolution[1] + (size_t) y) * (size_t) m_resolution[0] + (size_t) x;
+        }
+
+        // Nearest hit search or, when /is_any_hit/, search for any hit at all
+        template <bool is_any_hit>
+        bool traverse(const sphere_scene& scene, const ray& current_ray, hit& closest) const;
+
+        // Calls callback(cell_index) for every cell sphere /index/ actually touches
+        template <typename callback_type>
+        void for_each_overlapped_cell(const sphere_scene& scene, size_t index,
+                                      callback_type&& callback) const;
+    };
+
+}
@@ -0,0 +1,314 @@
+#include "sdf-tracer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace raycaster {
+
+    // ---------------------------------- RAY CONE -------------------------------------
+
+    ray_cone ray_cone::enclose(const ray_packet* packets, size_t count) {
+        float origin[3] = {}, direction[3] = {};
+        int ray_count = 0;
+
+        for (size_t i = 0; i < count; ++ i)
+            for (int lane = 0; lane < packets[i].count; ++ lane, ++ ray_count)
+                for (int axis = 0; axis < 3; ++ axis) {
+                    origin   [axis] += packets[i].origin   [axis][lane];
+                    direction[axis] += packets[i].direction[axis][lane];
+                }
+
+        ray_cone cone;
+        if (ray_count == 0)
+            return cone;
+
+        const float direction_length = std::sqrt(direction[0] * direction[0] +
+                                                  direction[1] * direction[1] +
+                                                  direction[2] * direction[2]);
+
+        for (int axis = 0; axis < 3; ++ axis) {
+            origin[axis] /= (float) ray_count;
+            direction[axis] /= direction_length;
+        }
+
+        cone.axis = { { origin[0], origin[1], origin[2] }, { direction[0], direction[1], direction[2] } };
+
+        // Points at distance t on two rays are at most |Δorigin| + t |Δdirection| apart
+        for (size_t i = 0; i < count; ++ i)
+            for (int lane = 0; lane < packets[i].count; ++ lane) {
+                float origin_offset = 0.0f, direction_offset = 0.0f;
+
+                for (int axis = 0; axis < 3; ++ axis) {
+                    float delta_origin    = packets[i].origin   [axis][lane] - origin   [axis];
+                    float delta_direction = packets[i].direction[axis][lane] - direction[axis];
+
+                    origin_offset    += delta_origin    * delta_origin;
+                    direction_offset += delta_direction * delta_direction;
+                }
+
+                cone.base_radius = std::max(cone.base_radius, std::sqrt(origin_offset));
+                cone.spread      = std::max(cone.spread,      std::sqrt(direction_offset));
+            }
+
+        return cone;
+    }
+
+    // ---------------------------------- SDF TRACER -----------------------------------
+
+    sdf_tracer::sdf_tracer(sdf field, sdf_trace_settings settings)
+        : m_field(std::move(field)), m_settings(settings) {}
+
+    namespace {
+
+        bool is_finite(const aabb& bounds) {
+            for (int axis = 0; axis < 3; ++ axis)
+                if (!std::isfinite(bounds.min[axis]) || !std::isfinite(bounds.max[axis]))
+                    return false;
+
+            return true;
+        }
+
+    }
+
+    float sdf_tracer::get_far(const ray_cone& cone) const {
+        const aabb& bounds = m_field.get_bounds();
+        if (!is_finite(bounds))
+            return m_settings.max_distance;
+
+        // Distance to the farthest corner of bounds is enough for every ray
+        float far = 0.0f;
+        for (int corner = 0; corner < 8; ++ corner) {
+            const math::vec3 point = {
+                corner & 1? bounds.max.x() : bounds.min.x(),
+                corner & 2? bounds.max.y() : bounds.min.y(),
+                corner & 4? bounds.max.z() : bounds.min.z()
+            };
+
+            const math::vec3 offset = point - cone.axis.origin;
+            far = std::max(far, std::sqrt(offset.dot(offset)));
+        }
+
+        return std::min(far + cone.base_radius, m_settings.max_distance);
+    }
+
+    float sdf_tracer::find_cone_start(const ray_cone& cone) const {
+        // Stop when steps get that small relative to cone's width, rays
+        // will do the rest of the way better on their own
+        static constexpr float MIN_PROGRESS = 0.05f;
+
+        const float far = get_far(cone);
+
+        const float origin[3]    = { cone.axis.origin.x(),    cone.axis.origin.y(),    cone.axis.origin.z()    };
+        const float direction[3] = { cone.axis.direction.x(), cone.axis.direction.y(), cone.axis.direction.z() };
+
+        float t = 0.0f;
+        for (int step = 0; step < m_settings.max_steps && t < far; ++ step) {
+            const float point[3] = { origin[0] + direction[0] * t,
+                                     origin[1] + direction[1] * t,
+                                     origin[2] + direction[2] * t };
+
+            // Every ray's point at distance t is within /radius/ of the axis' one,
+            // and field is 1-Lipschitz, so all of them are at least /gap/ from surface
+            const float radius = cone.base_radius + cone.spread * t;
+            const float gap = m_field.evaluate(point) - radius;
+
+            if (gap < std::max(m_settings.hit_distance, radius * MIN_PROGRESS))
+                return t;
+
+            t += gap;
+        }
+
+        return std::min(t, far);
+    }
+
+    __m256 sdf_tracer::get_far(const ray_packet& rays) const {
+        __m256 far = _mm256_set1_ps(m_settings.max_distance);
+
+        const aabb& bounds = m_field.get_bounds();
+        if (!is_finite(bounds))
+            return far;
+
+        // Distance to the farthest corner of bounds is enough for every lane
+        __m256 farthest = _mm256_setzero_ps();
+        for (int corner = 0; corner < 8; ++ corner) {
+            __m256 offset_x = _mm256_sub_ps(_mm256_set1_ps(corner & 1? bounds.max.x() : bounds.min.x()), _mm256_load_ps(rays.origin[0]));
+            __m256 offset_y = _mm256_sub_ps(_mm256_set1_ps(corner & 2? bounds.max.y() : bounds.min.y()), _mm256_load_ps(rays.origin[1]));
+            __m256 offset_z = _mm256_sub_ps(_mm256_set1_ps(corner & 4? bounds.max.z() : bounds.min.z()), _mm256_load_ps(rays.origin[2]));
+
+            __m256 distance_squared = _mm256_add_ps(_mm256_mul_ps(offset_x, offset_x),
+                                      _mm256_add_ps(_mm256_mul_ps(offset_y, offset_y),
+                                                    _mm256_mul_ps(offset_z, offset_z)));
+
+            farthest = _mm256_max_ps(farthest, distance_squared);
+        }
+
+        return _mm256_min_ps(far, _mm256_sqrt_ps(farthest));
+    }
+
+    int sdf_tracer::march(const ray_packet& rays, float start, __m256 far, __m256& t) const {
+        __m256 origins[3], directions[3];
+        for (int axis = 0; axis < 3; ++ axis) {
+            origins   [axis] = _mm256_load_ps(rays.origin   [axis]);
+            directions[axis] = _mm256_load_ps(rays.direction[axis]);
+        }
+
+        // ==> Over-relaxed sphere tracing of all lanes together:
+
+        const __m256 one  = _mm256_set1_ps(1.0f);
+        const __m256 zero = _mm256_setzero_ps();
+
+        const __m256 hit_distance = _mm256_set1_ps(m_settings.hit_distance);
+        const __m256 hit_spread   = _mm256_set1_ps(m_settings.hit_spread);
+
+        t = _mm256_set1_ps(start);
+        __m256 previous_t = t;
+        __m256 previous_radius = zero, step = zero;
+
+        __m256 relaxation = _mm256_set1_ps(m_settings.relaxation);
+
+        const __m256i lane_indices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256 active = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(rays.count), lane_indices));
+
+        __m256 is_hit = zero;
+
+        for (int iteration = 0; iteration < m_settings.max_steps; ++ iteration) {
+            if (_mm256_movemask_ps(active) == 0)
+                break;
+
+            __m256 x = _mm256_add_ps(origins[0], _mm256_mul_ps(directions[0], t));
+            __m256 y = _mm256_add_ps(origins[1], _mm256_mul_ps(directions[1], t));
+            __m256 z = _mm256_add_ps(origins[2], _mm256_mul_ps(directions[2], t));
+
+            const __m256 distance = m_field.evaluate(x, y, z);
+            const __m256 radius = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), distance);
+
+            // Relaxed step overshot if unbounding spheres of two last points don't overlap
+            const __m256 is_overshot = _mm256_and_ps(_mm256_cmp_ps(relaxation, one, _CMP_GT_OQ),
+                _mm256_cmp_ps(_mm256_add_ps(radius, previous_radius), step, _CMP_LT_OQ));
+
+            const __m256 threshold = _mm256_add_ps(hit_distance, _mm256_mul_ps(hit_spread, t));
+
+            // Surface past /far/ doesn't count (shadow rays must not look behind the light)
+            const __m256 is_new_miss = _mm256_and_ps(active, _mm256_cmp_ps(t, far, _CMP_GT_OQ));
+
+            const __m256 is_new_hit = _mm256_andnot_ps(_mm256_or_ps(is_overshot, is_new_miss),
+                _mm256_and_ps(active, _mm256_cmp_ps(distance, threshold, _CMP_LT_OQ)));
+
+            is_hit = _mm256_or_ps(is_hit, is_new_hit);
+            active = _mm256_andnot_ps(_mm256_or_ps(is_new_hit, is_new_miss), active);
+
+            // Overshot lanes go back to the last safe step and stop relaxing
+            const __m256 relaxed_step = _mm256_mul_ps(relaxation, distance);
+
+            const __m256 next_t = _mm256_blendv_ps(_mm256_add_ps(t, relaxed_step),
+                                                   _mm256_add_ps(previous_t, previous_radius), is_overshot);
+
+            previous_t      = _mm256_blendv_ps(t,      previous_t,      is_overshot);
+            previous_radius = _mm256_blendv_ps(radius, previous_radius, is_overshot);
+
+            step       = _mm256_blendv_ps(relaxed_step, zero, is_overshot);
+            relaxation = _mm256_blendv_ps(relaxation,   one,  is_overshot);
+
+            t = _mm256_blendv_ps(t, next_t, active);
+        }
+
+        return _mm256_movemask_ps(is_hit);
+    }
+
+    int sdf_tracer::trace(const ray_packet& rays, float start, hit hits[ray_packet::SIZE]) const {
+        __m256 t;
+        const int hit_mask = march(rays, start, get_far(rays), t);
+        if (hit_mask == 0)
+            return 0;
+
+        __m256 origins[3], directions[3];
+        for (int axis = 0; axis < 3; ++ axis) {
+            origins   [axis] = _mm256_load_ps(rays.origin   [axis]);
+            directions[axis] = _mm256_load_ps(rays.direction[axis]);
+        }
+
+        // ==> Normals from tetrahedral differences (4 evaluations instead of 6):
+
+        const float epsilon = m_settings.hit_distance;
+
+        __m256 x = _mm256_add_ps(origins[0], _mm256_mul_ps(directions[0], t));
+        __m256 y = _mm256_add_ps(origins[1], _mm256_mul_ps(directions[1], t));
+        __m256 z = _mm256_add_ps(origins[2], _mm256_mul_ps(directions[2], t));
+
+        static constexpr float TETRAHEDRON[4][3] = {
+            {  1.0f, -1.0f, -1.0f }, { -1.0f, -1.0f,  1.0f },
+            { -1.0f,  1.0f, -1.0f }, {  1.0f,  1.0f,  1.0f }
+        };
+
+        const __m256 zero = _mm256_setzero_ps();
+
+        __m256 gradient[3] = { zero, zero, zero };
+        for (const auto& vertex: TETRAHEDRON) {
+            __m256 value = m_field.evaluate(
+                _mm256_add_ps(x, _mm256_set1_ps(vertex[0] * epsilon)),
+                _mm256_add_ps(y, _mm256_set1_ps(vertex[1] * epsilon)),
+                _mm256_add_ps(z, _mm256_set1_ps(vertex[2] * epsilon)));
+
+            for (int axis = 0; axis < 3; ++ axis)
+                gradient[axis] = _mm256_add_ps(gradient[axis], _mm256_mul_ps(_mm256_set1_ps(vertex[axis]), value));
+        }
+
+        alignas(32) float distances[ray_packet::SIZE], normals[3][ray_packet::SIZE];
+
+        _mm256_store_ps(distances, t);
+        for (int axis = 0; axis < 3; ++ axis)
+            _mm256_store_ps(normals[axis], gradient[axis]);
+
+        for (int lane = 0; lane < ray_packet::SIZE; ++ lane) {
+            if (!(hit_mask & (1 << lane)))
+                continue;
+
+            hit& current = hits[lane];
+
+            current.distance = distances[lane];
+            current.position = {
+                rays.origin[0][lane] + rays.direction[0][lane] * distances[lane],
+                rays.origin[1][lane] + rays.direction[1][lane] * distances[lane],
+                rays.origin[2][lane] + rays.direction[2][lane] * distances[lane]
+            };
+
+            const float normal[3] = { normals[0][lane], normals[1][lane], normals[2][lane] };
+            const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            const float scale = length > 0.0f? 1.0f / length : 0.0f;
+
+            current.normal = { normal[0] * scale, normal[1] * scale, normal[2] * scale };
+
+            const float position[3] = { current.position.x(), current.position.y(), current.position.z() };
+            m_field.evaluate(position, current.material);
+
+            current.edge_distance = std::numeric_limits<float>::infinity();
+        }
+
+        return hit_mask;
+    }
+
+    int sdf_tracer::occluded(const ray_packet& rays, const float max_distances[ray_packet::SIZE]) const {
+        __m256 t;
+        return march(rays, 0.0f, _mm256_min_ps(get_far(rays), _mm256_loadu_ps(max_distances)), t);
+    }
+
+    bool sdf_tracer::trace(const ray& current_ray, hit& closest) const {
+        ray_packet packet;
+
+        packet.count = 1;
+        packet.set_ray(0, current_ray);
+        packet.pad();
+
+        hit hits[ray_packet::SIZE];
+
+        const float start = find_cone_start({ current_ray, 0.0f, 0.0f });
+        if (!(trace(packet, start, hits) & 1) || hits[0].distance >= closest.distance)
+            return false;
+
+        closest = hits[0];
+        return true;
+    }
+
+}
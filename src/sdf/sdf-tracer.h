@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ray.h"
+#include "sdf.h"
+
+#include <cstddef>
+
+namespace raycaster {
+
+    struct sdf_trace_settings {
+        // Steps are this much longer than distance field allows, and fall
+        // back to safe ones on overshoot (over-relaxed sphere tracing)
+        float relaxation = 1.6f;
+
+        // Ray hits surface once field is below hit_distance + hit_spread * t,
+        // spread lets threshold follow pixel's footprint for perspective rays
+        float hit_distance = 1e-3f;
+        float hit_spread   = 0.0f;
+
+        int max_steps = 128;
+
+        // How far rays go when field has no finite bounds
+        float max_distance = 100.0f;
+    };
+
+    // All rays of a tile fit in it: at distance t along any of them point is
+    // within base_radius + spread * t of point at the same distance on axis
+    struct ray_cone {
+        ray axis = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+
+        float base_radius = 0.0f;
+        float spread = 0.0f;
+
+        static ray_cone enclose(const ray_packet* packets, size_t count);
+    };
+
+    // Sphere traces signed distance field, 8 rays at a time
+    class sdf_tracer {
+    public:
+        explicit sdf_tracer(sdf field, sdf_trace_settings settings = {});
+
+        // Traces rays of the packet starting at distance /start/ along them (found by
+        // find_cone_start), fills hits of lanes that hit, returns bit mask of them
+        int trace(const ray_packet& rays, float start, hit hits[ray_packet::SIZE]) const;
+
+        bool trace(const ray& current_ray, hit& closest) const;
+
+        // Checks which rays of the packet hit anything closer than their max
+        // distance, returns bit mask of them (rays are expected to start off surface)
+        int occluded(const ray_packet& rays, const float max_distances[ray_packet::SIZE]) const;
+
+        // How far all rays in the cone can go without hitting anything, which
+        // lets them skip empty space together. Result isn't less than get_far()
+        // if none of the rays can hit anything at all
+        float find_cone_start(const ray_cone& cone) const;
+
+        // Farthest any ray of the cone needs to go
+        float get_far(const ray_cone& cone) const;
+
+        const sdf& get_field() const { return m_field; }
+        const sdf_trace_settings& get_settings() const { return m_settings; }
+
+    private:
+        sdf m_field;
+        sdf_trace_settings m_settings;
+
+        // Farthest distance every ray of the packet has to go
+        __m256 get_far(const ray_packet& rays) const;
+
+        // Sphere traces packet until every ray hits or goes past /far/, stores
+        // where rays stopped in /t/ and returns bit mask of hits
+        int march(const ray_packet& rays, float start, __m256 far, __m256& t) const;
+    };
+
+}
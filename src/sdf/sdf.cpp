@@ -0,0 +1,346 @@
+#include "sdf.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace raycaster {
+
+    // ------------------------------------ LANE MATH ----------------------------------
+
+    namespace {
+
+        // Thin wrapper that lets distance functions be written once for both
+        // scalars and packets of 8 values, operations on it are just AVX ops
+        struct packet {
+            __m256 value;
+        };
+
+        packet operator+(packet lhs, packet rhs) { return { _mm256_add_ps(lhs.value, rhs.value) }; }
+        packet operator-(packet lhs, packet rhs) { return { _mm256_sub_ps(lhs.value, rhs.value) }; }
+        packet operator*(packet lhs, packet rhs) { return { _mm256_mul_ps(lhs.value, rhs.value) }; }
+        packet operator/(packet lhs, packet rhs) { return { _mm256_div_ps(lhs.value, rhs.value) }; }
+
+        packet lane_min(packet lhs, packet rhs) { return { _mm256_min_ps(lhs.value, rhs.value) }; }
+        packet lane_max(packet lhs, packet rhs) { return { _mm256_max_ps(lhs.value, rhs.value) }; }
+
+        packet lane_sqrt(packet value) { return { _mm256_sqrt_ps(value.value) }; }
+
+        packet lane_abs(packet value) {
+            return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), value.value) };
+        }
+
+        float lane_min(float lhs, float rhs) { return std::min(lhs, rhs); }
+        float lane_max(float lhs, float rhs) { return std::max(lhs, rhs); }
+
+        float lane_sqrt(float value) { return std::sqrt(value); }
+        float lane_abs (float value) { return std::abs(value);  }
+
+        template <typename value_type>
+        value_type splat(float value) {
+            if constexpr (std::is_same_v<value_type, packet>)
+                return { _mm256_set1_ps(value) };
+            else
+                return value;
+        }
+
+        template <typename value_type>
+        value_type length(value_type x, value_type y) {
+            return lane_sqrt(x * x + y * y);
+        }
+
+        template <typename value_type>
+        value_type length(value_type x, value_type y, value_type z) {
+            return lane_sqrt(x * x + y * y + z * z);
+        }
+
+        template <typename value_type>
+        value_type clamp_unit(value_type value) {
+            return lane_min(lane_max(value, splat<value_type>(0.0f)), splat<value_type>(1.0f));
+        }
+
+        constexpr float INFINITY_VALUE = std::numeric_limits<float>::infinity();
+
+        aabb infinite_bounds() {
+            return { { -INFINITY_VALUE, -INFINITY_VALUE, -INFINITY_VALUE },
+                     {  INFINITY_VALUE,  INFINITY_VALUE,  INFINITY_VALUE } };
+        }
+
+        aabb inflate(const aabb& bounds, float amount) {
+            const math::vec3 margin = { amount, amount, amount };
+            return { bounds.min - margin, bounds.max + margin };
+        }
+
+    }
+
+    // ------------------------------------ BUILDING -----------------------------------
+
+    sdf sdf::primitive(const instruction& current, const aabb& bounds) {
+        sdf result;
+
+        result.m_program.push_back(current);
+        result.m_stack_depth = 1;
+        result.m_bounds = bounds;
+
+        return result;
+    }
+
+    sdf sdf::combine(const sdf& lhs, const sdf& rhs, const instruction& operation,
+                     const aabb& bounds) {
+        sdf result;
+
+        // Left operand's value waits on the stack while right one is evaluated
+        result.m_stack_depth = std::max(lhs.m_stack_depth, rhs.m_stack_depth + 1);
+        if (result.m_stack_depth > MAX_STACK_DEPTH)
+            throw std::runtime_error("SDF is nested too deep, maximum stack depth is " +
+                                     std::to_string(MAX_STACK_DEPTH));
+
+        result.m_program.reserve(lhs.m_program.size() + rhs.m_program.size() + 1);
+
+        result.m_program.insert(result.m_program.end(), lhs.m_program.begin(), lhs.m_program.end());
+        result.m_program.insert(result.m_program.end(), rhs.m_program.begin(), rhs.m_program.end());
+        result.m_program.push_back(operation);
+
+        result.m_bounds = bounds;
+        return result;
+    }
+
+    sdf sdf::sphere(math::vec3 center, float radius, uint32_t material) {
+        const math::vec3 extent = { radius, radius, radius };
+
+        return primitive({ opcode::SPHERE, material, { center.x(), center.y(), center.z(), radius } },
+                         { center - extent, center + extent });
+    }
+
+    sdf sdf::box(math::vec3 center, math::vec3 half_extent, uint32_t material) {
+        return primitive({ opcode::BOX, material, { center.x(), center.y(), center.z(),
+                                                    half_extent.x(), half_extent.y(), half_extent.z() } },
+                         { center - half_extent, center + half_extent });
+    }
+
+    sdf sdf::torus(math::vec3 center, float major_radius, float minor_radius, uint32_t material) {
+        const float outer = major_radius + minor_radius;
+        const math::vec3 extent = { outer, minor_radius, outer };
+
+        return primitive({ opcode::TORUS, material, { center.x(), center.y(), center.z(),
+                                                      major_radius, minor_radius } },
+                         { center - extent, center + extent });
+    }
+
+    sdf sdf::capsule(math::vec3 from, math::vec3 to, float radius, uint32_t material) {
+        aabb bounds;
+        bounds.extend(from), bounds.extend(to);
+
+        return primitive({ opcode::CAPSULE, material, { from.x(), from.y(), from.z(),
+                                                        to.x(),   to.y(),   to.z(), radius } },
+                         inflate(bounds, radius));
+    }
+
+    sdf sdf::plane(math::vec3 normal, float offset, uint32_t material) {
+        return primitive({ opcode::PLANE, material, { normal.x(), normal.y(), normal.z(), offset } },
+                         infinite_bounds());
+    }
+
+    sdf sdf::unite(const sdf& lhs, const sdf& rhs) {
+        aabb bounds = lhs.m_bounds;
+        bounds.extend(rhs.m_bounds);
+
+        return combine(lhs, rhs, { opcode::UNITE, 0, {} }, bounds);
+    }
+
+    sdf sdf::intersect(const sdf& lhs, const sdf& rhs) {
+        const aabb& left = lhs.m_bounds, & right = rhs.m_bounds;
+
+        aabb bounds;
+        for (int axis = 0; axis < 3; ++ axis) {
+            bounds.min[axis] = std::max(left.min[axis], right.min[axis]);
+            bounds.max[axis] = std::min(left.max[axis], right.max[axis]);
+        }
+
+        return combine(lhs, rhs, { opcode::INTERSECT, 0, {} }, bounds);
+    }
+
+    sdf sdf::subtract(const sdf& lhs, const sdf& rhs) {
+        return combine(lhs, rhs, { opcode::SUBTRACT, 0, {} }, lhs.m_bounds);
+    }
+
+    sdf sdf::smooth_unite(const sdf& lhs, const sdf& rhs, float smoothness) {
+        aabb bounds = lhs.m_bounds;
+        bounds.extend(rhs.m_bounds);
+
+        // Polynomial smooth minimum is at most smoothness / 4 below the plain one
+        return combine(lhs, rhs, { opcode::SMOOTH_UNITE, 0, { smoothness } },
+                       inflate(bounds, smoothness * 0.25f));
+    }
+
+    // ----------------------------------- EVALUATION ----------------------------------
+
+    template <typename value_type>
+    value_type sdf::run(value_type x, value_type y, value_type z, uint32_t* material) const {
+        value_type stack[MAX_STACK_DEPTH];
+        uint32_t materials[MAX_STACK_DEPTH];
+
+        int top = 0;
+
+        for (const instruction& current: m_program) {
+            const float* parameters = current.parameters;
+            auto parameter = [&](int index) { return splat<value_type>(parameters[index]); };
+
+            // Relative to primitive's center (first three parameters for most of them)
+            auto relative = [&](value_type& rx, value_type& ry, value_type& rz) {
+                rx = x - parameter(0), ry = y - parameter(1), rz = z - parameter(2);
+            };
+
+            value_type distance;
+            switch (current.code) {
+            case opcode::SPHERE: {
+                value_type rx, ry, rz; relative(rx, ry, rz);
+                distance = length(rx, ry, rz) - parameter(3);
+                break;
+            }
+
+            case opcode::BOX: {
+                value_type rx, ry, rz; relative(rx, ry, rz);
+
+                value_type qx = lane_abs(rx) - parameter(3);
+                value_type qy = lane_abs(ry) - parameter(4);
+                value_type qz = lane_abs(rz) - parameter(5);
+
+                const value_type zero = splat<value_type>(0.0f);
+
+                value_type outside = length(lane_max(qx, zero), lane_max(qy, zero), lane_max(qz, zero));
+                value_type inside  = lane_min(lane_max(qx, lane_max(qy, qz)), zero);
+
+                distance = outside + inside;
+                break;
+            }
+
+            case opcode::TORUS: {
+                value_type rx, ry, rz; relative(rx, ry, rz);
+
+                value_type ring = length(rx, rz) - parameter(3);
+                distance = length(ring, ry) - parameter(4);
+                break;
+            }
+
+            case opcode::CAPSULE: {
+                value_type rx, ry, rz; relative(rx, ry, rz);
+
+                const float axis[3] = { parameters[3] - parameters[0],
+                                        parameters[4] - parameters[1],
+                                        parameters[5] - parameters[2] };
+
+                const float axis_length_squared = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+                const float inverse = axis_length_squared > 0.0f? 1.0f / axis_length_squared : 0.0f;
+
+                const value_type ax = splat<value_type>(axis[0]);
+                const value_type ay = splat<value_type>(axis[1]);
+                const value_type az = splat<value_type>(axis[2]);
+
+                // Closest point on the segment:
+                value_type h = clamp_unit((rx * ax + ry * ay + rz * az) * splat<value_type>(inverse));
+                distance = length(rx - ax * h, ry - ay * h, rz - az * h) - parameter(6);
+                break;
+            }
+
+            case opcode::PLANE:
+                distance = x * parameter(0) + y * parameter(1) + z * parameter(2) - parameter(3);
+                break;
+
+            default: {
+                // Binary operation, pops two operands:
+                const value_type rhs = stack[-- top];
+                const value_type lhs = stack[-- top];
+
+                bool is_left = true; // Whose material the result gets
+                switch (current.code) {
+                case opcode::UNITE:
+                    distance = lane_min(lhs, rhs);
+                    if constexpr (std::is_same_v<value_type, float>)
+                        is_left = lhs <= rhs;
+
+                    break;
+
+                case opcode::INTERSECT:
+                    distance = lane_max(lhs, rhs);
+                    if constexpr (std::is_same_v<value_type, float>)
+                        is_left = lhs >= rhs;
+
+                    break;
+
+                case opcode::SUBTRACT: {
+                    const value_type negated = splat<value_type>(0.0f) - rhs;
+
+                    distance = lane_max(lhs, negated);
+                    if constexpr (std::is_same_v<value_type, float>)
+                        is_left = lhs >= negated;
+
+                    break;
+                }
+
+                case opcode::SMOOTH_UNITE: {
+                    const value_type smoothness = parameter(0);
+
+                    value_type h = clamp_unit(splat<value_type>(0.5f) + splat<value_type>(0.5f) *
+                                              (rhs - lhs) / smoothness);
+
+                    distance = rhs + (lhs - rhs) * h - smoothness * h * (splat<value_type>(1.0f) - h);
+                    if constexpr (std::is_same_v<value_type, float>)
+                        is_left = lhs <= rhs;
+
+                    break;
+                }
+
+                default: // Primitives are handled above
+                    assert(false && "Unknown SDF operation!");
+                    distance = lhs;
+                    break;
+                }
+
+                if (material != nullptr)
+                    materials[top] = is_left? materials[top] : materials[top + 1];
+
+                stack[top ++] = distance;
+                continue;
+            }
+            }
+
+            if (material != nullptr)
+                materials[top] = current.material;
+
+            stack[top ++] = distance;
+        }
+
+        if (material != nullptr)
+            *material = materials[0];
+
+        return stack[0];
+    }
+
+    float sdf::evaluate(const float point[3]) const {
+        if (m_program.empty())
+            return INFINITY_VALUE;
+
+        return run<float>(point[0], point[1], point[2], nullptr);
+    }
+
+    float sdf::evaluate(const float point[3], uint32_t& material) const {
+        material = 0;
+        if (m_program.empty())
+            return INFINITY_VALUE;
+
+        return run<float>(point[0], point[1], point[2], &material);
+    }
+
+    __m256 sdf::evaluate(__m256 x, __m256 y, __m256 z) const {
+        if (m_program.empty())
+            return _mm256_set1_ps(INFINITY_VALUE);
+
+        return run<packet>({ x }, { y }, { z }, nullptr).value;
+    }
+
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "aabb.h"
+#include "vec.h"
+
+#include <immintrin.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace raycaster {
+
+    // Signed distance field composed of primitives and operations on them.
+    // Composition is flattened right away into postfix program that is run
+    // on a small value stack, which evaluates one point or 8 points at once
+    // (AVX) equally well, and doesn't chase any pointers while doing so.
+    //
+    // All primitives are exact distances, and operations keep them bounds
+    // of distance, so fields are safe to sphere trace.
+    class sdf {
+    public:
+        // ==> Primitives:
+
+        static sdf sphere(math::vec3 center, float radius, uint32_t material = 0);
+        static sdf box(math::vec3 center, math::vec3 half_extent, uint32_t material = 0);
+
+        // Torus lies in xz plane, so its axis is y
+        static sdf torus(math::vec3 center, float major_radius, float minor_radius,
+                         uint32_t material = 0);
+
+        // Segment from /from/ to /to/ inflated by /radius/
+        static sdf capsule(math::vec3 from, math::vec3 to, float radius, uint32_t material = 0);
+
+        // Half-space of points with dot(point, normal) < offset, normal should be normalized
+        static sdf plane(math::vec3 normal, float offset, uint32_t material = 0);
+
+        // ==> Operations (on copies, so sdf can be freely reused as building block):
+
+        static sdf unite    (const sdf& lhs, const sdf& rhs);
+        static sdf intersect(const sdf& lhs, const sdf& rhs);
+        static sdf subtract (const sdf& lhs, const sdf& rhs); // lhs without rhs
+
+        // Union with fillet of size /smoothness/ where shapes meet
+        static sdf smooth_unite(const sdf& lhs, const sdf& rhs, float smoothness);
+
+        // ==> Evaluation:
+
+        float evaluate(const float point[3]) const;
+
+        // Same, also finds material of the closest surface
+        float evaluate(const float point[3], uint32_t& material) const;
+
+        // Evaluates 8 points at once, given as SoA
+        __m256 evaluate(__m256 x, __m256 y, __m256 z) const;
+
+        // Conservative bounds of surface (infinite for unbounded fields)
+        const aabb& get_bounds() const { return m_bounds; }
+
+        // Deepest value stack evaluation can need
+        static constexpr int MAX_STACK_DEPTH = 32;
+
+    private:
+        enum class opcode: uint8_t {
+            SPHERE, BOX, TORUS, CAPSULE, PLANE,
+            UNITE, INTERSECT, SUBTRACT, SMOOTH_UNITE
+        };
+
+        struct instruction {
+            opcode code;
+            uint32_t material;
+
+            // Meaning depends on opcode (see sdf.cpp)
+            float parameters[7];
+        };
+
+        std::vector<instruction> m_program;
+
+        int m_stack_depth = 0;
+        aabb m_bounds;
+
+        static sdf primitive(const instruction& current, const aabb& bounds);
+        static sdf combine(const sdf& lhs, const sdf& rhs, const instruction& operation,
+                           const aabb& bounds);
+
+        // Shared by scalar and packet evaluation, /material/ is only tracked when not null
+        template <typename value_type>
+        value_type run(value_type x, value_type y, value_type z, uint32_t* material) const;
+    };
+
+}
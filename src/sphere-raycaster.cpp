@@ -2,27 +2,126 @@
 #include "gl.h"
 #include "simple-window.h"
 #include "pixel-drawing-manager.h" // TODO: rename
+#include "aligned-allocator.h"
+#include "camera.h"
+#include "light-grid.h"
+#include "mesh-loader.h"
+#include "scene.h"
+#include "sdf-tracer.h"
+#include "shading-lut.h"
 #include "vec.h"
 
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
 using math::vec;
 
 struct light_source {
     math::vec3 color;
     math::vec3 position;
+
+    // Light fades out smoothly to nothing at this distance,
+    // infinite one doesn't fade (and isn't culled)
+    float radius = std::numeric_limits<float>::infinity();
+};
+
+struct material {
+    math::vec3 surface_color;
 };
 
 struct renderer_config {
-    light_source light;
+    std::vector<light_source> lights;
+
+    // Lights that can't change any color channel of a surface by more than
+    // this are skipped there (along with their shadow rays)
+    float light_cutoff;
 
     math::vec3 ambient_color;
-    math::vec3 surface_color;
 
+    // Indexed by surface's material, missing ones fallback to the first
+    std::vector<material> materials;
+
+    // Camera looks from here at the center of the scene (and backs off
+    // if scene doesn't fit in its field of view from there)
     math::vec3 view_position;
+    float field_of_view;
+
+    // Shading of lights that don't fade is looked up in tables over normals when
+    // that's within this much of exact one (for any channel), zero disables tables
+    float shading_tolerance;
+    int shading_table_resolution;
 };
 
+renderer_config make_default_config() {
+    return {
+        .lights = {
+            { .color = { 0.5f, 0.5f, 0.5f }, .position = {  7.0f, 7.0f, 7.0f } },
+            { .color = { 0.3f, 0.2f, 0.1f }, .position = { -6.0f, 2.0f, 4.0f } }
+        },
+
+        .light_cutoff = 1.0f / 255.0f,
+
+        .ambient_color = { 0.1f, 0.1f,  0.7f },
+        .materials = {
+            { .surface_color = { 1.0f, 1.0f,  1.0f } }
+        },
+
+        .view_position = { 0.0f, 0.0f, 3.5f },
+        .field_of_view = raycaster::camera::DEFAULT_FIELD_OF_VIEW,
+
+        .shading_tolerance = 2.0f / 255.0f,
+        .shading_table_resolution = raycaster::shading_lut::DEFAULT_RESOLUTION
+    };
+}
+
 class cpu_circle_raycaster: public gl::pixel_drawing_window<cpu_circle_raycaster> {
 public:
-    using gl::pixel_drawing_window<cpu_circle_raycaster>::pixel_drawing_window;
+    cpu_circle_raycaster(int width, int height, const char* title,
+                         raycaster::scene scene, renderer_config config = make_default_config())
+        : gl::pixel_drawing_window<cpu_circle_raycaster>(width, height, title),
+          m_config(std::move(config)), m_scene(std::move(scene)),
+          m_camera(make_camera(m_config, m_scene.get_bounds(), width, height)),
+          m_bounds(m_scene.get_bounds()),
+          m_orbit(make_orbit(m_camera.get_position(), get_view_target(m_bounds))) {
+
+        m_scene.build();
+
+        // Image gets better while nothing moves, once it's converged, window sleeps
+        set_accumulation(true);
+        set_render_on_demand(true);
+    }
+
+    // Renders signed distance field instead of scene
+    cpu_circle_raycaster(int width, int height, const char* title,
+                         raycaster::sdf field, renderer_config config = make_default_config())
+        : gl::pixel_drawing_window<cpu_circle_raycaster>(width, height, title),
+          m_config(std::move(config)),
+          m_camera(make_camera(m_config, field.get_bounds(), width, height)),
+          m_bounds(field.get_bounds()),
+          m_orbit(make_orbit(m_camera.get_position(), get_view_target(m_bounds))) {
+
+        // Surface is found as precisely as pixel's footprint lets see it
+        raycaster::sdf_trace_settings settings;
+        settings.hit_distance = 1e-4f;
+        settings.hit_spread   = m_camera.get_pixel_angle() * 0.5f;
+
+        m_field.emplace(std::move(field), settings);
+
+        set_accumulation(true);
+        set_render_on_demand(true);
+    }
+
+    static bool is_same(const math::vec3& lhs, const math::vec3& rhs) {
+        return lhs.x() == rhs.x() && lhs.y() == rhs.y() && lhs.z() == rhs.z();
+    }
 
     static float clamp(float value, float min, float max) {
         if (value < min)
@@ -34,57 +133,1019 @@ public:
         return value;
     }
 
-    math::vec3 draw_pixel(math::vec2 position2D) /* CRTP override */ {
-        const float radius = 0.7f;
+    // Takes effect from the next frame, when pipelined, should be called
+    // from shading thread (input handlers run there too)
+    void set_config(renderer_config config) {
+        m_config = std::move(config);
+        m_is_shading_stale = true;
+        m_previous_view.reset(); // Lighting of previous frame is no longer valid
+
+        invalidate();
+    }
+
+    // Interactive frames shade only half of pixels (alternating in checkerboard pattern),
+    // the other half is reprojected from previous frame, or interpolated from neighbors
+    void set_checkerboard(bool is_enabled) {
+        m_is_checkerboard = is_enabled;
+        m_previous_view.reset();
+
+        invalidate();
+    }
+
+    // Camera turns around the scene by a step every frame, so that every frame is
+    // an interactive one, makes them easy to profile (or check) without a user
+    void set_orbiting(bool is_enabled) {
+        m_is_orbiting = is_enabled;
+        request_redraw();
+    }
+
+    // Window closes once it has shaded this many frames, none if zero
+    void set_frame_limit(int frame_count) { m_frame_limit = frame_count; }
+
+    // Frames drawn with tiles, and how many of them shaded only half of pixels
+    int get_tile_frames() const { return m_tile_frames; }
+    int get_checkerboard_frames() const { return m_checkerboard_frames; }
+
+    void begin_frame() /* CRTP override */ {
+        if (m_frame_limit > 0 && ++ m_shaded_frames >= m_frame_limit)
+            close(); // This one is still finished
+
+        if (m_is_orbiting)
+            move_camera(ORBIT_STEP, 0.0f, 1.0f);
+
+        m_camera.update(); // Only recomputes directions if camera changed
+
+        // Tables assume fixed view direction, so turning camera invalidates them too
+        const math::vec3& forward = m_camera.get_forward();
+        m_is_shading_stale |= !is_same(forward, m_shaded_forward);
 
-        float z = sqrt(radius * radius - position2D.dot(position2D));
-        vec position = { position2D.x(), position2D.y(), z };
+        // Accumulated image is only valid for the pose it was accumulated from
+        if (!is_same(forward, m_frame_forward) || !is_same(m_camera.get_position(), m_frame_position))
+            invalidate();
 
-        static renderer_config cfg = {
-            .light = {
-                .color    = { 0.5f, 0.5f,  0.5f },
-                .position = { 7.0f, 7.0f,  7.0f }
-            },
+        m_frame_forward  = forward;
+        m_frame_position = m_camera.get_position();
 
-            .ambient_color = { 0.1f, 0.1f,  0.7f },
-            .surface_color = { 1.0f, 1.0f,  1.0f },
+        // Dynamic resolution can change it between frames
+        m_camera.set_resolution(get_render_width(), get_render_height());
+        m_camera.update();
 
-            .view_position = { 0.0f, 0.0f, -3.5f }
+        m_layout = get_render_layout();
+
+        if (m_is_shading_stale)
+            build_shading_tables();
+
+        // Whole frame's primary hits go first, coverage pass compares every pixel with
+        // its neighbors, even ones in other tiles (frames refined by samples don't need them)
+        if (!is_refining_frame()) {
+            {
+                auto phase = get_profiler().measure("primary_hits");
+                trace_primary_hits();
+            }
+
+            auto phase = get_profiler().measure("coverage");
+            find_coverage();
+        }
+
+        // First frame has nothing to reproject, so it's shaded whole
+        m_is_checkerboard_frame = m_is_checkerboard && !is_refining_frame() && m_previous_view;
+        if (m_is_checkerboard_frame)
+            m_checkerboard_parity ^= 1;
+
+        // Lights and camera may move between frames, so clusters are rebuilt every time
+        m_light_bounds.clear();
+        for (const light_source& light: m_config.lights)
+            m_light_bounds.push_back({ light.position, light.radius });
+
+        const auto [near, far] = get_depth_range();
+
+        auto phase = get_profiler().measure("light_grid");
+        m_light_grid.build(m_camera, m_light_bounds, near, far);
+    }
+
+    void draw_tile(const gl::pixel_tile& tile) /* CRTP override */ {
+        const int row_count    = tile.row_end    - tile.row_begin;
+        const int column_count = tile.column_end - tile.column_begin;
+
+        // ==> Collect samples, covered pixels get one (weighted by coverage),
+        //     edge pixels get supersampled:
+
+        raycaster::hit hits[MAX_TILE_SAMPLES];
+
+        // Pixel (row, column) of tile is at row * TILE_SIZE + column
+        int   sample_pixels [MAX_TILE_SAMPLES];
+        float sample_weights[MAX_TILE_SAMPLES];
+
+        int sample_count = 0;
+        auto add_sample = [&](int pixel, const raycaster::hit& current, float weight) {
+            hits[sample_count] = current;
+            sample_pixels [sample_count] = pixel;
+            sample_weights[sample_count] = weight;
+
+            ++ sample_count;
         };
 
-        if (position2D.len() <= radius)
-            return get_sphere_surface_color(position, cfg);
+        for (int row = 0; row < row_count; ++ row)
+            for (int column = 0; column < column_count; ++ column) {
+                const int i = tile.row_begin + row, j = tile.column_begin + column;
+                if (is_skipped(i, j))
+                    continue; // Reconstructed in end_frame
+
+                const size_t index = m_layout.get_index(i, j);
+
+                const raycaster::hit& primary = m_primary_hits[index];
+                const float coverage = m_coverage[index];
+
+                const int pixel = row * TILE_SIZE + column;
+                if (coverage != SUPERSAMPLE) {
+                    if (primary.is_hit() && coverage > 0.0f)
+                        add_sample(pixel, primary, coverage);
+
+                    continue;
+                }
+
+                static constexpr float weight = 1.0f / (1 + SUBSAMPLE_COUNT);
+                if (primary.is_hit())
+                    add_sample(pixel, primary, weight);
+
+                for (const auto& offset: SUBSAMPLE_OFFSETS) {
+                    raycaster::hit current;
+                    if (trace(m_camera.get_subpixel_ray((float) i + offset[0], (float) j + offset[1]), current))
+                        add_sample(pixel, current, weight);
+                }
+            }
+
+        // ==> Only lights that reach tile's clusters are relevant:
+
+        float min_depth = std::numeric_limits<float>::infinity(), max_depth = 0.0f;
+        for (int sample = 0; sample < sample_count; ++ sample) {
+            const float depth = (hits[sample].position - m_camera.get_position()).dot(m_camera.get_forward());
+            min_depth = std::min(min_depth, depth), max_depth = std::max(max_depth, depth);
+        }
+
+        thread_local std::vector<uint32_t> tile_lights;
+        if (min_depth <= max_depth)
+            m_light_grid.gather(tile.row_begin, tile.row_end, tile.column_begin, tile.column_end,
+                                min_depth, max_depth, tile_lights);
+        else
+            tile_lights.clear(); // Nothing to shade
+
+        // ==> Shade, one light at a time, so that shadow rays of the tile
+        //     go in the same direction one after another:
+
+        const renderer_config& cfg = m_config;
+
+        float colors[TILE_SIZE * TILE_SIZE][3] = {};
+        auto accumulate = [&](int sample, const math::vec3& color) {
+            float* pixel_color = colors[sample_pixels[sample]];
+            for (int channel = 0; channel < 3; ++ channel)
+                pixel_color[channel] += color[channel] * sample_weights[sample];
+        };
+
+        for (uint32_t light_index: tile_lights) {
+            const light_source& light = cfg.lights[light_index];
+            shadow_batch shadows;
+
+            for (int sample = 0; sample < sample_count; ++ sample) {
+                const light_contribution contribution = get_light_contribution(hits[sample], light_index, cfg);
+                accumulate(sample, contribution.ambient);
+
+                const math::vec3& lit = contribution.direct;
+                if (std::max({ lit[0], lit[1], lit[2] }) < cfg.light_cutoff)
+                    continue; // Not worth a shadow ray
+
+                shadows.add(sample, make_shadow_ray(hits[sample], light), contribution.direct);
+            }
+
+            const std::bitset<shadow_batch::CAPACITY> occluded_mask = trace_shadows(shadows);
+
+            for (int i = 0; i < shadows.count; ++ i)
+                if (!occluded_mask[i])
+                    accumulate(shadows.samples[i], shadows.get_direct(i));
+        }
+
+        for (int row = 0; row < row_count; ++ row)
+            for (int column = 0; column < column_count; ++ column) {
+                const float* color = colors[row * TILE_SIZE + column];
+                set_pixel_color(tile.row_begin + row, tile.column_begin + column,
+                                { color[0], color[1], color[2] });
+            }
+    }
+
+    void end_frame() /* CRTP override */ {
+        ++ m_tile_frames;
+        m_checkerboard_frames += m_is_checkerboard_frame;
+
+        if (m_is_checkerboard_frame)
+            reconstruct_skipped_pixels();
 
-        return { 0.0f, 0.0f, 0.0f };
+        if (m_is_checkerboard)
+            remember_frame();
+    }
+
+    // One sample of a still, for adaptive sampling, position is in normalized device coordinates
+    math::vec4 draw_pixel(math::vec2 position) /* CRTP override */ {
+        const math::vec2& point = position;
+
+        const float i = (point.x() + 1.0f) * 0.5f * (float) height;
+        const float j = (point.y() + 1.0f) * 0.5f * (float) width;
+
+        raycaster::hit surface;
+        if (!trace(m_camera.get_subpixel_ray(i, j), surface))
+            return { 0.0f, 0.0f, 0.0f, 1.0f };
+
+        const float depth = (surface.position - m_camera.get_position()).dot(m_camera.get_forward());
+
+        const int row = std::clamp((int) i, 0, height - 1), column = std::clamp((int) j, 0, width - 1);
+
+        thread_local std::vector<uint32_t> pixel_lights;
+        m_light_grid.gather(row, row + 1, column, column + 1, depth, depth, pixel_lights);
+
+        const renderer_config& cfg = m_config;
+
+        float color[3] = {};
+        for (uint32_t light_index: pixel_lights) {
+            const light_contribution contribution = get_light_contribution(surface, light_index, cfg);
+
+            const math::vec3& lit = contribution.direct;
+            const bool is_lit = std::max({ lit[0], lit[1], lit[2] }) >= cfg.light_cutoff &&
+                                !is_occluded(make_shadow_ray(surface, cfg.lights[light_index]));
+
+            for (int channel = 0; channel < 3; ++ channel)
+                color[channel] += contribution.ambient[channel] + (is_lit? lit[channel] : 0.0f);
+        }
+
+        return { color[0], color[1], color[2], 1.0f };
+    }
+
+    void on_sampling_round(const gl::adaptive_sampling_stats& stats) /* CRTP override */ {
+        std::cout << "Still, round " << stats.rounds << ": " << stats.samples << " samples in "
+                  << stats.refined_tiles << " tiles, " << stats.total_samples << " total"
+                  << (stats.is_finished? " (done)" : "") << std::endl;
+    }
+
+    // A and D orbit camera around the scene, R and F raise and lower it, W and S move it closer
+    // and further (held keys repeat), moving camera starts accumulation over, see begin_frame.
+    // P renders a still with adaptive supersampling, pressing it again goes back to interactive frames,
+    // C switches hardware counters of frame's phases (reported along with FPS) on and off
+    void on_key_pressed(gl::key pressed_key) override {
+        switch (pressed_key) {
+        case gl::key::A: move_camera(- ORBIT_STEP, 0.0f, 1.0f); break;
+        case gl::key::D: move_camera(  ORBIT_STEP, 0.0f, 1.0f); break;
+        case gl::key::R: move_camera(0.0f,   ORBIT_STEP, 1.0f); break;
+        case gl::key::F: move_camera(0.0f, - ORBIT_STEP, 1.0f); break;
+        case gl::key::W: move_camera(0.0f, 0.0f, DOLLY_STEP);        break;
+        case gl::key::S: move_camera(0.0f, 0.0f, 1.0f / DOLLY_STEP); break;
+
+        case gl::key::C:
+            get_profiler().set_enabled(!get_profiler().is_enabled());
+            break;
+
+        case gl::key::P:
+            if (is_adaptive_sampling())
+                stop_adaptive_sampling();
+            else
+                start_adaptive_sampling();
+            break;
+
+        default:
+            break;
+        }
     }
 
     void on_fps_updated() override {
-        std::cout << "FPS: " << get_fps() << std::endl;
+        std::cout << "FPS: " << get_fps();
+        if (get_idle_wakeups() > 0)
+            std::cout << " (idle, " << get_idle_wakeups() << " wakeups)";
+
+        if (is_dynamic_resolution())
+            std::cout << ", resolution scale " << get_render_scale()
+                      << ", frame time " << get_frame_time() * 1000.0 << " ms";
+
+        // Tiles every NUMA node shaded, stolen ones are the ones from other nodes' memory
+        gl::thread_pool& pool = gl::thread_pool::global();
+        if (pool.get_node_count() > 1) {
+            const std::vector<gl::thread_pool::node_stats> stats = pool.get_node_stats();
+            for (size_t node = 0; node < stats.size(); ++ node)
+                std::cout << ", node " << node << ": " << stats[node].local_tasks
+                          << " local, " << stats[node].stolen_tasks << " stolen";
+
+            pool.reset_node_stats();
+        }
+
+        std::cout << std::endl;
+
+        if (get_profiler().is_enabled())
+            print_profile();
+    }
+
+    // Time and counters of an average call of every phase, misses are per thousand instructions,
+    // which tells memory-bound phases (many of them, low IPC) from compute-bound ones
+    void print_profile() {
+        gl::frame_profiler& profiler = get_profiler();
+
+        const std::string error = profiler.get_error();
+        if (!error.empty())
+            std::cout << "  not counted: " << error << std::endl;
+
+        for (const gl::frame_profiler::phase_stats& phase: profiler.take_stats()) {
+            std::cout << "  " << phase.name << ": " << phase.seconds * 1000.0 / (double) phase.calls << " ms";
+
+            const gl::perf_sample& counters = phase.counters;
+            const double instructions = (double) counters[gl::perf_event::INSTRUCTIONS];
+
+            if (profiler.is_counted(gl::perf_event::CYCLES) && profiler.is_counted(gl::perf_event::INSTRUCTIONS))
+                std::cout << ", IPC " << instructions / std::max(1.0, (double) counters[gl::perf_event::CYCLES]);
+
+            if (profiler.is_counted(gl::perf_event::INSTRUCTIONS))
+                for (gl::perf_event event: { gl::perf_event::L1D_MISSES,  gl::perf_event::LLC_MISSES,
+                                             gl::perf_event::DTLB_MISSES, gl::perf_event::BRANCH_MISSES })
+                    if (profiler.is_counted(event))
+                        std::cout << ", " << gl::get_name(event) << " "
+                                  << 1000.0 * (double) counters[event] / std::max(1.0, instructions) << "/k";
+
+            std::cout << std::endl;
+        }
     }
 
 private:
+    renderer_config m_config;
+
+    raycaster::scene m_scene;
+    raycaster::camera m_camera;
+
+    // Pose of the previous frame, moving camera starts accumulation over
+    math::vec3 m_frame_position { 0.0f, 0.0f, 0.0f };
+    math::vec3 m_frame_forward  { 0.0f, 0.0f, 0.0f };
+
+    std::optional<raycaster::sdf_tracer> m_field;
+
+    // Bounds of whatever is rendered, light clusters span depths they cover
+    raycaster::aabb m_bounds;
+
+    std::vector<raycaster::light_bounds> m_light_bounds;
+    raycaster::light_grid m_light_grid;
+
+    // Indexed by light, empty for lights shaded exactly
+    std::vector<std::optional<raycaster::shading_lut>> m_shading_tables;
+
+    math::vec3 m_shaded_forward { 0.0f, 0.0f, 0.0f }; // View direction tables are built for
+    bool m_is_shading_stale = true;
+
+    static constexpr float SHININESS = 15.0f;
+
+    // Random points tables are checked at against exact shading
+    static constexpr size_t SHADING_VALIDATION_SAMPLES = 4096;
+
+    static_assert(raycaster::light_grid::TILE_SIZE % TILE_SIZE == 0,
+                  "Window's tiles shouldn't straddle light clusters");
+
+    // How far shadow rays start from surface (relative to its distance from camera)
+    static constexpr float SHADOW_BIAS = 1e-3f;
+
+    // ==> Antialiasing:
+
+    // Per pixel (in window's layout for the frame), weight of its primary hit, or SUPERSAMPLE for edge pixels
+    gl::tiled_layout m_layout { 0, 0 };
+    gl::huge_page_vector<raycaster::hit> m_primary_hits;
+    gl::huge_page_vector<float> m_coverage;
+
+    static constexpr float SUPERSAMPLE = -1.0f;
+
+    // Neighbors whose depths differ more than this (relatively) are on different surfaces
+    static constexpr float EDGE_DEPTH_RATIO = 0.1f;
+
+    // Edge pixels get rotated grid of samples (offsets from center in pixels) on top of center's
+    static constexpr int SUBSAMPLE_COUNT = 4;
+    static constexpr float SUBSAMPLE_OFFSETS[SUBSAMPLE_COUNT][2] = {
+        { -0.125f, -0.375f }, { 0.375f, -0.125f }, { 0.125f, 0.375f }, { -0.375f, 0.125f }
+    };
+
+    static constexpr int MAX_TILE_SAMPLES = TILE_SIZE * TILE_SIZE * (1 + SUBSAMPLE_COUNT);
+
+    // ==> Checkerboard rendering:
+
+    bool m_is_checkerboard = false;
+    bool m_is_checkerboard_frame = false; // Whether current frame skips half of pixels
+    int m_checkerboard_parity = 0;
+
+    int m_tile_frames = 0, m_checkerboard_frames = 0;
+
+    // Previous frame drawn with tiles, skipped pixels are reprojected from it
+    std::optional<raycaster::camera> m_previous_view;
+    std::vector<float> m_previous_colors; // 3 channels per pixel
+    std::vector<float> m_previous_depths; // Along previous view's forward, infinite for background
+    gl::tiled_layout m_previous_layout { 0, 0 };
+
+    // Reprojected point should be this close (relatively) to depth previous frame saw there,
+    // otherwise it was hidden back then (disoccluded since), and gets interpolated instead
+    static constexpr float REPROJECTION_DEPTH_RATIO = 0.02f;
+
+    bool is_skipped(int i, int j) const {
+        return m_is_checkerboard_frame && ((i + j + m_checkerboard_parity) & 1);
+    }
+
+    // Skipped pixel's 4 neighbors are all shaded, so they can be read while skipped ones are written
+    void reconstruct_skipped_pixels() {
+        const int rows = get_render_height(), columns = get_render_width();
+
+        for_each_tile(rows, columns, [&](const gl::pixel_tile& tile) {
+            for (int i = tile.row_begin; i < tile.row_end; ++ i)
+                for (int j = tile.column_begin; j < tile.column_end; ++ j) {
+                    if (!is_skipped(i, j))
+                        continue;
+
+                    const raycaster::hit& primary = m_primary_hits[m_layout.get_index(i, j)];
+
+                    float color[3];
+                    if (!primary.is_hit() || !reproject(primary.position, color))
+                        interpolate_neighbors(i, j, color);
+
+                    set_pixel_color(i, j, { color[0], color[1], color[2] });
+                }
+        });
+    }
+
+    // Color previous frame had at the point, false if it didn't see it
+    bool reproject(const math::vec3& point, float* color) const {
+        const math::vec3 projected = m_previous_view->project(point);
+
+        const float depth = projected.z();
+        if (!(depth > 0.0f))
+            return false; // Behind camera
+
+        const float i = std::round(projected.x()), j = std::round(projected.y());
+
+        if (!(i >= 0.0f && i < (float) m_previous_layout.get_height() &&
+              j >= 0.0f && j < (float) m_previous_layout.get_width()))
+            return false; // Off screen
+
+        const size_t index = m_previous_layout.get_index((int) i, (int) j);
+        if (!(std::abs(m_previous_depths[index] - depth) <= REPROJECTION_DEPTH_RATIO * depth))
+            return false; // Disoccluded
+
+        for (int channel = 0; channel < 3; ++ channel)
+            color[channel] = m_previous_colors[index * 3 + channel];
+
+        return true;
+    }
+
+    // Average of neighbors on the same surface (as coverage pass tells them apart), or of all of them
+    void interpolate_neighbors(int i, int j, float* color) {
+        const int rows = get_render_height(), columns = get_render_width();
+
+        const raycaster::hit& center = m_primary_hits[m_layout.get_index(i, j)];
+
+        float same_surface[3] = {}, all[3] = {};
+        int same_surface_count = 0, all_count = 0;
+
+        static constexpr int NEIGHBORS[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+        for (const auto& offset: NEIGHBORS) {
+            const int ni = i + offset[0], nj = j + offset[1];
+            if (ni < 0 || ni >= rows || nj < 0 || nj >= columns)
+                continue;
 
-    math::vec3 get_sphere_surface_color(math::vec3 position, const renderer_config &cfg) {
-        vec normal = position.normalized();
+            const raycaster::hit& neighbor = m_primary_hits[m_layout.get_index(ni, nj)];
+            const math::vec3 neighbor_color = get_pixel_color(ni, nj);
 
-        vec relative_light = (cfg.light.position - position).normalized();
-        vec relative_view  = (cfg.view_position  - position).normalized();
+            bool is_same_surface = center.is_hit() == neighbor.is_hit();
+            if (center.is_hit() && neighbor.is_hit())
+                is_same_surface = std::abs(center.distance - neighbor.distance) <=
+                                  EDGE_DEPTH_RATIO * std::min(center.distance, neighbor.distance);
 
-        float sin_alpha = normal.dot(relative_light);
+            for (int channel = 0; channel < 3; ++ channel) {
+                all[channel] += neighbor_color[channel];
+                if (is_same_surface)
+                    same_surface[channel] += neighbor_color[channel];
+            }
 
-        vec mirrored_light = relative_light - 2 * sin_alpha * normal;
-        float sin_phi = mirrored_light.dot(relative_view);
+            ++ all_count;
+            same_surface_count += is_same_surface;
+        }
 
-        float diffuse  = clamp(sin_alpha,        0, 10000);
-        float specular = clamp(pow(sin_phi, 15), 0, 10000);
+        const float* sum = same_surface_count > 0? same_surface : all;
+        const float inverse_count = 1.0f / (float) std::max(1, same_surface_count > 0? same_surface_count : all_count);
 
-        return specular * cfg.light.color +
-            (diffuse * vec(1.0f, 1.0f, 1.0f) + cfg.ambient_color)
-                * cfg.light.color * cfg.surface_color;
+        for (int channel = 0; channel < 3; ++ channel)
+            color[channel] = sum[channel] * inverse_count;
+    }
+
+    // Keeps frame (with skipped pixels reconstructed) to reproject next one from
+    void remember_frame() {
+        const int rows = get_render_height(), columns = get_render_width();
+
+        m_previous_colors.resize((size_t) rows * columns * 3);
+        m_previous_depths.resize((size_t) rows * columns);
+
+        const math::vec3& position = m_camera.get_position();
+        const math::vec3& forward  = m_camera.get_forward();
+
+        for_each_tile(rows, columns, [&](const gl::pixel_tile& tile) {
+            for (int i = tile.row_begin; i < tile.row_end; ++ i)
+                for (int j = tile.column_begin; j < tile.column_end; ++ j) {
+                    const size_t index = m_layout.get_index(i, j);
+                    const raycaster::hit& primary = m_primary_hits[index];
+
+                    m_previous_depths[index] = primary.is_hit()? (primary.position - position).dot(forward) :
+                                                                 std::numeric_limits<float>::infinity();
+
+                    const math::vec3 color = get_pixel_color(i, j);
+                    for (int channel = 0; channel < 3; ++ channel)
+                        m_previous_colors[index * 3 + channel] = color[channel];
+                }
+        });
+
+        m_previous_view = m_camera.get_snapshot();
+        m_previous_layout = m_layout;
+    }
+
+    // Center of the scene, camera looks at (and orbits) it
+    static math::vec3 get_view_target(const raycaster::aabb& bounds) {
+        if (bounds.is_empty() || !std::isfinite(bounds.extent().len()))
+            return { 0.0f, 0.0f, 0.0f };
+
+        return bounds.center();
+    }
+
+    static raycaster::camera make_camera(const renderer_config& cfg, const raycaster::aabb& bounds,
+                                         int width, int height) {
+        const math::vec3 target = get_view_target(bounds);
+        math::vec3 position = cfg.view_position;
+
+        const float radius = bounds.extent().len() * 0.5f;
+        if (!bounds.is_empty() && std::isfinite(radius)) {
+
+            // Whole bounding sphere of the scene should be in sight
+            const float distance = radius / std::sin(cfg.field_of_view * 0.5f);
+            const math::vec3 offset = position - target;
+
+            position = target + offset.normalized() * std::max(offset.len(), distance);
+        }
+
+        raycaster::camera result(position, target, cfg.field_of_view);
+        result.set_resolution(width, height);
+
+        return result;
+    }
+
+    // ==> Navigation:
+
+    // Camera is at /distance/ from target, in direction given by angles around vertical axis
+    // (yaw, zero looks along -z) and above horizon (pitch), so that it always looks at target
+    struct orbit {
+        math::vec3 target;
+        float yaw, pitch, distance;
+    };
+
+    static constexpr float ORBIT_STEP = 0.05f; // In radians, per key press (or repeat)
+    static constexpr float DOLLY_STEP = 0.9f;  // Distance is scaled by it
+    static constexpr float MAX_PITCH  = 1.5f;  // Just short of the pole, where "up" is undefined
+
+    static orbit make_orbit(const math::vec3& position, const math::vec3& target) {
+        const math::vec3 offset = position - target;
+        const float distance = std::max(offset.len(), 1e-3f);
+
+        return { target, std::atan2(offset.x(), offset.z()),
+                 std::asin(clamp(offset.y() / distance, -1.0f, 1.0f)), distance };
+    }
+
+    void move_camera(float yaw, float pitch, float distance_scale) {
+        m_orbit.yaw += yaw;
+        m_orbit.pitch = clamp(m_orbit.pitch + pitch, - MAX_PITCH, MAX_PITCH);
+        m_orbit.distance *= distance_scale;
+
+        const math::vec3 direction = { std::cos(m_orbit.pitch) * std::sin(m_orbit.yaw), std::sin(m_orbit.pitch),
+                                       std::cos(m_orbit.pitch) * std::cos(m_orbit.yaw) };
+
+        m_camera.set_position(m_orbit.target + direction * m_orbit.distance);
+        m_camera.look_at(m_orbit.target);
+    }
+
+    orbit m_orbit;
+    bool m_is_orbiting = false;
+
+    int m_frame_limit = 0, m_shaded_frames = 0;
+
+    // Range of depths (along camera's forward) visible surfaces can be at
+    std::pair<float, float> get_depth_range() const {
+        const float radius = m_bounds.extent().len() * 0.5f;
+
+        if (m_bounds.is_empty() || !std::isfinite(radius)) {
+            const float far = m_field? m_field->get_settings().max_distance : 1000.0f;
+            return { far * 1e-4f, far };
+        }
+
+        const float distance = (m_bounds.center() - m_camera.get_position()).len();
+
+        const float far = distance + radius;
+        return { std::max(distance - radius, far * 1e-4f), far };
+    }
+
+    bool trace(const raycaster::ray& current_ray, raycaster::hit& closest) const {
+        return m_field? m_field->trace(current_ray, closest) : m_scene.intersect(current_ray, closest);
+    }
+
+    void trace_primary_hits() {
+        static constexpr int TILE_PIXELS = TILE_SIZE * TILE_SIZE;
+
+        const int rows = get_render_height(), columns = get_render_width();
+        m_primary_hits.resize((size_t) rows * columns);
+
+        // Same tiles on the same nodes as shading, which reads these hits back
+        for_each_tile(rows, columns, [&](const gl::pixel_tile& tile) {
+            raycaster::hit hits[TILE_PIXELS];
+            bool is_hit[TILE_PIXELS] = {};
+
+            find_primary_hits(tile, hits, is_hit);
+
+            for (int i = tile.row_begin; i < tile.row_end; ++ i)
+                for (int j = tile.column_begin; j < tile.column_end; ++ j) {
+                    const int pixel = (i - tile.row_begin) * TILE_SIZE + (j - tile.column_begin);
+                    m_primary_hits[m_layout.get_index(i, j)] = is_hit[pixel]? hits[pixel] : raycaster::hit {};
+                }
+        });
+    }
+
+    // Coverage pass: pixels on a silhouette against background get analytic coverage when
+    // the surface knows how far its silhouette is (spheres do), other discontinuities
+    // between neighbors (hit against miss, or a depth jump) are supersampled
+    void find_coverage() {
+        const int rows = get_render_height(), columns = get_render_width();
+        m_coverage.resize((size_t) rows * columns);
+
+        const float pixel_angle = m_camera.get_pixel_angle();
+
+        for_each_tile(rows, columns, [&](const gl::pixel_tile& tile) {
+            for (int i = tile.row_begin; i < tile.row_end; ++ i)
+                for (int j = tile.column_begin; j < tile.column_end; ++ j) {
+                    const raycaster::hit& center = m_primary_hits[m_layout.get_index(i, j)];
+
+                    float coverage = center.is_hit()? 1.0f : 0.0f;
+                    bool is_edge = false;
+
+                    static constexpr int NEIGHBORS[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+                    for (const auto& offset: NEIGHBORS) {
+                        const int ni = i + offset[0], nj = j + offset[1];
+                        if (ni < 0 || ni >= rows || nj < 0 || nj >= columns)
+                            continue;
+
+                        const raycaster::hit& neighbor = m_primary_hits[m_layout.get_index(ni, nj)];
+
+                        if (center.is_hit() && neighbor.is_hit()) {
+                            const float depth_jump = std::abs(center.distance - neighbor.distance);
+                            is_edge |= depth_jump > EDGE_DEPTH_RATIO * std::min(center.distance, neighbor.distance);
+
+                            continue;
+                        }
+
+                        if (center.is_hit() == neighbor.is_hit())
+                            continue; // Both see background
+
+                        // Silhouette's distance from the ray that hit it, in pixels:
+                        const raycaster::hit& surface = center.is_hit()? center : neighbor;
+                        const float edge = surface.edge_distance / (pixel_angle * surface.distance);
+
+                        if (!std::isfinite(edge))
+                            is_edge = true; // No idea where exactly it is
+                        else if (center.is_hit())
+                            coverage = std::min(coverage, clamp(0.5f + edge, 0.0f, 1.0f));
+                        else
+                            is_edge |= edge >= 0.5f; // Silhouette is past neighbor's pixel, might be in this one
+                    }
+
+                    m_coverage[m_layout.get_index(i, j)] = is_edge? SUPERSAMPLE : coverage;
+                }
+        });
+    }
+
+    void find_primary_hits(const gl::pixel_tile& tile, raycaster::hit* hits, bool* is_hit) const {
+        const int row_count    = tile.row_end    - tile.row_begin;
+        const int column_count = tile.column_end - tile.column_begin;
+
+        if (!m_field) {
+            for (int row = 0; row < row_count; ++ row)
+                for (int column = 0; column < column_count; ++ column) {
+                    const int pixel = row * TILE_SIZE + column;
+
+                    is_hit[pixel] = m_scene.intersect(m_camera.get_ray(tile.row_begin + row,
+                                                                       tile.column_begin + column), hits[pixel]);
+                }
+
+            return;
+        }
+
+        // ==> Tile's rows are traced as packets, which skip empty space together:
+
+        raycaster::ray_packet packets[TILE_SIZE];
+        for (int row = 0; row < row_count; ++ row)
+            m_camera.get_packet(tile.row_begin + row, tile.column_begin, column_count, packets[row]);
+
+        const raycaster::ray_cone cone = raycaster::ray_cone::enclose(packets, row_count);
+
+        const float start = m_field->find_cone_start(cone);
+        if (start >= m_field->get_far(cone))
+            return; // Nothing in the whole tile
+
+        for (int row = 0; row < row_count; ++ row) {
+            const int hit_mask = m_field->trace(packets[row], start, hits + row * TILE_SIZE);
+
+            for (int column = 0; column < column_count; ++ column)
+                is_hit[row * TILE_SIZE + column] = hit_mask & (1 << column);
+        }
+    }
+
+    // ==> Shadows:
+
+    // Shadow rays of one light from one tile, already packed in packets,
+    // along with light they let through to their samples when unoccluded
+    struct shadow_batch {
+        static constexpr int CAPACITY = MAX_TILE_SAMPLES;
+
+        raycaster::ray_packet packets[CAPACITY / raycaster::ray_packet::SIZE];
+        float distances[CAPACITY];
+
+        int samples[CAPACITY];
+        float direct[CAPACITY][3];
+
+        int count = 0;
+
+        void add(int sample, std::pair<raycaster::ray, float> shadow_ray, const math::vec3& light) {
+            raycaster::ray_packet& packet = packets[count / raycaster::ray_packet::SIZE];
+
+            packet.set_ray(count % raycaster::ray_packet::SIZE, shadow_ray.first);
+            packet.count = count % raycaster::ray_packet::SIZE + 1;
+
+            distances[count] = shadow_ray.second;
+            samples[count] = sample;
+
+            for (int channel = 0; channel < 3; ++ channel)
+                direct[count][channel] = light[channel];
+
+            ++ count;
+        }
+
+        math::vec3 get_direct(int index) const {
+            return { direct[index][0], direct[index][1], direct[index][2] };
+        }
+    };
+
+    // Ray from surface towards light and distance to the light along it
+    std::pair<raycaster::ray, float> make_shadow_ray(const raycaster::hit& surface,
+                                                     const light_source& light) const {
+        // Lifted off surface, so that it doesn't shadow itself, by more than
+        // sphere tracing's tolerance at that distance when tracing fields
+        float bias = SHADOW_BIAS * std::max(1.0f, surface.distance);
+        if (m_field) {
+            const raycaster::sdf_trace_settings& settings = m_field->get_settings();
+            bias = std::max(bias, 4.0f * (settings.hit_distance + settings.hit_spread * surface.distance));
+        }
+
+        const math::vec3 origin = surface.position + surface.normal * bias;
+        const math::vec3 to_light = light.position - origin;
+
+        const float distance = to_light.len();
+        return { { origin, to_light * (1.0f / distance) }, distance };
+    }
+
+    bool is_occluded(std::pair<raycaster::ray, float> shadow_ray) const {
+        if (!m_field)
+            return m_scene.occluded(shadow_ray.first, shadow_ray.second);
+
+        raycaster::ray_packet packet;
+        packet.count = 1;
+        packet.set_ray(0, shadow_ray.first);
+        packet.pad();
+
+        float distances[raycaster::ray_packet::SIZE];
+        std::fill_n(distances, raycaster::ray_packet::SIZE, shadow_ray.second);
+
+        return m_field->occluded(packet, distances) & 1;
+    }
+
+    // Any-hit queries, stop at the first occluder found, returns
+    // bit mask of occluded rays (in order they were added to batch)
+    std::bitset<shadow_batch::CAPACITY> trace_shadows(shadow_batch& shadows) const {
+        static constexpr int SIZE = raycaster::ray_packet::SIZE;
+
+        std::bitset<shadow_batch::CAPACITY> occluded_mask;
+        for (int first = 0; first < shadows.count; first += SIZE) {
+            raycaster::ray_packet& packet = shadows.packets[first / SIZE];
+
+            int packet_mask = 0;
+            if (m_field) {
+                packet.pad();
+                packet_mask = m_field->occluded(packet, shadows.distances + first);
+            } else
+                for (int lane = 0; lane < packet.count; ++ lane)
+                    if (m_scene.occluded(packet.get_ray(lane), shadows.distances[first + lane]))
+                        packet_mask |= 1 << lane;
+
+            for (int lane = 0; lane < packet.count; ++ lane)
+                occluded_mask[first + lane] = packet_mask & (1 << lane);
+        }
+
+        return occluded_mask;
+    }
+
+    // ==> Shading:
+
+    // Tabulates every light that doesn't fade (light that does isn't a function of
+    // normal alone), but only keeps tables which are accurate enough all over the scene
+    void build_shading_tables() {
+        const renderer_config& cfg = m_config;
+
+        m_shading_tables.assign(cfg.lights.size(), std::nullopt);
+        m_shaded_forward = m_camera.get_forward();
+        m_is_shading_stale = false;
+
+        if (cfg.shading_tolerance <= 0.0f || m_bounds.is_empty() || !std::isfinite(m_bounds.extent().len()))
+            return;
+
+        // Terms are scaled by light's color, and diffuse one also by material's
+        float max_surface = 1.0f;
+        for (const material& current: cfg.materials)
+            for (int channel = 0; channel < 3; ++ channel)
+                max_surface = std::max(max_surface, std::as_const(current.surface_color)[channel]);
+
+        const math::vec3 center  = m_bounds.center();
+        const math::vec3 to_view = m_camera.get_forward() * -1.0f;
+
+        for (size_t i = 0; i < cfg.lights.size(); ++ i) {
+            const light_source& light = cfg.lights[i];
+            if (std::isfinite(light.radius))
+                continue;
+
+            const math::vec3& color = light.color;
+            const float max_color = std::max({ color[0], color[1], color[2] }) * max_surface;
+
+            raycaster::shading_lut table;
+            table.build((light.position - center).normalized(), to_view, SHININESS, cfg.shading_table_resolution);
+
+            const float error = table.measure_error(m_bounds, light.position, m_camera.get_position(),
+                                                    SHADING_VALIDATION_SAMPLES);
+
+            if (error * max_color <= cfg.shading_tolerance)
+                m_shading_tables[i] = std::move(table);
+        }
+    }
+
+    struct light_contribution {
+        math::vec3 ambient; // Stays even in shadow
+        math::vec3 direct;  // Diffuse and specular
+    };
+
+    light_contribution get_light_contribution(const raycaster::hit& surface, uint32_t light_index,
+                                              const renderer_config &cfg) const {
+        const light_source& light = cfg.lights[light_index];
+
+        const math::vec3& position = surface.position;
+        const math::vec3& normal   = surface.normal;
+
+        const material& surface_material =
+            cfg.materials[surface.material < cfg.materials.size()? surface.material : 0];
+
+        const std::optional<raycaster::shading_lut>& table = m_shading_tables[light_index];
+
+        const raycaster::shading_terms terms = table? table->lookup(normal) :
+            raycaster::shading_terms::evaluate(normal, (light.position          - position).normalized(),
+                                                       (m_camera.get_position() - position).normalized(),
+                                               SHININESS);
+
+        const float diffuse = terms.diffuse, specular = terms.specular;
+
+        // Smooth window, reaches zero right at light's radius
+        float attenuation = 1.0f;
+        if (std::isfinite(light.radius)) {
+            const float ratio = (light.position - position).len() / light.radius;
+            attenuation = clamp(1.0f - ratio * ratio * ratio * ratio, 0, 1);
+            attenuation *= attenuation;
+        }
+
+        const math::vec3 color = light.color * attenuation;
+        return {
+            .ambient = cfg.ambient_color * color * surface_material.surface_color,
+            .direct  = specular * color + diffuse * color * surface_material.surface_color
+        };
     }
 };
 
-int main() {
-    cpu_circle_raycaster drawer(1080, 1080, "My vector drawer!");
-    drawer.draw_loop();
+// Few shapes showing off what fields can be composed of
+raycaster::sdf make_sdf_showcase() {
+    using raycaster::sdf;
+
+    sdf blob = sdf::smooth_unite(sdf::sphere({ -0.35f,  0.15f, 0.0f }, 0.30f),
+                                 sdf::sphere({  0.05f,  0.35f, 0.0f }, 0.22f), 0.15f);
+
+    sdf carved_box = sdf::subtract(sdf::box   ({ 0.45f, -0.35f, 0.0f }, { 0.22f, 0.22f, 0.22f }),
+                                   sdf::sphere({ 0.45f, -0.35f, 0.0f }, 0.29f));
+
+    sdf ring = sdf::torus({ -0.35f, -0.45f, 0.0f }, 0.25f, 0.07f);
+    sdf bar  = sdf::capsule({ 0.2f, 0.3f, 0.0f }, { 0.6f, 0.6f, -0.2f }, 0.08f);
+
+    return sdf::unite(sdf::unite(blob, carved_box), sdf::unite(ring, bar));
+}
+
+// Scatters /count/ small colored lights over the bounds, each reaching
+// a fraction of scene's size, so that clusters actually cull them
+void scatter_lights(renderer_config& cfg, const raycaster::aabb& bounds, int count) {
+    if (bounds.is_empty() || !std::isfinite(bounds.extent().len()))
+        return;
+
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    const float radius = bounds.extent().len() * 0.15f;
+    const float intensity = 0.5f;
+
+    const math::vec3& min = bounds.min;
+    const math::vec3 extent = bounds.extent();
+
+    for (int i = 0; i < count; ++ i) {
+        const math::vec3 position = { min.x() + unit(generator) * extent.x(),
+                                      min.y() + unit(generator) * extent.y(),
+                                      min.z() + unit(generator) * extent.z() };
+
+        cfg.lights.push_back({
+            .color    = { intensity * unit(generator), intensity * unit(generator), intensity * unit(generator) },
+            .position = position,
+            .radius   = radius
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    bool is_sdf = false, is_pipelined = false, is_checkerboard = false, is_counting = false, is_orbiting = false;
+    int scattered_lights = 0, frame_limit = 0;
+    double frame_time_budget = 0.0; // In milliseconds, none if zero
+
+    std::vector<std::string> filenames;
+    for (int i = 1; i < argc; ++ i) {
+        std::string argument = argv[i];
+
+        if (argument == "--sdf")
+            is_sdf = true;
+        else if (argument == "--pipelined")
+            is_pipelined = true;
+        else if (argument == "--checkerboard")
+            is_checkerboard = true;
+        else if (argument == "--counters")
+            is_counting = true;
+        else if (argument == "--orbit")
+            is_orbiting = true;
+        else if (argument.starts_with("--frames="))
+            frame_limit = std::stoi(argument.substr(std::string("--frames=").size()));
+        else if (argument.starts_with("--frame-time="))
+            frame_time_budget = std::stod(argument.substr(std::string("--frame-time=").size()));
+        else if (argument.starts_with("--lights="))
+            scattered_lights = std::stoi(argument.substr(std::string("--lights=").size()));
+        else
+            filenames.push_back(std::move(argument));
+    }
+
+    renderer_config cfg = make_default_config();
+
+    auto run = [&](cpu_circle_raycaster& drawer) {
+        drawer.set_pipelined(is_pipelined);
+        drawer.set_checkerboard(is_checkerboard);
+        drawer.get_profiler().set_enabled(is_counting);
+        drawer.set_orbiting(is_orbiting);
+        drawer.set_frame_limit(frame_limit);
+
+        if (frame_time_budget > 0.0)
+            drawer.start_dynamic_resolution({ .target_frame_time = frame_time_budget / 1000.0 });
+
+        drawer.draw_loop();
+
+        if (frame_limit > 0)
+            std::cout << "Frames drawn with tiles: " << drawer.get_tile_frames()
+                      << ", checkerboard frames: " << drawer.get_checkerboard_frames() << std::endl;
+    };
+
+    if (is_sdf) {
+        raycaster::sdf field = make_sdf_showcase();
+        scatter_lights(cfg, field.get_bounds(), scattered_lights);
+
+        cpu_circle_raycaster drawer(1080, 1080, "My vector drawer!", std::move(field), std::move(cfg));
+        run(drawer);
+
+        return 0;
+    }
+
+    raycaster::scene scene;
+
+    // Meshes (.obj, .ply) and sphere lists can be mixed in one scene
+    for (const std::string& filename: filenames) {
+        if (raycaster::has_extension(filename, ".obj") || raycaster::has_extension(filename, ".ply"))
+            scene.add_mesh(raycaster::load_mesh(filename));
+        else
+            scene.get_spheres().append(raycaster::sphere_scene::load(filename));
+    }
+
+    if (scene.get_spheres().empty() && filenames.empty())
+        scene.get_spheres().add_sphere({ 0.0f, 0.0f, 0.0f }, 0.7f);
+
+    scatter_lights(cfg, scene.get_bounds(), scattered_lights);
+
+    cpu_circle_raycaster drawer(1080, 1080, "My vector drawer!", std::move(scene), std::move(cfg));
+    run(drawer);
 }